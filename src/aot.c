@@ -0,0 +1,351 @@
+#include "aot.h"
+
+#include <string.h>
+
+#include "memory.h"
+#include "register.h"
+
+typedef struct
+{
+    cwFunction** functions;
+    int len;
+    int cap;
+} cwAotUnit;
+
+/* numbers functions in the order they are found, the script is 0 */
+static int cw_aot_collect(cwAotUnit* unit, cwFunction* function)
+{
+    for (int i = 0; i < unit->len; ++i)
+    {
+        if (unit->functions[i] == function) return i;
+    }
+
+    if (unit->cap < unit->len + 1)
+    {
+        int old_cap = unit->cap;
+        unit->cap = CW_GROW_CAPACITY(old_cap);
+        unit->functions = CW_GROW_ARRAY(cwFunction*, unit->functions, old_cap, unit->cap);
+    }
+
+    int index = unit->len++;
+    unit->functions[index] = function;
+    for (size_t i = 0; i < function->chunk.const_len; ++i)
+    {
+        cwValue constant = function->chunk.constants[i];
+        if (IS_FUNCTION(constant)) cw_aot_collect(unit, AS_FUNCTION(constant));
+    }
+    return index;
+}
+
+static int cw_aot_index(const cwAotUnit* unit, const cwFunction* function)
+{
+    for (int i = 0; i < unit->len; ++i)
+    {
+        if (unit->functions[i] == function) return i;
+    }
+    return -1;
+}
+
+/* --------------------------| values |-------------------------------------------------- */
+static void cw_aot_string(FILE* out, const char* str, size_t len)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char)str[i];
+        if (c == '"' || c == '\\')      fprintf(out, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7f) fprintf(out, "\\%03o", c);
+        else                            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void cw_aot_constant(FILE* out, const cwAotUnit* unit, cwValue val)
+{
+    switch (val.type)
+    {
+    case VAL_NULL:  fprintf(out, "MAKE_NULL()"); break;
+    case VAL_BOOL:  fprintf(out, "MAKE_BOOL(%s)", AS_BOOL(val) ? "true" : "false"); break;
+    case VAL_INT:   fprintf(out, "MAKE_INT(%d)", val.as.ival); break;
+    case VAL_FLOAT: fprintf(out, "MAKE_FLOAT(%a)", (double)val.as.fval); break;
+    case VAL_OBJECT:
+        if (IS_FUNCTION(val))
+        {
+            fprintf(out, "MAKE_OBJECT(cw_aot_load%d(cw))", cw_aot_index(unit, AS_FUNCTION(val)));
+        }
+        else
+        {
+            cwString* str = AS_STRING(val);
+            fprintf(out, "MAKE_OBJECT(cw_str_copy(cw, ");
+            cw_aot_string(out, str->raw, str->len);
+            fprintf(out, ", %zu))", str->len);
+        }
+        break;
+    }
+}
+
+/* --------------------------| code |---------------------------------------------------- */
+static const char* cw_aot_inplace_names[] =
+{
+    "OP_INC_LOCAL", "OP_INC_GLOBAL", "OP_DEC_LOCAL", "OP_DEC_GLOBAL",
+    "OP_ADD_LOCAL", "OP_ADD_GLOBAL", "OP_SUB_LOCAL", "OP_SUB_GLOBAL",
+    "OP_MULT_LOCAL", "OP_MULT_GLOBAL", "OP_DIV_LOCAL", "OP_DIV_GLOBAL",
+};
+
+static const char* cw_aot_compare_names[] =
+{
+    "OP_R_EQ", "OP_R_NOTEQ", "OP_R_LT", "OP_R_LTEQ", "OP_R_GT", "OP_R_GTEQ",
+};
+
+static const char* cw_aot_typed_names[] =
+{
+    "OP_EQ_INT", "OP_NOTEQ_INT", "OP_LT_INT", "OP_LTEQ_INT", "OP_GT_INT", "OP_GTEQ_INT",
+    "OP_ADD_INT", "OP_SUB_INT", "OP_MULT_INT", "OP_DIV_INT",
+    "OP_LT_FLOAT", "OP_LTEQ_FLOAT", "OP_GT_FLOAT", "OP_GTEQ_FLOAT",
+    "OP_ADD_FLOAT", "OP_SUB_FLOAT", "OP_MULT_FLOAT", "OP_DIV_FLOAT",
+};
+
+/* writes a register operand, constant or slot */
+static void cw_aot_rk(FILE* out, uint8_t mode, uint8_t bit, uint8_t operand)
+{
+    fprintf(out, CW_RK_IS_CONST(mode, bit) ? "K(%d)" : "slots[%d]", operand);
+}
+
+static void cw_aot_instruction(FILE* out, const cwChunk* chunk, int offset)
+{
+    int next = offset + cw_op_length(chunk->bytes + offset);
+
+    /* a wide instruction reads like the short one, with its slot or constant in a */
+    bool wide = chunk->bytes[offset] == OP_WIDE;
+    const uint8_t* bytes = chunk->bytes + offset + wide;
+    uint8_t instruction = bytes[0];
+    int a = (next > offset + 1) ? bytes[1] : 0;
+    if (wide && !cw_is_jump(instruction)) a = (bytes[1] << 8) | bytes[2];
+
+    switch (instruction)
+    {
+    case OP_CONSTANT:  fprintf(out, "PUSH(K(%d));", a); break;
+    case OP_NULL:      fprintf(out, "PUSH(MAKE_NULL());"); break;
+    case OP_TRUE:      fprintf(out, "PUSH(MAKE_BOOL(true));"); break;
+    case OP_FALSE:     fprintf(out, "PUSH(MAKE_BOOL(false));"); break;
+    case OP_POP:       fprintf(out, "POP();"); break;
+    case OP_GET_LOCAL: fprintf(out, "PUSH(slots[%d]);", a); break;
+    case OP_SET_LOCAL: fprintf(out, "slots[%d] = PEEK(0);", a); break;
+    case OP_DEF_GLOBAL: fprintf(out, "cw_op_def_global(cw, AS_STRING(K(%d)));", a); break;
+    case OP_SET_GLOBAL: fprintf(out, "CHECK(%d, cw_op_set_global(cw, AS_STRING(K(%d))));", next, a); break;
+    case OP_GET_GLOBAL: fprintf(out, "CHECK(%d, cw_op_get_global(cw, AS_STRING(K(%d))));", next, a); break;
+    case OP_INC_LOCAL: case OP_DEC_LOCAL:
+    case OP_ADD_LOCAL: case OP_SUB_LOCAL: case OP_MULT_LOCAL: case OP_DIV_LOCAL:
+        fprintf(out, "CHECK(%d, cw_inplace_update(cw, &slots[%d], %s));", next, a,
+                cw_aot_inplace_names[instruction - OP_INC_LOCAL]);
+        break;
+    case OP_INC_GLOBAL: case OP_DEC_GLOBAL:
+    case OP_ADD_GLOBAL: case OP_SUB_GLOBAL: case OP_MULT_GLOBAL: case OP_DIV_GLOBAL:
+        fprintf(out, "CHECK(%d, cw_op_inplace_global(cw, AS_STRING(K(%d)), %s));", next, a,
+                cw_aot_inplace_names[instruction - OP_INC_LOCAL]);
+        break;
+    case OP_EQ:       fprintf(out, "cw_op_equal(cw, true);"); break;
+    case OP_NOTEQ:    fprintf(out, "cw_op_equal(cw, false);"); break;
+    case OP_LT:       fprintf(out, "CHECK(%d, cw_op_compare(cw, OP_LT));", next); break;
+    case OP_LTEQ:     fprintf(out, "CHECK(%d, cw_op_compare(cw, OP_LTEQ));", next); break;
+    case OP_GT:       fprintf(out, "CHECK(%d, cw_op_compare(cw, OP_GT));", next); break;
+    case OP_GTEQ:     fprintf(out, "CHECK(%d, cw_op_compare(cw, OP_GTEQ));", next); break;
+    case OP_ADD:      fprintf(out, "CHECK(%d, cw_op_add(cw));", next); break;
+    case OP_SUBTRACT: fprintf(out, "CHECK(%d, cw_op_arith(cw, cw_value_sub));", next); break;
+    case OP_MULTIPLY: fprintf(out, "CHECK(%d, cw_op_arith(cw, cw_value_mult));", next); break;
+    case OP_DIVIDE:   fprintf(out, "CHECK(%d, cw_op_arith(cw, cw_value_div));", next); break;
+    case OP_NEGATE:   fprintf(out, "CHECK(%d, cw_op_negate(cw));", next); break;
+    case OP_NOT:      fprintf(out, "PUSH(MAKE_BOOL(cw_is_falsey(POP())));"); break;
+    case OP_NOT_BOOL: fprintf(out, "PUSH(MAKE_BOOL(!AS_BOOL(POP())));"); break;
+    case OP_EQ_INT:    case OP_NOTEQ_INT:
+    case OP_LT_INT:    case OP_LTEQ_INT:   case OP_GT_INT:     case OP_GTEQ_INT:
+    case OP_ADD_INT:   case OP_SUB_INT:    case OP_MULT_INT:   case OP_DIV_INT:
+    case OP_LT_FLOAT:  case OP_LTEQ_FLOAT: case OP_GT_FLOAT:   case OP_GTEQ_FLOAT:
+    case OP_ADD_FLOAT: case OP_SUB_FLOAT:  case OP_MULT_FLOAT: case OP_DIV_FLOAT:
+        fprintf(out, "CHECK(%d, cw_op_typed(cw, %s));", next, cw_aot_typed_names[instruction - OP_EQ_INT]);
+        break;
+    case OP_ARRAY:     fprintf(out, "CHECK(%d, cw_array_literal(cw, %d));", next, a); break;
+    case OP_GET_INDEX: fprintf(out, "CHECK(%d, cw_array_get(cw));", next); break;
+    case OP_SET_INDEX: fprintf(out, "CHECK(%d, cw_array_set(cw));", next); break;
+    case OP_JUMP_IF_FALSE:
+        fprintf(out, "if (cw_is_falsey(PEEK(0))) goto L%d;", cw_jump_target(chunk->bytes, offset));
+        break;
+    case OP_JUMP_IF_FALSE_BOOL:
+        fprintf(out, "if (!AS_BOOL(PEEK(0))) goto L%d;", cw_jump_target(chunk->bytes, offset));
+        break;
+    case OP_JUMP:
+    case OP_LOOP:
+        fprintf(out, "goto L%d;", cw_jump_target(chunk->bytes, offset));
+        break;
+    case OP_CALL:
+        fprintf(out, "CHECK(%d, cw_op_call(cw, %d));", next, a);
+        break;
+    case OP_TAIL_CALL:
+        /* natives and cached results return in place, the following OP_RETURN hands them on, a replaced frame starts over */
+        fprintf(out, "if (IS_NATIVE(PEEK(%d))) CHECK(%d, cw_op_call(cw, %d)); ", a, next, a);
+        fprintf(out, "else { CHECK(%d, cw_tail_call_value(cw, PEEK(%d), %d)); ", next, a, a);
+        fprintf(out, "if (frame->ip == frame->chunk->bytes) return CW_TAIL_CALLED; }");
+        break;
+    case OP_R_MOVE:
+        fprintf(out, "slots[%d] = ", bytes[2]);
+        cw_aot_rk(out, a, CW_RK_B, bytes[3]);
+        fprintf(out, ";");
+        break;
+    case OP_R_ADD: case OP_R_SUB: case OP_R_MULT: case OP_R_DIV:
+        if (instruction == OP_R_ADD) fprintf(out, "CHECK(%d, cw_op_register_add(cw, ", next);
+        else fprintf(out, "CHECK(%d, cw_op_register_arith(cw, %s, ", next,
+                     instruction == OP_R_SUB ? "cw_value_sub" : instruction == OP_R_MULT ? "cw_value_mult" : "cw_value_div");
+        fprintf(out, "&slots[%d], ", bytes[2]);
+        cw_aot_rk(out, a, CW_RK_B, bytes[3]);
+        fprintf(out, ", ");
+        cw_aot_rk(out, a, CW_RK_C, bytes[4]);
+        fprintf(out, "));");
+        break;
+    case OP_R_EQ: case OP_R_NOTEQ:
+    case OP_R_LT: case OP_R_LTEQ:
+    case OP_R_GT: case OP_R_GTEQ:
+        fprintf(out, "CHECK(%d, cw_op_register_compare(cw, %s, &slots[%d], ", next,
+                cw_aot_compare_names[instruction - OP_R_EQ], bytes[2]);
+        cw_aot_rk(out, a, CW_RK_B, bytes[3]);
+        fprintf(out, ", ");
+        cw_aot_rk(out, a, CW_RK_C, bytes[4]);
+        fprintf(out, "));");
+        break;
+    case OP_R_BRANCH:
+        fprintf(out, "CHECK(%d, cw_register_compare(cw, %s, ", next, cw_aot_compare_names[CW_RK_CMP(a)]);
+        cw_aot_rk(out, a, CW_RK_B, bytes[2]);
+        fprintf(out, ", ");
+        cw_aot_rk(out, a, CW_RK_C, bytes[3]);
+        fprintf(out, ", &result)); if (!result) goto L%d;", cw_jump_target(chunk->bytes, offset));
+        break;
+    case OP_PRINT:  fprintf(out, "cw_op_print(cw);"); break;
+    case OP_RETURN: fprintf(out, "cw_op_return(cw); return INTERPRET_OK;"); break;
+    }
+}
+
+static void cw_aot_function(FILE* out, const cwAotUnit* unit, int index)
+{
+    const cwFunction* function = unit->functions[index];
+    const cwChunk* chunk = &function->chunk;
+
+    bool* targets = CW_ALLOCATE(bool, chunk->len);
+    memset(targets, 0, chunk->len * sizeof(bool));
+    for (int offset = 0; offset < (int)chunk->len; offset += cw_op_length(chunk->bytes + offset))
+    {
+        uint8_t instruction = chunk->bytes[offset];
+        if (instruction == OP_WIDE) instruction = chunk->bytes[offset + 1];
+        if (cw_is_jump(instruction)) targets[cw_jump_target(chunk->bytes, offset)] = true;
+    }
+
+    fprintf(out, "/* %s */\n", function->name ? function->name->raw : "<script>");
+    fprintf(out, "static int cw_aot_f%d(cwRuntime* cw)\n{\n", index);
+    fprintf(out, "    cwCallFrame* frame = &cw->frames[cw->frame_count - 1];\n");
+    fprintf(out, "    cwValue* slots = frame->slots;\n");
+    fprintf(out, "    bool result;\n");
+    fprintf(out, "    (void)slots; (void)result;\n\n");
+
+    for (int offset = 0; offset < (int)chunk->len; offset += cw_op_length(chunk->bytes + offset))
+    {
+        if (targets[offset]) fprintf(out, "L%d:\n", offset);
+        fprintf(out, "    ");
+        cw_aot_instruction(out, chunk, offset);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "}\n\n");
+
+    CW_FREE_ARRAY(bool, targets, chunk->len);
+}
+
+/* recreates the function object with its chunk, nested functions are loaded recursively */
+static void cw_aot_loader(FILE* out, const cwAotUnit* unit, int index)
+{
+    const cwFunction* function = unit->functions[index];
+    const cwChunk* chunk = &function->chunk;
+
+    fprintf(out, "static const uint8_t cw_aot_code%d[] = {", index);
+    for (size_t i = 0; i < chunk->len; ++i) fprintf(out, "%s%d", i == 0 ? "\n    " : (i % 16) ? ", " : ",\n    ", chunk->bytes[i]);
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const int cw_aot_lines%d[] = {", index);
+    for (size_t i = 0; i < chunk->len; ++i) fprintf(out, "%s%d", i == 0 ? "\n    " : (i % 16) ? ", " : ",\n    ", chunk->lines[i]);
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static cwFunction* cw_aot_load%d(cwRuntime* cw)\n{\n", index);
+    fprintf(out, "    cwFunction* function = cw_function_new(cw);\n");
+    fprintf(out, "    function->arity = %d;\n", function->arity);
+    if (function->memo >= 0) fprintf(out, "    function->memo = %d;\n", function->memo);
+    fprintf(out, "    function->compiled = cw_aot_f%d;\n", index);
+    if (function->name)
+    {
+        fprintf(out, "    function->name = cw_str_copy(cw, ");
+        cw_aot_string(out, function->name->raw, function->name->len);
+        fprintf(out, ", %zu);\n", function->name->len);
+    }
+    fprintf(out, "    for (size_t i = 0; i < sizeof(cw_aot_code%d); ++i)\n", index);
+    fprintf(out, "        cw_emit_byte(&function->chunk, cw_aot_code%d[i], cw_aot_lines%d[i]);\n\n", index, index);
+
+    fprintf(out, "    cwChunk* chunk = &function->chunk;\n");
+    fprintf(out, "    chunk->constants = CW_ALLOCATE(cwValue, %zu);\n", chunk->const_len);
+    fprintf(out, "    chunk->const_len = chunk->const_cap = %zu;\n", chunk->const_len);
+    for (size_t i = 0; i < chunk->const_len; ++i)
+    {
+        fprintf(out, "    chunk->constants[%zu] = ", i);
+        cw_aot_constant(out, unit, chunk->constants[i]);
+        fprintf(out, ";\n");
+    }
+    fprintf(out, "    return function;\n}\n\n");
+}
+
+bool cw_aot_emit(cwFunction* script, FILE* out)
+{
+    cwAotUnit unit = { 0 };
+    cw_aot_collect(&unit, script);
+
+    fprintf(out,
+        "/* generated by clockwork -c, see aot.h */\n"
+        "#include \"aot.h\"\n"
+        "#include \"memory.h\"\n"
+        "#include \"ops.h\"\n\n"
+        "#define PUSH(val)   cw_push_stack(cw, val)\n"
+        "#define POP()       cw_pop_stack(cw)\n"
+        "#define PEEK(d)     cw_peek_stack(cw, d)\n"
+        "#define K(i)        (frame->chunk->constants[i])\n\n"
+        "/* the ip only matters for error reports, it is set before anything that can fail */\n"
+        "#define CHECK(next, op) do {                                \\\n"
+        "        frame->ip = frame->chunk->bytes + (next);           \\\n"
+        "        if (!(op)) return INTERPRET_RUNTIME_ERROR;          \\\n"
+        "    } while (0)\n\n");
+
+    for (int i = 0; i < unit.len; ++i)
+    {
+        fprintf(out, "static int cw_aot_f%d(cwRuntime* cw);\n", i);
+        fprintf(out, "static cwFunction* cw_aot_load%d(cwRuntime* cw);\n", i);
+    }
+    fprintf(out, "\n");
+
+    for (int i = 0; i < unit.len; ++i)
+    {
+        cw_aot_function(out, &unit, i);
+        cw_aot_loader(out, &unit, i);
+    }
+
+    fprintf(out,
+        "InterpretResult cw_aot_run(cwRuntime* cw)\n"
+        "{\n"
+        "    return cw_run_script(cw, cw_aot_load0(cw));\n"
+        "}\n\n"
+        "#ifndef CW_AOT_NO_MAIN\n"
+        "int main(void)\n"
+        "{\n"
+        "    cwRuntime cw = { 0 };\n"
+        "    cw_init(&cw);\n"
+        "    cw_define_array_natives(&cw);\n"
+        "    InterpretResult result = cw_aot_run(&cw);\n"
+        "    cw_free(&cw);\n"
+        "    return result;\n"
+        "}\n"
+        "#endif\n");
+
+    CW_FREE_ARRAY(cwFunction*, unit.functions, unit.cap);
+    return !ferror(out);
+}
@@ -0,0 +1,29 @@
+#ifndef CLOCKWORK_AOT_H
+#define CLOCKWORK_AOT_H
+
+#include <stdio.h>
+
+#include "common.h"
+#include "runtime.h"
+
+/*
+ * Ahead-of-time compilation of scripts to C. Every function becomes a C
+ * function with one block of straight-line code per instruction and gotos
+ * for jumps, operations go through the same helpers as cw_run (see ops.h).
+ * The chunks are embedded as well so runtime errors report the same lines.
+ * A tail call replaces the frame and returns CW_TAIL_CALLED, cw_run_frame
+ * then runs the callee, so tail recursion does not grow the C stack.
+ *
+ * `clockwork -c script.cw script.c` writes the C file, which is compiled
+ * with -Isrc and linked against every runtime source but main.c, as done
+ * by `make aot SCRIPT=script.cw`. Build it with -DCW_AOT_NO_MAIN -shared
+ * -fPIC for a shared object and run the script with cw_aot_run.
+ */
+
+/* writes script and all functions nested in its constants as C source to out */
+bool cw_aot_emit(cwFunction* script, FILE* out);
+
+/* entry point of generated code, defines and runs the script on cw */
+InterpretResult cw_aot_run(cwRuntime* cw);
+
+#endif /* !CLOCKWORK_AOT_H */
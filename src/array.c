@@ -0,0 +1,667 @@
+#include "array.h"
+
+#include <string.h>
+
+#include "compiler.h"
+#include "debug.h"
+#include "host.h"
+#include "memory.h"
+
+/* sse2 is part of x86-64, avx2 is detected at runtime */
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define CW_ARRAY_SIMD
+#define CW_AVX2 __attribute__((target("avx2")))
+#endif
+
+typedef enum
+{
+    REDUCE_SUM,
+    REDUCE_MIN,
+    REDUCE_MAX
+} cwReduce;
+
+static bool cw_is_compare(uint8_t op)
+{
+    return op == OP_LT || op == OP_LTEQ || op == OP_GT || op == OP_GTEQ;
+}
+
+/* --------------------------| scalar |-------------------------------------------------- */
+/* int arithmetic wraps around like the scalar operations */
+static int32_t cw_int_apply(uint8_t op, int32_t x, int32_t y)
+{
+    switch (op)
+    {
+    case OP_ADD:      return (int32_t)((uint32_t)x + (uint32_t)y);
+    case OP_SUBTRACT: return (int32_t)((uint32_t)x - (uint32_t)y);
+    case OP_MULTIPLY: return (int32_t)((uint32_t)x * (uint32_t)y);
+    case OP_DIVIDE:   return x / y;
+    case OP_LT:       return x < y;
+    case OP_LTEQ:     return x <= y;
+    case OP_GT:       return x > y;
+    default:          return x >= y;
+    }
+}
+
+static float cw_float_apply(uint8_t op, float x, float y)
+{
+    switch (op)
+    {
+    case OP_ADD:      return x + y;
+    case OP_SUBTRACT: return x - y;
+    case OP_MULTIPLY: return x * y;
+    default:          return x / y;
+    }
+}
+
+static int32_t cw_float_compare(uint8_t op, float x, float y)
+{
+    switch (op)
+    {
+    case OP_LT:   return x < y;
+    case OP_LTEQ: return x <= y;
+    case OP_GT:   return x > y;
+    default:      return x >= y;
+    }
+}
+
+static int32_t cw_int_fold(cwReduce reduce, int32_t acc, int32_t x)
+{
+    switch (reduce)
+    {
+    case REDUCE_SUM: return (int32_t)((uint32_t)acc + (uint32_t)x);
+    case REDUCE_MIN: return x < acc ? x : acc;
+    default:         return x > acc ? x : acc;
+    }
+}
+
+static float cw_float_fold(cwReduce reduce, float acc, float x)
+{
+    switch (reduce)
+    {
+    case REDUCE_SUM: return acc + x;
+    case REDUCE_MIN: return x < acc ? x : acc;
+    default:         return x > acc ? x : acc;
+    }
+}
+
+/* --------------------------| avx2 |---------------------------------------------------- */
+/*
+ * the vector kernels process elements from i on in whole registers and
+ * return the index of the first element left for the next narrower kernel.
+ * x and y advance by step 1 for arrays and stay put (step 0) for numbers.
+ */
+#ifdef CW_ARRAY_SIMD
+CW_AVX2 static size_t cw_int_binary_avx2(uint8_t op, int32_t* dst, const int32_t* x, size_t xs,
+                                         const int32_t* y, size_t ys, size_t i, size_t n)
+{
+    if (op == OP_DIVIDE) return i;
+
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i bx = _mm256_set1_epi32(xs ? 0 : *x);
+    __m256i by = _mm256_set1_epi32(ys ? 0 : *y);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i a = xs ? _mm256_loadu_si256((const __m256i*)(x + i)) : bx;
+        __m256i b = ys ? _mm256_loadu_si256((const __m256i*)(y + i)) : by;
+        switch (op)
+        {
+        case OP_ADD:      a = _mm256_add_epi32(a, b); break;
+        case OP_SUBTRACT: a = _mm256_sub_epi32(a, b); break;
+        case OP_MULTIPLY: a = _mm256_mullo_epi32(a, b); break;
+        case OP_LT:       a = _mm256_and_si256(_mm256_cmpgt_epi32(b, a), one); break;
+        case OP_GT:       a = _mm256_and_si256(_mm256_cmpgt_epi32(a, b), one); break;
+        case OP_LTEQ:     a = _mm256_andnot_si256(_mm256_cmpgt_epi32(a, b), one); break;
+        case OP_GTEQ:     a = _mm256_andnot_si256(_mm256_cmpgt_epi32(b, a), one); break;
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), a);
+    }
+    return i;
+}
+
+CW_AVX2 static size_t cw_float_binary_avx2(uint8_t op, float* dst, const float* x, size_t xs,
+                                           const float* y, size_t ys, size_t i, size_t n)
+{
+    __m256 bx = _mm256_set1_ps(xs ? 0.0f : *x);
+    __m256 by = _mm256_set1_ps(ys ? 0.0f : *y);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 a = xs ? _mm256_loadu_ps(x + i) : bx;
+        __m256 b = ys ? _mm256_loadu_ps(y + i) : by;
+        switch (op)
+        {
+        case OP_ADD:      a = _mm256_add_ps(a, b); break;
+        case OP_SUBTRACT: a = _mm256_sub_ps(a, b); break;
+        case OP_MULTIPLY: a = _mm256_mul_ps(a, b); break;
+        case OP_DIVIDE:   a = _mm256_div_ps(a, b); break;
+        }
+        _mm256_storeu_ps(dst + i, a);
+    }
+    return i;
+}
+
+CW_AVX2 static size_t cw_float_mask_avx2(uint8_t op, int32_t* dst, const float* x, size_t xs,
+                                         const float* y, size_t ys, size_t i, size_t n)
+{
+    __m256 one = _mm256_castsi256_ps(_mm256_set1_epi32(1));
+    __m256 bx = _mm256_set1_ps(xs ? 0.0f : *x);
+    __m256 by = _mm256_set1_ps(ys ? 0.0f : *y);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 a = xs ? _mm256_loadu_ps(x + i) : bx;
+        __m256 b = ys ? _mm256_loadu_ps(y + i) : by;
+        switch (op)
+        {
+        case OP_LT:   a = _mm256_cmp_ps(a, b, _CMP_LT_OQ); break;
+        case OP_LTEQ: a = _mm256_cmp_ps(a, b, _CMP_LE_OQ); break;
+        case OP_GT:   a = _mm256_cmp_ps(a, b, _CMP_GT_OQ); break;
+        case OP_GTEQ: a = _mm256_cmp_ps(a, b, _CMP_GE_OQ); break;
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_castps_si256(_mm256_and_ps(a, one)));
+    }
+    return i;
+}
+
+/* reduces x, or the products of x and y if y is not NULL, into acc */
+CW_AVX2 static size_t cw_int_reduce_avx2(cwReduce reduce, const int32_t* x, const int32_t* y, size_t n, int32_t* acc)
+{
+    if (n < 8) return 0;
+
+    __m256i sum = _mm256_set1_epi32(reduce == REDUCE_SUM ? 0 : x[0]);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x + i));
+        if (y) v = _mm256_mullo_epi32(v, _mm256_loadu_si256((const __m256i*)(y + i)));
+        switch (reduce)
+        {
+        case REDUCE_SUM: sum = _mm256_add_epi32(sum, v); break;
+        case REDUCE_MIN: sum = _mm256_min_epi32(sum, v); break;
+        case REDUCE_MAX: sum = _mm256_max_epi32(sum, v); break;
+        }
+    }
+
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, sum);
+    for (int lane = 0; lane < 8; ++lane) *acc = cw_int_fold(reduce, *acc, lanes[lane]);
+    return i;
+}
+
+CW_AVX2 static size_t cw_float_reduce_avx2(cwReduce reduce, const float* x, const float* y, size_t n, float* acc)
+{
+    if (n < 8) return 0;
+
+    __m256 sum = _mm256_set1_ps(reduce == REDUCE_SUM ? 0.0f : x[0]);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(x + i);
+        if (y) v = _mm256_mul_ps(v, _mm256_loadu_ps(y + i));
+        switch (reduce)
+        {
+        case REDUCE_SUM: sum = _mm256_add_ps(sum, v); break;
+        case REDUCE_MIN: sum = _mm256_min_ps(sum, v); break;
+        case REDUCE_MAX: sum = _mm256_max_ps(sum, v); break;
+        }
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, sum);
+    for (int lane = 0; lane < 8; ++lane) *acc = cw_float_fold(reduce, *acc, lanes[lane]);
+    return i;
+}
+
+/* --------------------------| sse |----------------------------------------------------- */
+/* sse2 lacks int32 multiplication and min/max, those are left to the scalar loops */
+static size_t cw_int_binary_sse(uint8_t op, int32_t* dst, const int32_t* x, size_t xs,
+                                const int32_t* y, size_t ys, size_t i, size_t n)
+{
+    if (op == OP_MULTIPLY || op == OP_DIVIDE) return i;
+
+    __m128i one = _mm_set1_epi32(1);
+    __m128i bx = _mm_set1_epi32(xs ? 0 : *x);
+    __m128i by = _mm_set1_epi32(ys ? 0 : *y);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i a = xs ? _mm_loadu_si128((const __m128i*)(x + i)) : bx;
+        __m128i b = ys ? _mm_loadu_si128((const __m128i*)(y + i)) : by;
+        switch (op)
+        {
+        case OP_ADD:      a = _mm_add_epi32(a, b); break;
+        case OP_SUBTRACT: a = _mm_sub_epi32(a, b); break;
+        case OP_LT:       a = _mm_and_si128(_mm_cmpgt_epi32(b, a), one); break;
+        case OP_GT:       a = _mm_and_si128(_mm_cmpgt_epi32(a, b), one); break;
+        case OP_LTEQ:     a = _mm_andnot_si128(_mm_cmpgt_epi32(a, b), one); break;
+        case OP_GTEQ:     a = _mm_andnot_si128(_mm_cmpgt_epi32(b, a), one); break;
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), a);
+    }
+    return i;
+}
+
+static size_t cw_float_binary_sse(uint8_t op, float* dst, const float* x, size_t xs,
+                                  const float* y, size_t ys, size_t i, size_t n)
+{
+    __m128 bx = _mm_set1_ps(xs ? 0.0f : *x);
+    __m128 by = _mm_set1_ps(ys ? 0.0f : *y);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 a = xs ? _mm_loadu_ps(x + i) : bx;
+        __m128 b = ys ? _mm_loadu_ps(y + i) : by;
+        switch (op)
+        {
+        case OP_ADD:      a = _mm_add_ps(a, b); break;
+        case OP_SUBTRACT: a = _mm_sub_ps(a, b); break;
+        case OP_MULTIPLY: a = _mm_mul_ps(a, b); break;
+        case OP_DIVIDE:   a = _mm_div_ps(a, b); break;
+        }
+        _mm_storeu_ps(dst + i, a);
+    }
+    return i;
+}
+
+static size_t cw_float_mask_sse(uint8_t op, int32_t* dst, const float* x, size_t xs,
+                                const float* y, size_t ys, size_t i, size_t n)
+{
+    __m128 one = _mm_castsi128_ps(_mm_set1_epi32(1));
+    __m128 bx = _mm_set1_ps(xs ? 0.0f : *x);
+    __m128 by = _mm_set1_ps(ys ? 0.0f : *y);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 a = xs ? _mm_loadu_ps(x + i) : bx;
+        __m128 b = ys ? _mm_loadu_ps(y + i) : by;
+        switch (op)
+        {
+        case OP_LT:   a = _mm_cmplt_ps(a, b); break;
+        case OP_LTEQ: a = _mm_cmple_ps(a, b); break;
+        case OP_GT:   a = _mm_cmpgt_ps(a, b); break;
+        case OP_GTEQ: a = _mm_cmpge_ps(a, b); break;
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_castps_si128(_mm_and_ps(a, one)));
+    }
+    return i;
+}
+
+static size_t cw_float_reduce_sse(cwReduce reduce, const float* x, const float* y, size_t n, float* acc)
+{
+    if (n < 4) return 0;
+
+    __m128 sum = _mm_set1_ps(reduce == REDUCE_SUM ? 0.0f : x[0]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(x + i);
+        if (y) v = _mm_mul_ps(v, _mm_loadu_ps(y + i));
+        switch (reduce)
+        {
+        case REDUCE_SUM: sum = _mm_add_ps(sum, v); break;
+        case REDUCE_MIN: sum = _mm_min_ps(sum, v); break;
+        case REDUCE_MAX: sum = _mm_max_ps(sum, v); break;
+        }
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    for (int lane = 0; lane < 4; ++lane) *acc = cw_float_fold(reduce, *acc, lanes[lane]);
+    return i;
+}
+#endif /* CW_ARRAY_SIMD */
+
+/* --------------------------| kernels |------------------------------------------------- */
+static void cw_int_binary(uint8_t op, int32_t* dst, const int32_t* x, size_t xs, const int32_t* y, size_t ys, size_t n)
+{
+    size_t i = 0;
+#ifdef CW_ARRAY_SIMD
+    if (__builtin_cpu_supports("avx2")) i = cw_int_binary_avx2(op, dst, x, xs, y, ys, i, n);
+    i = cw_int_binary_sse(op, dst, x, xs, y, ys, i, n);
+#endif
+    for (; i < n; ++i) dst[i] = cw_int_apply(op, x[i * xs], y[i * ys]);
+}
+
+static void cw_float_binary(uint8_t op, float* dst, const float* x, size_t xs, const float* y, size_t ys, size_t n)
+{
+    size_t i = 0;
+#ifdef CW_ARRAY_SIMD
+    if (__builtin_cpu_supports("avx2")) i = cw_float_binary_avx2(op, dst, x, xs, y, ys, i, n);
+    i = cw_float_binary_sse(op, dst, x, xs, y, ys, i, n);
+#endif
+    for (; i < n; ++i) dst[i] = cw_float_apply(op, x[i * xs], y[i * ys]);
+}
+
+static void cw_float_mask(uint8_t op, int32_t* dst, const float* x, size_t xs, const float* y, size_t ys, size_t n)
+{
+    size_t i = 0;
+#ifdef CW_ARRAY_SIMD
+    if (__builtin_cpu_supports("avx2")) i = cw_float_mask_avx2(op, dst, x, xs, y, ys, i, n);
+    i = cw_float_mask_sse(op, dst, x, xs, y, ys, i, n);
+#endif
+    for (; i < n; ++i) dst[i] = cw_float_compare(op, x[i * xs], y[i * ys]);
+}
+
+/* x must not be empty unless reduce is REDUCE_SUM */
+static int32_t cw_int_reduce(cwReduce reduce, const int32_t* x, const int32_t* y, size_t n)
+{
+    int32_t acc = (reduce == REDUCE_SUM) ? 0 : x[0];
+    size_t i = 0;
+#ifdef CW_ARRAY_SIMD
+    if (__builtin_cpu_supports("avx2")) i = cw_int_reduce_avx2(reduce, x, y, n, &acc);
+#endif
+    for (; i < n; ++i) acc = cw_int_fold(reduce, acc, y ? cw_int_apply(OP_MULTIPLY, x[i], y[i]) : x[i]);
+    return acc;
+}
+
+static float cw_float_reduce(cwReduce reduce, const float* x, const float* y, size_t n)
+{
+    float acc = (reduce == REDUCE_SUM) ? 0.0f : x[0];
+    size_t i = 0;
+#ifdef CW_ARRAY_SIMD
+    if (__builtin_cpu_supports("avx2")) i = cw_float_reduce_avx2(reduce, x, y, n, &acc);
+    else                                i = cw_float_reduce_sse(reduce, x, y, n, &acc);
+#endif
+    for (; i < n; ++i) acc = cw_float_fold(reduce, acc, y ? x[i] * y[i] : x[i]);
+    return acc;
+}
+
+static void cw_ints_to_floats(float* dst, const int32_t* src, size_t n)
+{
+    size_t i = 0;
+#ifdef CW_ARRAY_SIMD
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = (float)src[i];
+}
+
+/* --------------------------| operands |------------------------------------------------ */
+/* elements of an array or a number broadcast with step 0, converted to floats if needed */
+typedef struct
+{
+    const void* data;
+    size_t step;
+    size_t len;
+    float* converted;
+    cwValue scalar;
+} cwOperand;
+
+static void cw_operand_init(cwOperand* operand, cwValue val, bool is_float)
+{
+    operand->converted = NULL;
+    if (!IS_ARRAY(val))
+    {
+        operand->scalar = is_float ? MAKE_FLOAT(AS_FLOAT(val)) : MAKE_INT(AS_INT(val));
+        operand->data = &operand->scalar.as;
+        operand->step = 0;
+        operand->len = 1;
+        return;
+    }
+
+    cwArray* array = AS_ARRAY(val);
+    operand->data = array->as.ints;
+    operand->step = 1;
+    operand->len = array->len;
+    if (is_float && IS_INT_ARRAY(val))
+    {
+        operand->converted = CW_ALLOCATE(float, array->len);
+        cw_ints_to_floats(operand->converted, array->as.ints, array->len);
+        operand->data = operand->converted;
+    }
+}
+
+static void cw_operand_free(cwOperand* operand)
+{
+    if (operand->converted) CW_FREE_ARRAY(float, operand->converted, operand->len);
+}
+
+static bool cw_has_floats(cwValue val)
+{
+    return IS_FLOAT(val) || cw_is_obj_type(val, OBJ_FLOAT_ARRAY);
+}
+
+static bool cw_array_check(cwRuntime* cw, cwValue val)
+{
+    if (!IS_ARRAY(val))
+    {
+        cw_runtime_error(cw, "Expected an array.");
+        return false;
+    }
+    return true;
+}
+
+/* --------------------------| operations |---------------------------------------------- */
+bool cw_array_literal(cwRuntime* cw, int count)
+{
+    cwValue* values = &cw->stack[cw->stack_index - count];
+    bool is_float = false;
+    for (int i = 0; i < count; ++i)
+    {
+        if (!IS_NUMBER(values[i]))
+        {
+            cw_runtime_error(cw, "Array elements must be numbers.");
+            return false;
+        }
+        is_float |= IS_FLOAT(values[i]);
+    }
+
+    cwArray* array = cw_array_new(cw, is_float ? OBJ_FLOAT_ARRAY : OBJ_INT_ARRAY, count);
+    for (int i = 0; i < count; ++i)
+    {
+        if (is_float) array->as.floats[i] = AS_FLOAT(values[i]);
+        else          array->as.ints[i] = AS_INT(values[i]);
+    }
+
+    cw->stack_index -= count;
+    cw_push_stack(cw, MAKE_OBJECT(array));
+    return true;
+}
+
+static bool cw_array_index(cwRuntime* cw, cwValue array, cwValue index)
+{
+    if (!IS_ARRAY(array))
+    {
+        cw_runtime_error(cw, "Can only index arrays.");
+        return false;
+    }
+
+    if (!IS_INT(index))
+    {
+        cw_runtime_error(cw, "Index must be an integer.");
+        return false;
+    }
+
+    if (AS_INT(index) < 0 || (size_t)AS_INT(index) >= AS_ARRAY(array)->len)
+    {
+        cw_runtime_error(cw, "Index %d out of bounds.", AS_INT(index));
+        return false;
+    }
+    return true;
+}
+
+bool cw_array_get(cwRuntime* cw)
+{
+    cwValue index = cw_pop_stack(cw);
+    cwValue array = cw_pop_stack(cw);
+    if (!cw_array_index(cw, array, index)) return false;
+
+    if (IS_INT_ARRAY(array)) cw_push_stack(cw, MAKE_INT(AS_ARRAY(array)->as.ints[AS_INT(index)]));
+    else                     cw_push_stack(cw, MAKE_FLOAT(AS_ARRAY(array)->as.floats[AS_INT(index)]));
+    return true;
+}
+
+bool cw_array_set(cwRuntime* cw)
+{
+    cwValue value = cw_pop_stack(cw);
+    cwValue index = cw_pop_stack(cw);
+    cwValue array = cw_pop_stack(cw);
+    if (!cw_array_index(cw, array, index)) return false;
+
+    if (!IS_NUMBER(value))
+    {
+        cw_runtime_error(cw, "Array elements must be numbers.");
+        return false;
+    }
+
+    if (IS_INT_ARRAY(array)) AS_ARRAY(array)->as.ints[AS_INT(index)] = AS_INT(value);
+    else                     AS_ARRAY(array)->as.floats[AS_INT(index)] = AS_FLOAT(value);
+    cw_push_stack(cw, value);
+    return true;
+}
+
+bool cw_array_binary(cwRuntime* cw, uint8_t op, cwValue a, cwValue b, cwValue* result)
+{
+    if ((!IS_ARRAY(a) && !IS_NUMBER(a)) || (!IS_ARRAY(b) && !IS_NUMBER(b)))
+    {
+        cw_runtime_error(cw, "Operands must be arrays or numbers.");
+        return false;
+    }
+
+    bool is_float = cw_has_floats(a) || cw_has_floats(b);
+    cwOperand x, y;
+    cw_operand_init(&x, a, is_float);
+    cw_operand_init(&y, b, is_float);
+
+    size_t n = x.step ? x.len : y.len;
+    bool valid = true;
+    if (x.step && y.step && x.len != y.len)
+    {
+        cw_runtime_error(cw, "Arrays must have the same length.");
+        valid = false;
+    }
+    else if (op == OP_DIVIDE && !is_float)
+    {
+        for (size_t i = 0; i < n && valid; ++i)
+        {
+            if (((const int32_t*)y.data)[i * y.step] != 0) continue;
+            cw_runtime_error(cw, "Division by zero.");
+            valid = false;
+        }
+    }
+
+    if (valid)
+    {
+        bool compare = cw_is_compare(op);
+        cwArray* array = cw_array_new(cw, (is_float && !compare) ? OBJ_FLOAT_ARRAY : OBJ_INT_ARRAY, n);
+        if (!is_float)
+            cw_int_binary(op, array->as.ints, x.data, x.step, y.data, y.step, n);
+        else if (compare)
+            cw_float_mask(op, array->as.ints, x.data, x.step, y.data, y.step, n);
+        else
+            cw_float_binary(op, array->as.floats, x.data, x.step, y.data, y.step, n);
+        *result = MAKE_OBJECT(array);
+    }
+
+    cw_operand_free(&x);
+    cw_operand_free(&y);
+    return valid;
+}
+
+/* --------------------------| natives |------------------------------------------------- */
+static bool cw_native_len(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    if (IS_STRING(args[0]))     *result = MAKE_INT((int32_t)AS_STRING(args[0])->len);
+    else if (IS_ARRAY(args[0])) *result = MAKE_INT((int32_t)AS_ARRAY(args[0])->len);
+    else
+    {
+        cw_runtime_error(cw, "Expected an array or a string.");
+        return false;
+    }
+    return true;
+}
+
+static bool cw_native_alloc(cwRuntime* cw, cwValue len, cwObjectType type, cwValue* result)
+{
+    if (!IS_INT(len) || AS_INT(len) < 0)
+    {
+        cw_runtime_error(cw, "Expected a non-negative length.");
+        return false;
+    }
+    *result = MAKE_OBJECT(cw_array_new(cw, type, AS_INT(len)));
+    return true;
+}
+
+static bool cw_native_ints(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    return cw_native_alloc(cw, args[0], OBJ_INT_ARRAY, result);
+}
+
+static bool cw_native_floats(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    return cw_native_alloc(cw, args[0], OBJ_FLOAT_ARRAY, result);
+}
+
+static bool cw_native_reduce(cwRuntime* cw, cwReduce reduce, cwValue val, cwValue* result)
+{
+    if (!cw_array_check(cw, val)) return false;
+
+    cwArray* array = AS_ARRAY(val);
+    if (reduce != REDUCE_SUM && array->len == 0)
+    {
+        cw_runtime_error(cw, "Expected a non-empty array.");
+        return false;
+    }
+
+    if (IS_INT_ARRAY(val)) *result = MAKE_INT(cw_int_reduce(reduce, array->as.ints, NULL, array->len));
+    else                   *result = MAKE_FLOAT(cw_float_reduce(reduce, array->as.floats, NULL, array->len));
+    return true;
+}
+
+static bool cw_native_sum(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    return cw_native_reduce(cw, REDUCE_SUM, args[0], result);
+}
+
+static bool cw_native_min(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    return cw_native_reduce(cw, REDUCE_MIN, args[0], result);
+}
+
+static bool cw_native_max(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    return cw_native_reduce(cw, REDUCE_MAX, args[0], result);
+}
+
+static bool cw_native_dot(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    if (!cw_array_check(cw, args[0]) || !cw_array_check(cw, args[1])) return false;
+    if (AS_ARRAY(args[0])->len != AS_ARRAY(args[1])->len)
+    {
+        cw_runtime_error(cw, "Arrays must have the same length.");
+        return false;
+    }
+
+    bool is_float = cw_has_floats(args[0]) || cw_has_floats(args[1]);
+    cwOperand x, y;
+    cw_operand_init(&x, args[0], is_float);
+    cw_operand_init(&y, args[1], is_float);
+
+    if (is_float) *result = MAKE_FLOAT(cw_float_reduce(REDUCE_SUM, x.data, y.data, x.len));
+    else          *result = MAKE_INT(cw_int_reduce(REDUCE_SUM, x.data, y.data, x.len));
+
+    cw_operand_free(&x);
+    cw_operand_free(&y);
+    return true;
+}
+
+static bool cw_native_scale(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    if (!cw_array_check(cw, args[0])) return false;
+    if (!IS_NUMBER(args[1]))
+    {
+        cw_runtime_error(cw, "Expected a number.");
+        return false;
+    }
+    return cw_array_binary(cw, OP_MULTIPLY, args[0], args[1], result);
+}
+
+void cw_define_array_natives(cwRuntime* cw)
+{
+    cw_define_native(cw, "len",    cw_native_len,    1);
+    cw_define_native(cw, "ints",   cw_native_ints,   1);
+    cw_define_native(cw, "floats", cw_native_floats, 1);
+    cw_define_native(cw, "sum",    cw_native_sum,    1);
+    cw_define_native(cw, "min",    cw_native_min,    1);
+    cw_define_native(cw, "max",    cw_native_max,    1);
+    cw_define_native(cw, "dot",    cw_native_dot,    2);
+    cw_define_native(cw, "scale",  cw_native_scale,  2);
+}
@@ -0,0 +1,38 @@
+#ifndef CLOCKWORK_ARRAY_H
+#define CLOCKWORK_ARRAY_H
+
+#include "common.h"
+#include "runtime.h"
+
+/*
+ * Typed arrays hold contiguous int32 or float elements. A literal like
+ * [1, 2, 3] is an int array, one float element makes it a float array,
+ * elements are read and written with a[i] and a[i] = v.
+ *
+ * Arithmetic (+ - * /) on an array and an array of the same length or a
+ * number works element-wise and returns a new array, comparisons
+ * (< <= > >=) return an int array of 1 and 0 as mask. The kernels use
+ * SSE or AVX2 on x86-64 and plain loops elsewhere.
+ *
+ * cw_define_array_natives adds len, ints, floats, sum, min, max, dot and
+ * scale, e.g. sum(a > 10) counts the elements greater than 10 and
+ * dot(a, a > 10) adds them up.
+ */
+
+/* pops count numbers and pushes them as array (OP_ARRAY) */
+bool cw_array_literal(cwRuntime* cw, int count);
+
+/* OP_GET_INDEX replaces array and index by the element, OP_SET_INDEX leaves the value */
+bool cw_array_get(cwRuntime* cw);
+bool cw_array_set(cwRuntime* cw);
+
+/*
+ * applies op (OP_ADD ... OP_DIVIDE or OP_LT ... OP_GTEQ) element-wise to a
+ * and b, one of which is an array, and stores the new array in result
+ */
+bool cw_array_binary(cwRuntime* cw, uint8_t op, cwValue a, cwValue b, cwValue* result);
+
+/* defines the array natives as globals of cw */
+void cw_define_array_natives(cwRuntime* cw);
+
+#endif /* !CLOCKWORK_ARRAY_H */
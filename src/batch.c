@@ -0,0 +1,471 @@
+#include "batch.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "host.h"
+#include "memory.h"
+#include "program.h"
+
+#define CW_BATCH_STACK 16    /* deepest expression the block interpreter evaluates */
+
+struct cwBatch
+{
+    cwProgram* program;
+    cwFunction* function;
+    int inputs;
+};
+
+/* --------------------------| compile |------------------------------------------------- */
+cwBatch* cw_batch_compile(cwRuntime* cw, const char* expression, const char* const* names, int count)
+{
+    /* the expression becomes the body of a function taking the columns as parameters */
+    size_t len = strlen(expression) + 64;
+    for (int i = 0; i < count; ++i) len += strlen(names[i]) + 2;
+
+    char* src = CW_ALLOCATE(char, len);
+    size_t at = sprintf(src, "function batch(");
+    for (int i = 0; i < count; ++i) at += sprintf(src + at, i ? ", %s" : "%s", names[i]);
+    sprintf(src + at, ") {\nreturn (%s\n);\n}\n", expression);
+
+    /* the script declaring it never runs, batch must not stay behind as a global */
+    cwProgram* program = cw_program_compile_detached(cw, src);
+    CW_FREE_ARRAY(char, src, len);
+    if (!program) return NULL;
+
+    cwBatch* batch = CW_ALLOCATE(cwBatch, 1);
+    batch->program = program;
+    batch->function = NULL;
+    batch->inputs = count;
+
+    cwChunk* chunk = &program->script->chunk;
+    for (size_t i = 0; i < chunk->const_len && !batch->function; ++i)
+    {
+        if (IS_FUNCTION(chunk->constants[i])) batch->function = AS_FUNCTION(chunk->constants[i]);
+    }
+    return batch;
+}
+
+void cw_batch_free(cwRuntime* cw, cwBatch* batch)
+{
+    if (!batch) return;
+
+    cw_program_free(cw, batch->program);
+    CW_FREE_ARRAY(cwBatch, batch, 1);
+}
+
+/* --------------------------| blocks |-------------------------------------------------- */
+/* a block of values, VAL_BOOL and VAL_INT use ints and strings are a column or a constant */
+typedef struct
+{
+    cwValueType type;
+    const int32_t* ints;
+    const float* floats;
+    const cwColumn* strings;
+    cwString* string;
+} cwVector;
+
+typedef struct
+{
+    cwVector stack[CW_BATCH_STACK];
+    int top;
+
+    /* results of stack slot i are written to buffers[i] */
+    struct
+    {
+        int32_t ints[CW_BATCH_BLOCK];
+        float floats[CW_BATCH_BLOCK];
+    } buffers[CW_BATCH_STACK];
+
+    const cwColumn* inputs;
+    size_t row;
+    size_t len;
+} cwBlock;
+
+static bool cw_vector_is_number(const cwVector* v) { return v->type == VAL_BOOL || v->type == VAL_INT || v->type == VAL_FLOAT; }
+
+static const float* cw_block_floats(cwBlock* block, int slot)
+{
+    cwVector* v = &block->stack[slot];
+    if (v->type == VAL_FLOAT) return v->floats;
+
+    float* dst = block->buffers[slot].floats;
+    for (size_t i = 0; i < block->len; ++i) dst[i] = (float)v->ints[i];
+    return dst;
+}
+
+static const char* cw_vector_string(const cwVector* v, size_t row, size_t i, size_t* len)
+{
+    if (v->string)
+    {
+        *len = v->string->len;
+        return v->string->raw;
+    }
+
+    const char* str = v->strings->as.strings[row + i];
+    *len = v->strings->lens ? v->strings->lens[row + i] : strlen(str);
+    return str;
+}
+
+static bool cw_block_push(cwBlock* block, cwValue val)
+{
+    if (block->top == CW_BATCH_STACK) return false;
+
+    cwVector* v = &block->stack[block->top];
+    v->type = val.type;
+    v->string = NULL;
+    v->strings = NULL;
+    if (IS_STRING(val))
+    {
+        v->string = AS_STRING(val);
+    }
+    else if (IS_FLOAT(val))
+    {
+        float* dst = block->buffers[block->top].floats;
+        for (size_t i = 0; i < block->len; ++i) dst[i] = val.as.fval;
+        v->floats = dst;
+    }
+    else if (IS_INT(val) || IS_BOOL(val))
+    {
+        int32_t* dst = block->buffers[block->top].ints;
+        for (size_t i = 0; i < block->len; ++i) dst[i] = val.as.ival;
+        v->ints = dst;
+    }
+    else
+    {
+        return false;
+    }
+
+    block->top++;
+    return true;
+}
+
+static bool cw_block_input(cwBlock* block, int index)
+{
+    if (block->top == CW_BATCH_STACK) return false;
+
+    const cwColumn* column = &block->inputs[index];
+    cwVector* v = &block->stack[block->top++];
+    v->string = NULL;
+    v->strings = NULL;
+    switch (column->type)
+    {
+    case CW_COLUMN_INT:    v->type = VAL_INT;    v->ints = column->as.ints + block->row; break;
+    case CW_COLUMN_FLOAT:  v->type = VAL_FLOAT;  v->floats = column->as.floats + block->row; break;
+    case CW_COLUMN_STRING: v->type = VAL_OBJECT; v->strings = column; break;
+    }
+    return true;
+}
+
+/* op is one of OP_ADD ... OP_DIVIDE */
+static bool cw_block_arith(cwBlock* block, uint8_t op)
+{
+    int slot = block->top - 2;
+    cwVector* x = &block->stack[slot];
+    cwVector* y = &block->stack[slot + 1];
+    if (!cw_vector_is_number(x) || !cw_vector_is_number(y)) return false;
+
+    size_t n = block->len;
+    if (x->type == VAL_FLOAT || y->type == VAL_FLOAT)
+    {
+        const float* a = cw_block_floats(block, slot);
+        const float* b = cw_block_floats(block, slot + 1);
+        float* dst = block->buffers[slot].floats;
+        switch (op)
+        {
+        case OP_ADD:      for (size_t i = 0; i < n; ++i) dst[i] = a[i] + b[i]; break;
+        case OP_SUBTRACT: for (size_t i = 0; i < n; ++i) dst[i] = a[i] - b[i]; break;
+        case OP_MULTIPLY: for (size_t i = 0; i < n; ++i) dst[i] = a[i] * b[i]; break;
+        case OP_DIVIDE:   for (size_t i = 0; i < n; ++i) dst[i] = a[i] / b[i]; break;
+        }
+        x->type = VAL_FLOAT;
+        x->floats = dst;
+    }
+    else
+    {
+        /* a block with a zero divisor runs row by row, where the row reports the division by zero */
+        const int32_t* a = x->ints;
+        const int32_t* b = y->ints;
+        int32_t* dst = block->buffers[slot].ints;
+        switch (op)
+        {
+        case OP_ADD:      for (size_t i = 0; i < n; ++i) dst[i] = (int32_t)((uint32_t)a[i] + (uint32_t)b[i]); break;
+        case OP_SUBTRACT: for (size_t i = 0; i < n; ++i) dst[i] = (int32_t)((uint32_t)a[i] - (uint32_t)b[i]); break;
+        case OP_MULTIPLY: for (size_t i = 0; i < n; ++i) dst[i] = (int32_t)((uint32_t)a[i] * (uint32_t)b[i]); break;
+        case OP_DIVIDE:
+            for (size_t i = 0; i < n; ++i) if (b[i] == 0) return false;
+            for (size_t i = 0; i < n; ++i) dst[i] = cw_int_div(a[i], b[i]);
+            break;
+        }
+        x->type = VAL_INT;
+        x->ints = dst;
+    }
+
+    block->top--;
+    return true;
+}
+
+/* op is one of OP_LT, OP_LTEQ, OP_GT or OP_GTEQ */
+static bool cw_block_compare(cwBlock* block, uint8_t op)
+{
+    int slot = block->top - 2;
+    cwVector* x = &block->stack[slot];
+    cwVector* y = &block->stack[slot + 1];
+    if (!cw_vector_is_number(x) || !cw_vector_is_number(y)) return false;
+
+    size_t n = block->len;
+    int32_t* dst = block->buffers[slot].ints;
+    if (x->type == VAL_FLOAT || y->type == VAL_FLOAT)
+    {
+        const float* a = cw_block_floats(block, slot);
+        const float* b = cw_block_floats(block, slot + 1);
+        switch (op)
+        {
+        case OP_LT:   for (size_t i = 0; i < n; ++i) dst[i] = a[i] <  b[i]; break;
+        case OP_LTEQ: for (size_t i = 0; i < n; ++i) dst[i] = a[i] <= b[i]; break;
+        case OP_GT:   for (size_t i = 0; i < n; ++i) dst[i] = a[i] >  b[i]; break;
+        case OP_GTEQ: for (size_t i = 0; i < n; ++i) dst[i] = a[i] >= b[i]; break;
+        }
+    }
+    else
+    {
+        const int32_t* a = x->ints;
+        const int32_t* b = y->ints;
+        switch (op)
+        {
+        case OP_LT:   for (size_t i = 0; i < n; ++i) dst[i] = a[i] <  b[i]; break;
+        case OP_LTEQ: for (size_t i = 0; i < n; ++i) dst[i] = a[i] <= b[i]; break;
+        case OP_GT:   for (size_t i = 0; i < n; ++i) dst[i] = a[i] >  b[i]; break;
+        case OP_GTEQ: for (size_t i = 0; i < n; ++i) dst[i] = a[i] >= b[i]; break;
+        }
+    }
+
+    x->type = VAL_BOOL;
+    x->ints = dst;
+    block->top--;
+    return true;
+}
+
+/* values of different types are never equal, see cw_values_equal */
+static bool cw_block_equal(cwBlock* block, bool equal)
+{
+    int slot = block->top - 2;
+    cwVector* x = &block->stack[slot];
+    cwVector* y = &block->stack[slot + 1];
+
+    size_t n = block->len;
+    int32_t* dst = block->buffers[slot].ints;
+    if (x->type != y->type)
+    {
+        for (size_t i = 0; i < n; ++i) dst[i] = !equal;
+    }
+    else if (x->type == VAL_FLOAT)
+    {
+        for (size_t i = 0; i < n; ++i) dst[i] = (x->floats[i] == y->floats[i]) == equal;
+    }
+    else if (x->type == VAL_OBJECT)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t a_len, b_len;
+            const char* a = cw_vector_string(x, block->row, i, &a_len);
+            const char* b = cw_vector_string(y, block->row, i, &b_len);
+            dst[i] = (a_len == b_len && memcmp(a, b, a_len) == 0) == equal;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < n; ++i) dst[i] = (x->ints[i] == y->ints[i]) == equal;
+    }
+
+    x->type = VAL_BOOL;
+    x->ints = dst;
+    x->string = NULL;
+    x->strings = NULL;
+    block->top--;
+    return true;
+}
+
+static bool cw_block_unary(cwBlock* block, uint8_t op)
+{
+    int slot = block->top - 1;
+    cwVector* x = &block->stack[slot];
+
+    size_t n = block->len;
+    int32_t* dst = block->buffers[slot].ints;
+    if (op == OP_NEGATE)
+    {
+        if (!cw_vector_is_number(x)) return false;
+        if (x->type == VAL_FLOAT)
+        {
+            float* fdst = block->buffers[slot].floats;
+            for (size_t i = 0; i < n; ++i) fdst[i] = -x->floats[i];
+            x->floats = fdst;
+            return true;
+        }
+        for (size_t i = 0; i < n; ++i) dst[i] = (int32_t)(0u - (uint32_t)x->ints[i]);
+        x->type = VAL_INT;
+        x->ints = dst;
+        return true;
+    }
+
+    /* OP_NOT, floats truncating to 0 are falsey like in cw_is_falsey */
+    switch (x->type)
+    {
+    case VAL_FLOAT:  for (size_t i = 0; i < n; ++i) dst[i] = fabsf(x->floats[i]) < 1.0f; break;
+    case VAL_OBJECT: for (size_t i = 0; i < n; ++i) dst[i] = 0; break;
+    default:         for (size_t i = 0; i < n; ++i) dst[i] = x->ints[i] == 0; break;
+    }
+    x->type = VAL_BOOL;
+    x->ints = dst;
+    x->string = NULL;
+    x->strings = NULL;
+    return true;
+}
+
+static bool cw_block_store(cwBlock* block, cwColumn* output)
+{
+    cwVector* v = &block->stack[block->top - 1];
+    if (!cw_vector_is_number(v)) return false;
+
+    size_t n = block->len;
+    switch (output->type)
+    {
+    case CW_COLUMN_INT:
+    {
+        int32_t* dst = output->as.ints + block->row;
+        if (v->type == VAL_FLOAT) for (size_t i = 0; i < n; ++i) dst[i] = (int32_t)v->floats[i];
+        else                      memcpy(dst, v->ints, n * sizeof(int32_t));
+        return true;
+    }
+    case CW_COLUMN_FLOAT:
+    {
+        float* dst = output->as.floats + block->row;
+        if (v->type == VAL_FLOAT) memcpy(dst, v->floats, n * sizeof(float));
+        else                      for (size_t i = 0; i < n; ++i) dst[i] = (float)v->ints[i];
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/* runs the expression over one block, false if it has to run row by row */
+static bool cw_block_run(cwRuntime* cw, const cwFunction* function, cwBlock* block, cwColumn* output)
+{
+    const cwChunk* chunk = &function->chunk;
+    const uint8_t* ip = chunk->bytes;
+    block->top = 0;
+
+    while (true)
+    {
+        /* typed instructions run over blocks like their generic ones */
+        uint8_t instruction = cw_generic_op(*ip);
+        const uint8_t* operand = ip + 1;
+        ip += cw_op_length(ip);
+
+        bool ok;
+        switch (instruction)
+        {
+        case OP_CONSTANT:  ok = cw_block_push(block, chunk->constants[*operand]); break;
+        case OP_TRUE:      ok = cw_block_push(block, MAKE_BOOL(true)); break;
+        case OP_FALSE:     ok = cw_block_push(block, MAKE_BOOL(false)); break;
+        case OP_GET_LOCAL: ok = *operand > 0 && cw_block_input(block, *operand - 1); break;
+        case OP_GET_GLOBAL:
+        {
+            cwValue* value = cw_table_find(&cw->globals, AS_STRING(chunk->constants[*operand]));
+            ok = value && cw_block_push(block, *value);
+            break;
+        }
+        case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+            ok = cw_block_arith(block, instruction);
+            break;
+        case OP_LT: case OP_LTEQ: case OP_GT: case OP_GTEQ:
+            ok = cw_block_compare(block, instruction);
+            break;
+        case OP_EQ:     ok = cw_block_equal(block, true); break;
+        case OP_NOTEQ:  ok = cw_block_equal(block, false); break;
+        case OP_NEGATE:
+        case OP_NOT:    ok = cw_block_unary(block, instruction); break;
+        case OP_RETURN: return cw_block_store(block, output);
+        default:        return false;
+        }
+
+        if (!ok) return false;
+    }
+}
+
+/* --------------------------| rows |---------------------------------------------------- */
+static bool cw_batch_store(cwRuntime* cw, cwColumn* output, size_t row, cwValue val)
+{
+    switch (output->type)
+    {
+    case CW_COLUMN_INT:
+        if (!IS_NUMBER(val)) break;
+        output->as.ints[row] = AS_INT(val);
+        return true;
+    case CW_COLUMN_FLOAT:
+        if (!IS_NUMBER(val)) break;
+        output->as.floats[row] = AS_FLOAT(val);
+        return true;
+    case CW_COLUMN_STRING:
+        if (!IS_STRING(val) && !IS_NULL(val)) break;
+        output->as.strings[row] = IS_NULL(val) ? NULL : AS_RAWSTRING(val);
+        if (output->lens) output->lens[row] = IS_NULL(val) ? 0 : AS_STRING(val)->len;
+        return true;
+    }
+
+    cw_runtime_error(cw, "Result of row %zu does not fit the output column.", row);
+    return false;
+}
+
+static InterpretResult cw_batch_row(cwRuntime* cw, const cwBatch* batch, const cwColumn* inputs, size_t row, cwColumn* output)
+{
+    cwValue args[UINT8_MAX];
+    cwString views[UINT8_MAX];
+    for (int i = 0; i < batch->inputs; ++i)
+    {
+        const cwColumn* column = &inputs[i];
+        switch (column->type)
+        {
+        case CW_COLUMN_INT:   args[i] = MAKE_INT(column->as.ints[row]); break;
+        case CW_COLUMN_FLOAT: args[i] = MAKE_FLOAT(column->as.floats[row]); break;
+        case CW_COLUMN_STRING:
+        {
+            const char* str = column->as.strings[row];
+            args[i] = cw_str_view(&views[i], str, column->lens ? column->lens[row] : strlen(str));
+            break;
+        }
+        }
+    }
+
+    cwValue result;
+    InterpretResult status = cw_call(cw, batch->function, args, batch->inputs, &result);
+    if (status != INTERPRET_OK) return status;
+    return cw_batch_store(cw, output, row, result) ? INTERPRET_OK : INTERPRET_RUNTIME_ERROR;
+}
+
+/* --------------------------| evaluation |---------------------------------------------- */
+InterpretResult cw_batch_eval(cwRuntime* cw, const cwBatch* batch, const cwColumn* inputs, size_t rows, cwColumn* output)
+{
+    cwBlock* block = CW_ALLOCATE(cwBlock, 1);
+    block->inputs = inputs;
+
+    /* blocks have no side effects, the first one that can not be run decides the rest */
+    size_t row = 0;
+    for (; row < rows; row += CW_BATCH_BLOCK)
+    {
+        block->row = row;
+        block->len = (rows - row < CW_BATCH_BLOCK) ? rows - row : CW_BATCH_BLOCK;
+        if (!cw_block_run(cw, batch->function, block, output)) break;
+    }
+    CW_FREE_ARRAY(cwBlock, block, 1);
+
+    InterpretResult status = INTERPRET_OK;
+    for (; row < rows && status == INTERPRET_OK; ++row)
+    {
+        status = cw_batch_row(cw, batch, inputs, row, output);
+    }
+    return status;
+}
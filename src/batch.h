@@ -0,0 +1,61 @@
+#ifndef CLOCKWORK_BATCH_H
+#define CLOCKWORK_BATCH_H
+
+#include "common.h"
+#include "runtime.h"
+
+/*
+ * Evaluates one expression over many rows of columnar data. The expression
+ * is compiled once with a name per input column:
+ *
+ *   const char* names[] = { "price", "qty" };
+ *   cwBatch* batch = cw_batch_compile(cw, "price * qty > 100", names, 2);
+ *
+ *   cwColumn inputs[2] = { { CW_COLUMN_FLOAT, .as.floats = prices },
+ *                          { CW_COLUMN_INT,   .as.ints = quantities } };
+ *   cwColumn output = { CW_COLUMN_INT, .as.ints = flags };
+ *   cw_batch_eval(cw, batch, inputs, rows, &output);
+ *
+ * Rows are interpreted in blocks: every instruction runs over a whole block
+ * of values before the next one is dispatched. Expressions the block
+ * interpreter does not handle (calls, and/or, string results, ...) run
+ * row by row through cw_call instead, with the same results.
+ */
+
+#define CW_BATCH_BLOCK 256   /* rows interpreted per instruction */
+
+typedef enum
+{
+    CW_COLUMN_INT,
+    CW_COLUMN_FLOAT,
+    CW_COLUMN_STRING
+} cwColumnType;
+
+typedef struct
+{
+    cwColumnType type;
+    union
+    {
+        int32_t* ints;
+        float* floats;
+        const char** strings;
+    } as;
+
+    /* string lengths, NULL for nul terminated input strings */
+    size_t* lens;
+} cwColumn;
+
+typedef struct cwBatch cwBatch;
+
+/* returns NULL on a syntax error */
+cwBatch* cw_batch_compile(cwRuntime* cw, const char* expression, const char* const* names, int count);
+void     cw_batch_free(cwRuntime* cw, cwBatch* batch);
+
+/*
+ * evaluates batch for rows rows of inputs, one column per name, and stores
+ * the results in output. numbers are converted to the output column type,
+ * strings in a string column point into the runtime or the inputs.
+ */
+InterpretResult cw_batch_eval(cwRuntime* cw, const cwBatch* batch, const cwColumn* inputs, size_t rows, cwColumn* output);
+
+#endif /* !CLOCKWORK_BATCH_H */
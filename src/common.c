@@ -23,7 +23,16 @@ bool cw_values_equal(cwValue a, cwValue b)
         case VAL_BOOL:   return AS_BOOL(a) == AS_BOOL(b);
         case VAL_INT:    return AS_INT(a) == AS_INT(b);
         case VAL_FLOAT:  return AS_FLOAT(a) == AS_FLOAT(b);
-        case VAL_OBJECT: return AS_OBJECT(a) == AS_OBJECT(b);
+        case VAL_OBJECT:
+            if (AS_OBJECT(a) == AS_OBJECT(b)) return true;
+
+            /* interned strings are equal by identity, views have to compare their text */
+            if (IS_STRING(a) && IS_STRING(b) && (AS_STRING(a)->view || AS_STRING(b)->view))
+            {
+                return AS_STRING(a)->len == AS_STRING(b)->len
+                    && memcmp(AS_RAWSTRING(a), AS_RAWSTRING(b), AS_STRING(a)->len) == 0;
+            }
+            return false;
         }
     }
 
@@ -95,7 +104,9 @@ cwValue* cw_value_div(cwValue* a, const cwValue* b)
     }
     else
     {
-        a->as.ival /= b->as.ival;
+        /* reported as a division by zero by cw_op_fallback */
+        if (b->as.ival == 0) return NULL;
+        a->as.ival = cw_int_div(a->as.ival, b->as.ival);
         a->type = VAL_INT;
     }
 
@@ -143,12 +154,35 @@ static void cw_object_free(cwObject* object)
         cw_reallocate(object, sizeof(cwString), 0);
         break;
     }
+    case OBJ_FUNCTION:
+    {
+        cwFunction* function = (cwFunction*)object;
+        cw_chunk_free(&function->chunk);
+        cw_reallocate(object, sizeof(cwFunction), 0);
+        break;
+    }
+    case OBJ_NATIVE:
+        cw_reallocate(object, sizeof(cwNative), 0);
+        break;
+    case OBJ_INT_ARRAY:
+    case OBJ_FLOAT_ARRAY:
+    {
+        cwArray* array = (cwArray*)object;
+        CW_FREE_ARRAY(int32_t, array->as.ints, array->len);
+        cw_reallocate(object, sizeof(cwArray), 0);
+        break;
+    }
     }
 }
 
 void cw_free_objects(cwRuntime* cw)
 {
-    cwObject* object = cw->objects;
+    cw_free_object_list(cw->objects);
+}
+
+void cw_free_object_list(cwObject* objects)
+{
+    cwObject* object = objects;
     while (object != NULL)
     {
         cwObject* next = object->next;
@@ -157,6 +191,38 @@ void cw_free_objects(cwRuntime* cw)
     }
 }
 
+/* --------------------------| functions |----------------------------------------------- */
+cwFunction* cw_function_new(cwRuntime* cw)
+{
+    cwFunction* function = (cwFunction*)cw_object_alloc(cw, sizeof(cwFunction), OBJ_FUNCTION);
+    function->name = NULL;
+    function->arity = 0;
+    function->memo = -1;
+    function->compiled = NULL;
+    cw_chunk_init(&function->chunk);
+    return function;
+}
+
+cwNative* cw_native_new(cwRuntime* cw, cwString* name, cwNativeFn function, int arity)
+{
+    cwNative* native = (cwNative*)cw_object_alloc(cw, sizeof(cwNative), OBJ_NATIVE);
+    native->name = name;
+    native->function = function;
+    native->arity = arity;
+    return native;
+}
+
+/* --------------------------| arrays |-------------------------------------------------- */
+cwArray* cw_array_new(cwRuntime* cw, cwObjectType type, size_t len)
+{
+    /* int32 and float elements have the same size */
+    cwArray* array = (cwArray*)cw_object_alloc(cw, sizeof(cwArray), type);
+    array->len = len;
+    array->as.ints = len ? CW_ALLOCATE(int32_t, len) : NULL;
+    if (len) memset(array->as.ints, 0, len * sizeof(int32_t));
+    return array;
+}
+
 /* --------------------------| strings |------------------------------------------------- */
 static cwString* cw_str_alloc(cwRuntime* cw, char* src, size_t len, uint32_t hash)
 {
@@ -164,6 +230,7 @@ static cwString* cw_str_alloc(cwRuntime* cw, char* src, size_t len, uint32_t has
     str->raw = src;
     str->len = len;
     str->hash = hash;
+    str->view = false;
 
     cw_table_insert(&cw->strings, str, MAKE_NULL());
 
@@ -185,7 +252,12 @@ cwString* cw_str_take(cwRuntime* cw, char* src, size_t len)
 
 cwString* cw_str_copy(cwRuntime* cw, const char* src, size_t len)
 {
-    uint32_t hash = cw_hash_str(src, len);
+    return cw_str_copy_hashed(cw, src, len, cw_hash_str(src, len));
+}
+
+/* hash has to be cw_hash_str(src, len), e.g. as computed by the scanner */
+cwString* cw_str_copy_hashed(cwRuntime* cw, const char* src, size_t len, uint32_t hash)
+{
     cwString* interned = cw_table_find_key(&cw->strings, src, len, hash);
     if (interned != NULL) return interned;
 
@@ -206,13 +278,25 @@ cwString* cw_str_concat(cwRuntime* cw, cwString* a, cwString* b)
     return cw_str_take(cw, raw, len);
 }
 
+cwString* cw_find_str(cwRuntime* cw, const char* str, size_t len)
+{
+    return cw_table_find_key(&cw->strings, str, len, cw_hash_str(str, len));
+}
+
+cwValue cw_str_view(cwString* view, const char* str, size_t len)
+{
+    view->obj.type = OBJ_STRING;
+    view->obj.next = NULL;
+    view->raw = (char*)str;
+    view->len = len;
+    view->hash = 0;
+    view->view = true;
+    return MAKE_OBJECT(view);
+}
+
 uint32_t cw_hash_str(const char* str, size_t len)
 {
-    uint32_t hash = 2166136261u;
-    for (size_t i = 0; i < len; i++)
-    {
-        hash ^= (uint8_t)str[i];
-        hash *= 16777619;
-    }
+    uint32_t hash = CW_HASH_SEED;
+    for (size_t i = 0; i < len; i++) hash = cw_hash_byte(hash, str[i]);
     return hash;
 }
\ No newline at end of file
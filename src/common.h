@@ -12,6 +12,10 @@ typedef struct cwToken cwToken;
 typedef struct cwObject cwObject;
 typedef struct cwString cwString;
 typedef struct cwFunction cwFunction;
+typedef struct cwNative cwNative;
+typedef struct cwArray cwArray;
+typedef struct cwProgram cwProgram;
+typedef struct cwMemo cwMemo;
 
 /* value */
 typedef enum
@@ -26,7 +30,6 @@ typedef enum
 typedef struct
 {
     cwValueType type;
-    bool mut;
     union
     {
         int32_t ival;
@@ -46,16 +49,19 @@ static inline bool cw_is_number(cwValue val) { return val.type > VAL_NULL && val
 static inline int32_t cw_valtoi(cwValue val) { return IS_FLOAT(val) ? (int32_t)val.as.fval : val.as.ival; }
 static inline float   cw_valtof(cwValue val) { return IS_FLOAT(val) ? val.as.fval : (float)val.as.ival; }
 
+/* a / b for b != 0, INT32_MIN / -1 wraps like the other int operations instead of trapping */
+static inline int32_t cw_int_div(int32_t a, int32_t b) { return b == -1 ? (int32_t)(0u - (uint32_t)a) : a / b; }
+
 #define AS_BOOL(value)    ((value).as.ival)
 #define AS_INT(value)     (cw_valtoi(value))
 #define AS_FLOAT(value)   (cw_valtof(value))
 #define AS_OBJECT(value)  ((value).as.object)
 
-#define MAKE_NULL(val)    ((cwValue){ .type = VAL_NULL,   .mut = false, { .ival = 0 }})
-#define MAKE_BOOL(val)    ((cwValue){ .type = VAL_BOOL,   .mut = false, { .ival = val }})
-#define MAKE_INT(val)     ((cwValue){ .type = VAL_INT,    .mut = false, { .ival = val }})
-#define MAKE_FLOAT(val)   ((cwValue){ .type = VAL_FLOAT,  .mut = false, { .fval = val }})
-#define MAKE_OBJECT(obj)  ((cwValue){ .type = VAL_OBJECT, .mut = false, { .object = (cwObject*)obj }})
+#define MAKE_NULL(val)    ((cwValue){ .type = VAL_NULL,   { .ival = 0 }})
+#define MAKE_BOOL(val)    ((cwValue){ .type = VAL_BOOL,   { .ival = val }})
+#define MAKE_INT(val)     ((cwValue){ .type = VAL_INT,    { .ival = val }})
+#define MAKE_FLOAT(val)   ((cwValue){ .type = VAL_FLOAT,  { .fval = val }})
+#define MAKE_OBJECT(obj)  ((cwValue){ .type = VAL_OBJECT, { .object = (cwObject*)obj }})
 
 cwValue* cw_value_add(cwValue* a, const cwValue* b);
 cwValue* cw_value_sub(cwValue* a, const cwValue* b);
@@ -88,6 +94,10 @@ void cw_chunk_free(cwChunk* chunk);
 typedef enum
 {
     OBJ_STRING,
+    OBJ_FUNCTION,
+    OBJ_NATIVE,
+    OBJ_INT_ARRAY,
+    OBJ_FLOAT_ARRAY,
 } cwObjectType;
 
 struct cwObject
@@ -96,12 +106,21 @@ struct cwObject
     cwObject* next;
 };
 
+/* returned by a compiled body that replaced its frame by a tail call, cw_run_frame runs the callee */
+#define CW_TAIL_CALLED  -1
+
 struct cwFunction
 {
     cwObject obj;
     cwString* name;
     cwChunk chunk;
     int arity;
+
+    /* index of its result cache if declared pure, -1 otherwise, see memo.h */
+    int memo;
+
+    /* ahead-of-time compiled body returning an InterpretResult or CW_TAIL_CALLED, see aot.h */
+    int (*compiled)(cwRuntime* cw);
 };
 
 static inline bool cw_is_obj_type(cwValue value, cwObjectType type) 
@@ -111,11 +130,56 @@ static inline bool cw_is_obj_type(cwValue value, cwObjectType type)
 
 #define OBJECT_TYPE(value)  (AS_OBJECT(value)->type)
 #define IS_STRING(value)    cw_is_obj_type(value, OBJ_STRING)
+#define IS_FUNCTION(value)  cw_is_obj_type(value, OBJ_FUNCTION)
+#define IS_NATIVE(value)    cw_is_obj_type(value, OBJ_NATIVE)
+#define IS_INT_ARRAY(value) cw_is_obj_type(value, OBJ_INT_ARRAY)
+#define IS_ARRAY(value)     (IS_INT_ARRAY(value) || cw_is_obj_type(value, OBJ_FLOAT_ARRAY))
 
 #define AS_STRING(value)    ((cwString*)AS_OBJECT(value))
 #define AS_RAWSTRING(value) (AS_STRING(value)->raw)
+#define AS_FUNCTION(value)  ((cwFunction*)AS_OBJECT(value))
+#define AS_NATIVE(value)    ((cwNative*)AS_OBJECT(value))
+#define AS_ARRAY(value)     ((cwArray*)AS_OBJECT(value))
 
 void cw_free_objects(cwRuntime* cw);
+void cw_free_object_list(cwObject* objects);
+
+/* functions */
+cwFunction* cw_function_new(cwRuntime* cw);
+
+/*
+ * a function implemented in C, args points to its argc arguments on the VM
+ * stack. result is the callee's slot right below them and receives the return
+ * value, errors are raised with cw_runtime_error and reported by returning false
+ */
+typedef bool (*cwNativeFn)(cwRuntime* cw, cwValue* args, int argc, cwValue* result);
+
+struct cwNative
+{
+    cwObject obj;
+    cwString* name;
+    cwNativeFn function;
+
+    /* -1 accepts any number of arguments */
+    int arity;
+};
+
+cwNative* cw_native_new(cwRuntime* cw, cwString* name, cwNativeFn function, int arity);
+
+/* typed arrays of int32 (OBJ_INT_ARRAY) or float (OBJ_FLOAT_ARRAY) elements, see array.h */
+struct cwArray
+{
+    cwObject obj;
+    size_t len;
+    union
+    {
+        int32_t* ints;
+        float* floats;
+    } as;
+};
+
+/* returns a zero initialized array of len elements */
+cwArray* cw_array_new(cwRuntime* cw, cwObjectType type, size_t len);
 
 /* strings */
 struct cwString
@@ -124,13 +188,24 @@ struct cwString
     char* raw;
     size_t len;
     uint32_t hash;
+
+    /* borrowed from the host, not interned and not owned by the runtime */
+    bool view;
 };
 
 cwString* cw_str_take(cwRuntime* cw, char* src, size_t len);
 cwString* cw_str_copy(cwRuntime* cw, const char* src, size_t len);
+cwString* cw_str_copy_hashed(cwRuntime* cw, const char* src, size_t len, uint32_t hash);
 cwString* cw_str_concat(cwRuntime* cw, cwString* a, cwString* b);
 
 cwString* cw_find_str(cwRuntime* cw, const char* str, size_t len);
+
+/* a view on str that lives in the host's memory, see cw_call */
+cwValue cw_str_view(cwString* view, const char* str, size_t len);
 uint32_t cw_hash_str(const char* str, size_t len);
 
+/* fnv-1a, one byte at a time for callers that hash while they scan */
+#define CW_HASH_SEED 2166136261u
+static inline uint32_t cw_hash_byte(uint32_t hash, char c) { return (hash ^ (uint8_t)c) * 16777619u; }
+
 #endif /* !CLOCKWORK_COMMON_H */
@@ -8,37 +8,92 @@
 #include "statement.h"
 
 #include "debug.h"
+#include "flow.h"
 #include "memory.h"
+#include "optimize.h"
+#include "register.h"
 #include "runtime.h"
+#include "typing.h"
 
 
 /* --------------------------| identifiers |--------------------------------------------- */
-uint8_t cw_make_constant(cwRuntime* cw, cwValue val)
+bool cw_same_constant(cwValue a, cwValue b)
 {
-    if (cw->chunk->const_cap < cw->chunk->const_len + 1)
+    if (a.type != b.type) return false;
+
+    switch (a.type)
+    {
+    case VAL_NULL:   return true;
+    case VAL_OBJECT: return AS_OBJECT(a) == AS_OBJECT(b);
+    default:         return a.as.ival == b.as.ival;   /* bits of floats, nan and -0 included */
+    }
+}
+
+static uint32_t cw_constant_hash(cwValue value)
+{
+    switch (value.type)
+    {
+    case VAL_NULL:   return 0;
+    case VAL_OBJECT: return IS_STRING(value) ? AS_STRING(value)->hash : (uint32_t)((uintptr_t)AS_OBJECT(value) >> 4);
+    default:         return ((uint32_t)value.as.ival ^ value.type) * 2654435761u;
+    }
+}
+
+int cw_make_constant(cwRuntime* cw, cwValue val)
+{
+    cwCompiler* compiler = cw->parser->compiler;
+    cwChunk* chunk = cw->parser->chunk;
+    int* bucket = &compiler->constant_buckets[(cw_constant_hash(val) >> 8) & (CW_CONSTANT_BUCKETS - 1)];
+    for (int i = *bucket; i >= 0; i = compiler->constant_next[i])
     {
-        int old_cap = cw->chunk->const_cap;
-        cw->chunk->const_cap = CW_GROW_CAPACITY(old_cap);
-        cw->chunk->constants = CW_GROW_ARRAY(cwValue, cw->chunk->constants, old_cap, cw->chunk->const_cap);
+        if (cw_same_constant(chunk->constants[i], val)) return i;
     }
 
-    cw->chunk->constants[cw->chunk->const_len] = val;
-    if (cw->chunk->const_len > UINT8_MAX)
+    if (chunk->const_len >= CW_CONSTANTS_MAX)
     {
-        cw_syntax_error_at(cw, &cw->previous, "Too many constants in one chunk.");
+        cw_syntax_error_at(cw, &cw->parser->previous, "Too many constants in one chunk.");
         return 0;
     }
 
-    return (uint8_t)cw->chunk->const_len++;
+    if (chunk->const_cap < chunk->const_len + 1)
+    {
+        int old_cap = chunk->const_cap;
+        chunk->const_cap = CW_GROW_CAPACITY(old_cap);
+        chunk->constants = CW_GROW_ARRAY(cwValue, chunk->constants, old_cap, chunk->const_cap);
+    }
+
+    if (compiler->constant_capacity < (int)chunk->const_len + 1)
+    {
+        int old_cap = compiler->constant_capacity;
+        compiler->constant_capacity = CW_GROW_CAPACITY(old_cap);
+        compiler->constant_next = CW_GROW_ARRAY(int, compiler->constant_next, old_cap, compiler->constant_capacity);
+    }
+
+    int index = (int)chunk->const_len++;
+    chunk->constants[index] = val;
+    compiler->constant_next[index] = *bucket;
+    *bucket = index;
+    return index;
 }
 
-uint8_t cw_identifier_constant(cwRuntime* cw, cwToken* name)
+/* drops the constant added last, it heads its bucket */
+void cw_pop_constant(cwRuntime* cw)
 {
-    return cw_make_constant(cw, MAKE_OBJECT(cw_str_copy(cw, name->start, name->end - name->start)));
+    cwCompiler* compiler = cw->parser->compiler;
+    int index = (int)--cw->parser->chunk->const_len;
+    cwValue val = cw->parser->chunk->constants[index];
+    compiler->constant_buckets[(cw_constant_hash(val) >> 8) & (CW_CONSTANT_BUCKETS - 1)] = compiler->constant_next[index];
+}
+
+int cw_identifier_constant(cwRuntime* cw, cwToken* name)
+{
+    return cw_make_constant(cw, MAKE_OBJECT(cw_str_copy_hashed(cw, name->start, name->end - name->start, name->hash)));
 }
 
 bool cw_identifiers_equal(const cwToken* a, const cwToken* b)
 {
+    if (a->hash != b->hash) return false;
+
     int a_len = a->end - a->start;
     int b_len = b->end - b->start;
     return (a_len == b_len) ? memcmp(a->start, b->start, a_len) == 0 : false;
@@ -47,30 +102,439 @@ bool cw_identifiers_equal(const cwToken* a, const cwToken* b)
 /* --------------------------| locals |-------------------------------------------------- */
 void cw_add_local(cwRuntime* cw, cwToken* name)
 {
-    if (cw->local_count > UINT8_MAX)
+    cwCompiler* compiler = cw->parser->compiler;
+    if (compiler->local_count >= CW_LOCALS_MAX)
     {
-        cw_syntax_error_at(cw, &cw->previous, "Too many variables in scope.");
+        cw_syntax_error_at(cw, &cw->parser->previous, "Too many variables in scope.");
         return;
     }
 
-    cwLocal* local = &cw->locals[cw->local_count++];
+    if (compiler->local_count == compiler->local_capacity)
+    {
+        int old_cap = compiler->local_capacity;
+        compiler->local_capacity = CW_GROW_CAPACITY(old_cap);
+        compiler->locals = CW_GROW_ARRAY(cwLocal, compiler->locals, old_cap, compiler->local_capacity);
+    }
+
+    int index = compiler->local_count++;
+    int* bucket = &compiler->buckets[name->hash & (CW_LOCAL_BUCKETS - 1)];
+
+    cwLocal* local = &compiler->locals[index];
     local->name = *name;
     local->depth = -1;
+    local->next = *bucket;
+    local->mut = true;
+    local->known = false;
+    *bucket = index;
+}
+
+/* locals are popped in reverse order, the innermost one always heads its bucket */
+void cw_pop_local(cwRuntime* cw)
+{
+    cwCompiler* compiler = cw->parser->compiler;
+    cwLocal* local = &compiler->locals[--compiler->local_count];
+    compiler->buckets[local->name.hash & (CW_LOCAL_BUCKETS - 1)] = local->next;
+}
+
+/* innermost local called name or -1 */
+int cw_find_local(const cwCompiler* compiler, const cwToken* name)
+{
+    int i = compiler->buckets[name->hash & (CW_LOCAL_BUCKETS - 1)];
+    while (i >= 0 && !cw_identifiers_equal(name, &compiler->locals[i].name)) i = compiler->locals[i].next;
+    return i;
 }
 
 int cw_resolve_local(cwRuntime* cw, cwToken* name)
 {
-    for (int i = cw->local_count - 1; i >= 0; i--)
+    int i = cw_find_local(cw->parser->compiler, name);
+    if (i >= 0 && cw->parser->compiler->locals[i].depth < 0)
+        cw_syntax_error_at(cw, name, "Can not read local variable in its own initializer.");
+    return i;
+}
+
+/* --------------------------| instructions |------------------------------------------- */
+int cw_op_length(const uint8_t* ip)
+{
+    switch (ip[0])
+    {
+    case OP_CONSTANT:
+    case OP_SET_LOCAL:  case OP_GET_LOCAL:
+    case OP_DEF_GLOBAL: case OP_SET_GLOBAL: case OP_GET_GLOBAL:
+    case OP_INC_LOCAL:  case OP_INC_GLOBAL:
+    case OP_DEC_LOCAL:  case OP_DEC_GLOBAL:
+    case OP_ADD_LOCAL:  case OP_ADD_GLOBAL:
+    case OP_SUB_LOCAL:  case OP_SUB_GLOBAL:
+    case OP_MULT_LOCAL: case OP_MULT_GLOBAL:
+    case OP_DIV_LOCAL:  case OP_DIV_GLOBAL:
+    case OP_CALL:       case OP_TAIL_CALL:
+    case OP_ARRAY:
+        return 2;
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_FALSE_BOOL:
+    case OP_JUMP:
+    case OP_LOOP:
+        return 3;
+    case OP_R_MOVE:
+        return 4;
+    case OP_R_ADD: case OP_R_SUB: case OP_R_MULT: case OP_R_DIV:
+    case OP_R_EQ:  case OP_R_NOTEQ:
+    case OP_R_LT:  case OP_R_LTEQ:
+    case OP_R_GT:  case OP_R_GTEQ:
+        return 5;
+    case OP_R_BRANCH:
+        return 6;
+    case OP_WIDE:
+        /* one more byte for a slot, two more for a jump offset */
+        return 1 + cw_op_length(ip + 1) + (cw_is_jump(ip[1]) ? 2 : 1);
+    default:
+        return 1;
+    }
+}
+
+int cw_stack_effect(const uint8_t* ip, int* pops, int* pushes)
+{
+    bool wide = ip[0] == OP_WIDE;
+    int taken = 0;
+    int put = 0;
+    switch (cw_generic_op(ip[wide]))
+    {
+    case OP_CONSTANT: case OP_NULL: case OP_TRUE: case OP_FALSE:
+    case OP_GET_LOCAL: case OP_GET_GLOBAL:
+        put = 1;
+        break;
+    case OP_POP: case OP_DEF_GLOBAL: case OP_PRINT: case OP_RETURN:
+    case OP_ADD_LOCAL:  case OP_SUB_LOCAL:  case OP_MULT_LOCAL:  case OP_DIV_LOCAL:
+    case OP_ADD_GLOBAL: case OP_SUB_GLOBAL: case OP_MULT_GLOBAL: case OP_DIV_GLOBAL:
+        taken = 1;
+        break;
+    case OP_SET_LOCAL: case OP_SET_GLOBAL:
+    case OP_NEGATE: case OP_NOT:
+        taken = put = 1;
+        break;
+    case OP_EQ: case OP_NOTEQ: case OP_LT: case OP_LTEQ: case OP_GT: case OP_GTEQ:
+    case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+    case OP_GET_INDEX:
+        taken = 2;
+        put = 1;
+        break;
+    case OP_SET_INDEX:
+        taken = 3;
+        put = 1;
+        break;
+    case OP_ARRAY:
+        taken = ip[1];
+        put = 1;
+        break;
+    case OP_CALL: case OP_TAIL_CALL:
+        /* the result takes the place of the callee */
+        taken = ip[1] + 1;
+        put = 1;
+        break;
+    default:
+        break;
+    }
+
+    if (pops) *pops = taken;
+    if (pushes) *pushes = put;
+    return put - taken;
+}
+
+int cw_op_arg(const uint8_t* ip)
+{
+    return ip[0] == OP_WIDE ? (ip[2] << 8) | ip[3] : ip[1];
+}
+
+uint8_t cw_generic_op(uint8_t op)
+{
+    /* the typed variants follow the order of their generic opcodes */
+    if (op >= OP_EQ_INT && op <= OP_DIV_INT)    return OP_EQ + (op - OP_EQ_INT);
+    if (op >= OP_LT_FLOAT && op <= OP_DIV_FLOAT) return OP_LT + (op - OP_LT_FLOAT);
+    if (op == OP_NOT_BOOL)                       return OP_NOT;
+    if (op == OP_JUMP_IF_FALSE_BOOL)             return OP_JUMP_IF_FALSE;
+    return op;
+}
+
+/* moves a slot at or above base by count, false if it no longer fits */
+static bool cw_shift_slot(uint8_t* slot, int base, int count, bool apply)
+{
+    if (*slot < base) return true;
+    if (*slot + count > UINT8_MAX) return false;
+    if (apply) *slot += count;
+    return true;
+}
+
+bool cw_shift_slots(cwChunk* chunk, int begin, int end, int base, int count, bool apply)
+{
+    for (int at = begin; at < end; at += cw_op_length(chunk->bytes + at))
     {
-        cwLocal* local = &cw->locals[i]; 
-        if (cw_identifiers_equal(name, &local->name))
+        bool wide = chunk->bytes[at] == OP_WIDE;
+        uint8_t op = chunk->bytes[at + wide];
+        uint8_t* operands = chunk->bytes + at + wide + 1;
+
+        /* local and global in-place updates alternate */
+        bool fits = true;
+        if (op == OP_GET_LOCAL || op == OP_SET_LOCAL || (op >= OP_INC_LOCAL && op <= OP_DIV_GLOBAL && (op - OP_INC_LOCAL) % 2 == 0))
+        {
+            if (!wide)
+            {
+                fits = cw_shift_slot(operands, base, count, apply);
+            }
+            else
+            {
+                int slot = (operands[0] << 8) | operands[1];
+                if (slot >= base) slot += count;
+                fits = slot < CW_LOCALS_MAX;
+                if (fits && apply)
+                {
+                    operands[0] = (slot >> 8) & 0xff;
+                    operands[1] = slot & 0xff;
+                }
+            }
+        }
+        else if (op == OP_R_BRANCH)
+        {
+            fits = (CW_RK_IS_CONST(operands[0], CW_RK_B) || cw_shift_slot(operands + 1, base, count, apply))
+                && (CW_RK_IS_CONST(operands[0], CW_RK_C) || cw_shift_slot(operands + 2, base, count, apply));
+        }
+        else if (op >= OP_R_MOVE && op <= OP_R_GTEQ)
         {
-            if (local->depth < 0) 
-                cw_syntax_error_at(cw, name, "Can not read local variable in its own initializer.");
-            return i;
-        } 
+            /* the destination is always a slot, a move has no c */
+            fits = cw_shift_slot(operands + 1, base, count, apply)
+                && (CW_RK_IS_CONST(operands[0], CW_RK_B) || cw_shift_slot(operands + 2, base, count, apply))
+                && (op == OP_R_MOVE || CW_RK_IS_CONST(operands[0], CW_RK_C) || cw_shift_slot(operands + 3, base, count, apply));
+        }
+        if (!fits) return false;
     }
-    return -1;
+    return true;
+}
+
+/* --------------------------| jumps |--------------------------------------------------- */
+bool cw_is_jump(uint8_t op)
+{
+    return op == OP_JUMP || op == OP_JUMP_IF_FALSE || op == OP_JUMP_IF_FALSE_BOOL || op == OP_LOOP || op == OP_R_BRANCH;
+}
+
+/* offset of the jump distance of the jump at offset */
+static int cw_jump_operand(const uint8_t* code, int offset)
+{
+    if (code[offset] == OP_WIDE) offset++;
+    return offset + (code[offset] == OP_R_BRANCH ? 4 : 1);
+}
+
+int cw_jump_target(const uint8_t* code, int offset)
+{
+    bool wide = code[offset] == OP_WIDE;
+    const uint8_t* operand = code + cw_jump_operand(code, offset);
+
+    uint32_t jump = (uint32_t)((operand[0] << 8) | operand[1]);
+    if (wide) jump = (jump << 16) | (uint32_t)((operand[2] << 8) | operand[3]);
+
+    int next = offset + cw_op_length(code + offset);
+    return code[offset + wide] == OP_LOOP ? next - (int)jump : next + (int)jump;
+}
+
+void cw_write_jump(uint8_t* code, int offset, int target)
+{
+    int next = offset + cw_op_length(code + offset);
+    uint32_t jump = (uint32_t)(target > next ? target - next : next - target);
+
+    uint8_t* operand = code + cw_jump_operand(code, offset);
+    if (code[offset] == OP_WIDE)
+    {
+        *operand++ = (jump >> 24) & 0xff;
+        *operand++ = (jump >> 16) & 0xff;
+    }
+    operand[0] = (jump >> 8) & 0xff;
+    operand[1] = jump & 0xff;
+}
+
+/* puts a wide prefix in front of the short jump at offset, widening its distance by two bytes */
+static void cw_widen_jump(cwChunk* chunk, int offset)
+{
+    int len = cw_op_length(chunk->bytes + offset);
+    int line = chunk->lines[offset];
+    for (int i = 0; i < 3; ++i) cw_emit_byte(chunk, 0, line);
+
+    /* the code behind moves up by three, the opcode and any register operands by one */
+    int tail = offset + len;
+    memmove(chunk->bytes + tail + 3, chunk->bytes + tail, chunk->len - 3 - tail);
+    memmove(chunk->lines + tail + 3, chunk->lines + tail, (chunk->len - 3 - tail) * sizeof(int));
+    memmove(chunk->bytes + offset + 1, chunk->bytes + offset, len - 2);
+    for (int i = tail; i < tail + 3; ++i) chunk->lines[i] = line;
+    chunk->bytes[offset] = OP_WIDE;
+}
+
+/* moves a code offset kept by the parser behind a widened jump */
+static void cw_shift_offset(int* offset, int at)
+{
+    if (*offset > at) *offset += 3;
+}
+
+/*
+ * widens the jump at offset, which is about to target target, and every
+ * other jump that no longer reaches its target once code moved. unpatched
+ * jumps target their own end, nothing is ever widened in between. returns
+ * how far the code right behind the jump at offset moved.
+ */
+static int cw_widen_jumps(cwRuntime* cw, int offset, int target)
+{
+    cwChunk* chunk = cw->parser->chunk;
+
+    int capacity = 0;
+    for (int at = 0; at < chunk->len; at += cw_op_length(chunk->bytes + at))
+        capacity += cw_is_jump(chunk->bytes[at]) || chunk->bytes[at] == OP_WIDE;
+
+    int* jumps = CW_ALLOCATE(int, capacity);
+    int* targets = CW_ALLOCATE(int, capacity);
+    int count = 0;
+    for (int at = 0; at < chunk->len; at += cw_op_length(chunk->bytes + at))
+    {
+        uint8_t op = chunk->bytes[at];
+        if (op == OP_WIDE) op = chunk->bytes[at + 1];
+        if (!cw_is_jump(op)) continue;
+
+        jumps[count] = at;
+        targets[count++] = (at == offset) ? target : cw_jump_target(chunk->bytes, at);
+    }
+
+    int moved = 0;
+    bool widened = true;
+    while (widened)
+    {
+        widened = false;
+        for (int i = 0; i < count; ++i)
+        {
+            int at = jumps[i];
+            if (chunk->bytes[at] == OP_WIDE) continue;
+
+            int next = at + cw_op_length(chunk->bytes + at);
+            int distance = targets[i] > next ? targets[i] - next : next - targets[i];
+            if (distance <= UINT16_MAX) continue;
+
+            cw_widen_jump(chunk, at);
+            if (at <= offset) moved += 3;
+            cw_shift_offset(&offset, at);
+            for (int j = 0; j < count; ++j)
+            {
+                cw_shift_offset(&jumps[j], at);
+                cw_shift_offset(&targets[j], at);
+            }
+            cw_shift_offset(&cw->parser->inplace_start, at);
+            cw_shift_offset(&cw->parser->inplace_end, at);
+            cw_shift_offset(&cw->parser->inplace_value, at);
+            cw_shift_offset(&cw->parser->compiler->last_call, at);
+            widened = true;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) cw_write_jump(chunk->bytes, jumps[i], targets[i]);
+
+    CW_FREE_ARRAY(int, jumps, capacity);
+    CW_FREE_ARRAY(int, targets, capacity);
+    return moved;
+}
+
+/* --------------------------| blocks |-------------------------------------------------- */
+bool cw_falls_through(uint8_t op)
+{
+    return op != OP_JUMP && op != OP_LOOP && op != OP_RETURN;
+}
+
+/* first kept instruction at or after offset, the end of the code if there is none */
+static int cw_next_live(const uint8_t* code, int len, const bool* live, int at)
+{
+    while (live && at < len && !live[at]) at += cw_op_length(code + at);
+    return at;
+}
+
+int cw_basic_blocks(const uint8_t* code, int len, const bool* live, const int* targets,
+                    cwBasicBlock* blocks, int* block_of)
+{
+    /* targets of kept jumps are marked with -2 until their block is known */
+    for (int at = 0; at <= len; ++at) block_of[at] = -1;
+    for (int at = 0; at < len; at += cw_op_length(code + at))
+    {
+        if (live && !live[at]) continue;
+
+        uint8_t op = code[at] == OP_WIDE ? code[at + 1] : code[at];
+        if (cw_is_jump(op)) block_of[cw_next_live(code, len, live, targets ? targets[at] : cw_jump_target(code, at))] = -2;
+    }
+
+    /* blocks start at the entry, at jump targets and behind jumps and returns */
+    int count = 0;
+    bool split = true;
+    for (int at = 0; at < len; at += cw_op_length(code + at))
+    {
+        if (live && !live[at]) continue;
+
+        uint8_t op = code[at] == OP_WIDE ? code[at + 1] : code[at];
+        if (split || block_of[at] == -2) blocks[count++] = (cwBasicBlock){ .first = at };
+        blocks[count - 1].last = at;
+        block_of[at] = count - 1;
+        split = cw_is_jump(op) || op == OP_RETURN;
+    }
+    block_of[len] = -1;
+
+    for (int b = 0; b < count; ++b)
+    {
+        cwBasicBlock* block = &blocks[b];
+        int last = block->last;
+        uint8_t op = code[last] == OP_WIDE ? code[last + 1] : code[last];
+
+        block->succ_count = 0;
+        if (cw_falls_through(op) && b + 1 < count) block->succ[block->succ_count++] = b + 1;
+        if (cw_is_jump(op))
+        {
+            /* a jump to the end leaves the code */
+            int target = cw_next_live(code, len, live, targets ? targets[last] : cw_jump_target(code, last));
+            if (target < len) block->succ[block->succ_count++] = block_of[target];
+        }
+    }
+    return count;
+}
+
+int cw_block_depths(const uint8_t* code, const cwBasicBlock* blocks, int count, int entry, int* depths)
+{
+    for (int b = 0; b < count; ++b) depths[b] = -1;
+    if (count == 0) return entry;
+
+    int* work = CW_ALLOCATE(int, count);
+    int top = 0;
+    depths[0] = entry;
+    work[top++] = 0;
+
+    int max_depth = entry;
+    while (top > 0 && max_depth >= 0)
+    {
+        int b = work[--top];
+        const cwBasicBlock* block = &blocks[b];
+        int depth = depths[b];
+        for (int at = block->first; at <= block->last; at += cw_op_length(code + at))
+        {
+            int pops, pushes;
+            cw_stack_effect(code + at, &pops, &pushes);
+            if (depth < pops) max_depth = -1;
+            depth += pushes - pops;
+            if (max_depth >= 0 && depth > max_depth) max_depth = depth;
+        }
+
+        for (int s = 0; s < block->succ_count && max_depth >= 0; ++s)
+        {
+            int succ = block->succ[s];
+            if (depths[succ] < 0)
+            {
+                depths[succ] = depth;
+                work[top++] = succ;
+            }
+            else if (depths[succ] != depth)
+            {
+                max_depth = -1;
+            }
+        }
+    }
+
+    CW_FREE_ARRAY(int, work, count);
+    return max_depth;
 }
 
 /* --------------------------| writing byte code |--------------------------------------- */
@@ -95,59 +559,146 @@ void cw_emit_bytes(cwChunk* chunk, uint8_t a, uint8_t b, int line)
     cw_emit_byte(chunk, b, line);
 }
 
+void cw_emit_arg(cwChunk* chunk, uint8_t op, int arg, int line)
+{
+    if (arg <= UINT8_MAX)
+    {
+        cw_emit_bytes(chunk, op, (uint8_t)arg, line);
+        return;
+    }
+
+    cw_emit_bytes(chunk, OP_WIDE, op, line);
+    cw_emit_bytes(chunk, (arg >> 8) & 0xff, arg & 0xff, line);
+}
+
 int cw_emit_jump(cwChunk* chunk, uint8_t instruction, int line)
 {
+    /* a distance of 0 until patched */
     cw_emit_byte(chunk, instruction, line);
-    cw_emit_byte(chunk, 0xff, line);
-    cw_emit_byte(chunk, 0xff, line);
-    return chunk->len - 2;
+    cw_emit_byte(chunk, 0, line);
+    cw_emit_byte(chunk, 0, line);
+    return chunk->len - 3;
 }
 
-void cw_patch_jump(cwRuntime* cw, int offset)
+int cw_patch_jump(cwRuntime* cw, int offset)
 {
-    /* -2 to adjust for the bytecode for the jump offset itself. */
-    int jump = cw->chunk->len - offset - 2;
+    cwChunk* chunk = cw->parser->chunk;
 
-    if (jump > UINT16_MAX) cw_syntax_error_at(cw, &cw->previous, "Too much code to jump over.");
+    /* the value in front of the end no longer has to be the one pushed there */
+    cw->parser->callee = -1;
 
-    cw->chunk->bytes[offset] = (jump >> 8) & 0xff;
-    cw->chunk->bytes[offset + 1] = jump & 0xff;
+    int next = offset + cw_op_length(chunk->bytes + offset);
+    if (chunk->len - next > UINT16_MAX) return cw_widen_jumps(cw, offset, chunk->len);
+
+    cw_write_jump(chunk->bytes, offset, chunk->len);
+    return 0;
 }
 
 void cw_emit_loop(cwRuntime* cw, int start)
 {
-    cw_emit_byte(cw->chunk, OP_LOOP, cw->previous.line);
+    cwChunk* chunk = cw->parser->chunk;
+    int line = cw->parser->previous.line;
 
-    int offset = cw->chunk->len - start + 2;
-    if (offset > UINT16_MAX) cw_syntax_error_at(cw, &cw->previous, "Loop body too large.");
+    int offset = chunk->len + 3 - start;
+    if (offset <= UINT16_MAX)
+    {
+        cw_emit_byte(chunk, OP_LOOP, line);
+        cw_emit_bytes(chunk, (offset >> 8) & 0xff, offset & 0xff, line);
+        return;
+    }
 
-    cw_emit_byte(cw->chunk, (offset >> 8) & 0xff, cw->previous.line);
-    cw_emit_byte(cw->chunk, offset & 0xff, cw->previous.line);
+    offset += 3;
+    cw_emit_bytes(chunk, OP_WIDE, OP_LOOP, line);
+    cw_emit_bytes(chunk, (offset >> 24) & 0xff, (offset >> 16) & 0xff, line);
+    cw_emit_bytes(chunk, (offset >> 8) & 0xff, offset & 0xff, line);
 }
 
 /* --------------------------| compiling |----------------------------------------------- */
-static void cw_compiler_end(cwRuntime* cw)
+void cw_compiler_init(cwRuntime* cw, cwCompiler* compiler, cwFunctionType type)
+{
+    compiler->enclosing = cw->parser->compiler;
+    compiler->function = cw_function_new(cw);
+    compiler->type = type;
+    compiler->local_count = 0;
+    compiler->local_capacity = CW_GROW_CAPACITY(0);
+    compiler->locals = CW_ALLOCATE(cwLocal, compiler->local_capacity);
+    compiler->scope_depth = 0;
+    for (int i = 0; i < CW_LOCAL_BUCKETS; ++i) compiler->buckets[i] = -1;
+    for (int i = 0; i < CW_CONSTANT_BUCKETS; ++i) compiler->constant_buckets[i] = -1;
+    compiler->constant_next = NULL;
+    compiler->constant_capacity = 0;
+    compiler->last_call = -1;
+    compiler->stmt_start = 0;
+    compiler->inlined = 0;
+
+    if (type != FUNC_SCRIPT)
+        compiler->function->name = cw_str_copy_hashed(cw, cw->parser->previous.start, cw->parser->previous.end - cw->parser->previous.start,
+                                                      cw->parser->previous.hash);
+
+    /* slot 0 holds the called function */
+    cwLocal* local = &compiler->locals[compiler->local_count++];
+    local->depth = 0;
+    local->name.start = "";
+    local->name.end = local->name.start;
+    local->name.hash = CW_HASH_SEED;
+    local->next = -1;   /* nameless, never looked up */
+    local->mut = false;
+    local->known = false;
+
+    cw->parser->compiler = compiler;
+    cw->parser->chunk = &compiler->function->chunk;
+}
+
+cwFunction* cw_compiler_end(cwRuntime* cw)
 {
-    cw_emit_byte(cw->chunk, OP_RETURN, cw->previous.line);
+    cw_emit_byte(cw->parser->chunk, OP_NULL, cw->parser->previous.line);
+    cw_emit_byte(cw->parser->chunk, OP_RETURN, cw->parser->previous.line);
+
+    cwFunction* function = cw->parser->compiler->function;
+    CW_FREE_ARRAY(cwLocal, cw->parser->compiler->locals, cw->parser->compiler->local_capacity);
+    CW_FREE_ARRAY(int, cw->parser->compiler->constant_next, cw->parser->compiler->constant_capacity);
+    if (!cw->parser->error && cw->optimize) cw_optimize(cw, function);
+    if (!cw->parser->error) cw_flow_simplify(cw->parser->chunk);
+    if (!cw->parser->error) cw_type_specialize(function);
 #ifdef DEBUG_PRINT_CODE
-    if (!cw->error) cw_disassemble_chunk(cw->chunk, "code");
+    if (!cw->parser->error) cw_disassemble_chunk(cw->parser->chunk, function->name ? function->name->raw : "<script>");
 #endif 
+
+    cw->parser->compiler = cw->parser->compiler->enclosing;
+    cw->parser->chunk = cw->parser->compiler ? &cw->parser->compiler->function->chunk : NULL;
+    return function;
 }
 
-bool cw_compile(cwRuntime* cw, const char* src, cwChunk* chunk)
+static cwFunction* cw_compile_source(cwRuntime* cw, const char* src, bool record)
 {
+    cwParser parser;
+    cw->parser = &parser;
+
     /* init first token */
-    cw->current.type = TOKEN_NULL;
-    cw->current.start = src;
-    cw->current.end = src;
-    cw->current.line = 1;
+    cw_lex(&parser.tokens, src);
+    cw->parser->source = src;
+    cw->parser->next = 0;
+    cw->parser->current.type = TOKEN_NULL;
+    cw->parser->current.start = src;
+    cw->parser->current.end = src;
+    cw->parser->current.line = 1;
 
     /* init compiler */
-    cw->chunk = chunk;
-    cw->local_count = 0;
-    cw->scope_depth = 0;
-    cw->error = false;
-    cw->panic = false;
+    cwCompiler compiler;
+    cw->parser->compiler = NULL;
+    cw_compiler_init(cw, &compiler, FUNC_SCRIPT);
+
+    cw->parser->inplace_start = -1;
+    cw->parser->callee = -1;
+    cw->parser->error = false;
+    cw->parser->panic = false;
+
+    /* what is known about globals only sticks if the code gets to run */
+    cw_table_init(&parser.immutables);
+    cw_table_init(&parser.assigned);
+    cw_table_copy(&cw->immutables, &parser.immutables);
+    cw_table_copy(&cw->assigned, &parser.assigned);
+    cw_table_init(&parser.declared);
 
     cw_advance(cw);
 
@@ -156,6 +707,36 @@ bool cw_compile(cwRuntime* cw, const char* src, cwChunk* chunk)
         cw_parse_declaration(cw);
     }
 
-    cw_compiler_end(cw);
-    return !cw->error;
+    cwFunction* function = cw_compiler_end(cw);
+    cw_lex_free(&parser.tokens);
+    cw_table_free(&parser.declared);
+    cw->parser = NULL;
+
+    if (!parser.error && record)
+    {
+        if (parser.immutables.size != cw->immutables.size || parser.assigned.size != cw->assigned.size)
+        {
+            cw->declarations++;
+        }
+        cw_table_free(&cw->immutables);
+        cw_table_free(&cw->assigned);
+        cw->immutables = parser.immutables;
+        cw->assigned = parser.assigned;
+    }
+    else
+    {
+        cw_table_free(&parser.immutables);
+        cw_table_free(&parser.assigned);
+    }
+    return parser.error ? NULL : function;
+}
+
+cwFunction* cw_compile(cwRuntime* cw, const char* src)
+{
+    return cw_compile_source(cw, src, true);
+}
+
+cwFunction* cw_compile_detached(cwRuntime* cw, const char* src)
+{
+    return cw_compile_source(cw, src, false);
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #ifndef CLOCKWORK_COMPILER_H
 #define CLOCKWORK_COMPILER_H
 
+#include "lexer.h"
 #include "scanner.h"
+#include "table.h"
 
 typedef enum
 {
@@ -17,6 +19,13 @@ typedef enum
     OP_DEF_GLOBAL,
     OP_SET_GLOBAL,
     OP_GET_GLOBAL,
+    /* in-place updates (same order for locals and globals) */
+    OP_INC_LOCAL,   OP_INC_GLOBAL,
+    OP_DEC_LOCAL,   OP_DEC_GLOBAL,
+    OP_ADD_LOCAL,   OP_ADD_GLOBAL,
+    OP_SUB_LOCAL,   OP_SUB_GLOBAL,
+    OP_MULT_LOCAL,  OP_MULT_GLOBAL,
+    OP_DIV_LOCAL,   OP_DIV_GLOBAL,
     /* comparison operations */
     OP_EQ, OP_NOTEQ,
     OP_LT, OP_LTEQ,
@@ -28,37 +37,237 @@ typedef enum
     OP_DIVIDE,
     OP_NEGATE,
     OP_NOT,
+    /* typed arrays (see array.h) */
+    OP_ARRAY,
+    OP_GET_INDEX,
+    OP_SET_INDEX,
     /* control flow operations */
     OP_JUMP_IF_FALSE,
     OP_JUMP,
     OP_LOOP,
+    OP_CALL,
+    OP_TAIL_CALL,
     OP_PRINT,
     OP_RETURN,
+    /* three-address register operations (see register.h) */
+    OP_R_MOVE,
+    OP_R_ADD, OP_R_SUB, OP_R_MULT, OP_R_DIV,
+    OP_R_EQ, OP_R_NOTEQ,
+    OP_R_LT, OP_R_LTEQ,
+    OP_R_GT, OP_R_GTEQ,
+    OP_R_BRANCH,
+    /* typed operations on operands proven to have their type (see typing.h) */
+    OP_EQ_INT, OP_NOTEQ_INT,
+    OP_LT_INT, OP_LTEQ_INT,
+    OP_GT_INT, OP_GTEQ_INT,
+    OP_ADD_INT, OP_SUB_INT, OP_MULT_INT, OP_DIV_INT,
+    OP_LT_FLOAT, OP_LTEQ_FLOAT,
+    OP_GT_FLOAT, OP_GTEQ_FLOAT,
+    OP_ADD_FLOAT, OP_SUB_FLOAT, OP_MULT_FLOAT, OP_DIV_FLOAT,
+    OP_NOT_BOOL,
+    OP_JUMP_IF_FALSE_BOOL,
+    /* prefix for operands that do not fit the short form (see below) */
+    OP_WIDE,
 } cwOpCode;
 
+/*
+ * OP_WIDE <op> widens the operand of a local variable op to a 16 bit slot,
+ * that of a constant or global op to a 16 bit constant and the offset of a
+ * jump (OP_R_BRANCH included) to 32 bits, everything else about the
+ * instruction stays the same. The compiler only emits it for slots and
+ * constants above UINT8_MAX and jumps too far for 16 bits: loops know their
+ * distance up front, forward jumps are widened when they are patched.
+ * Register operands stay 8 bit, they fall back to the stack code.
+ */
+#define CW_LOCALS_MAX    (UINT16_MAX + 1)
+#define CW_CONSTANTS_MAX (UINT16_MAX + 1)
+
 typedef struct
 {
     cwToken name;
     int depth;
+
+    /* the local declared before this one in the same bucket, -1 at the end */
+    int next;
+
+    /* let bindings can not be assigned, reads of one bound to a literal become that literal */
+    bool mut;
+    bool known;
+    cwValue value;
 } cwLocal;
 
-bool cw_compile(cwRuntime* cw, const char* src, cwChunk* chunk);
+/* locals are found through buckets by the hash of their name */
+#define CW_LOCAL_BUCKETS 64
+
+/* constants of the chunk are found through buckets by the hash of their value */
+#define CW_CONSTANT_BUCKETS 256
+
+typedef enum
+{
+    FUNC_SCRIPT,
+    FUNC_FUNCTION
+} cwFunctionType;
+
+typedef struct cwCompiler cwCompiler;
+struct cwCompiler
+{
+    cwCompiler* enclosing;
+    cwFunction* function;
+    cwFunctionType type;
+
+    cwLocal* locals;
+    int local_count;
+    int local_capacity;
+    int scope_depth;
+
+    /* innermost local of every bucket, shadowed ones follow through next */
+    int buckets[CW_LOCAL_BUCKETS];
+
+    /* newest constant of every bucket, per constant the one added before it in its bucket or -1 */
+    int constant_buckets[CW_CONSTANT_BUCKETS];
+    int* constant_next;
+    int constant_capacity;
+
+    /* offset of the last emitted OP_CALL, used to detect tail calls */
+    int last_call;
+
+    /* offset of the statement being compiled, the stack holds just the locals there */
+    int stmt_start;
+
+    /* bytes of code inlined into the function so far (see inline.h) */
+    int inlined;
+};
+
+/* parser and compiler state, it lives on the stack of cw_compile */
+typedef struct
+{
+    cwCompiler* compiler;
+    cwChunk* chunk;
+
+    /* code range of the last in-place update and its value read-back */
+    int inplace_start;
+    int inplace_end;
+    int inplace_value;
+
+    /* offset of the last read of a global, a call right behind it calls that global */
+    int callee;
+
+    /* the whole source is lexed up front, next is the token after current */
+    const char* source;
+    cwTokenBuffer tokens;
+    size_t next;
+
+    cwToken current;
+    cwToken previous;
 
-/* constants identitfiers */
-uint8_t cw_make_constant(cwRuntime* cw, cwValue value);
-uint8_t cw_identifier_constant(cwRuntime* cw, cwToken* name);
+    /* 
+     * let globals with their literal (null if they are bound to something else)
+     * and all globals that are assigned, copies of the ones of the runtime that
+     * replace them once the compilation succeeded
+     */
+    Table immutables;
+    Table assigned;
+
+    /*
+     * globals declared by the code compiled so far, they are defined before
+     * any later code runs. declared functions map to their function
+     */
+    Table declared;
+
+    bool error;
+    bool panic;
+} cwParser;
+
+/* returns the top-level script function or NULL on a syntax error */
+cwFunction* cw_compile(cwRuntime* cw, const char* src);
+
+/* like cw_compile for code that never runs as a script, the globals it declares are forgotten */
+cwFunction* cw_compile_detached(cwRuntime* cw, const char* src);
+
+void        cw_compiler_init(cwRuntime* cw, cwCompiler* compiler, cwFunctionType type);
+cwFunction* cw_compiler_end(cwRuntime* cw);
+
+/* constants identitfiers, a value already in the chunk's constants is reused */
+bool cw_same_constant(cwValue a, cwValue b);
+int  cw_make_constant(cwRuntime* cw, cwValue value);
+int  cw_identifier_constant(cwRuntime* cw, cwToken* name);
+void cw_pop_constant(cwRuntime* cw);
 bool cw_identifiers_equal(const cwToken* a, const cwToken* b);
 
 /* locals */
 void cw_add_local(cwRuntime* cw, cwToken* name);
+void cw_pop_local(cwRuntime* cw);
+int  cw_find_local(const cwCompiler* compiler, const cwToken* name);
 int  cw_resolve_local(cwRuntime* cw, cwToken* name);
 
+/* size in bytes of the instruction at ip including its operands and a wide prefix */
+int cw_op_length(const uint8_t* ip);
+
+/*
+ * values the instruction at ip takes off the stack and puts on it, either
+ * may be NULL. assignments put back what they take. returns the change of
+ * the stack depth.
+ */
+int cw_stack_effect(const uint8_t* ip, int* pops, int* pushes);
+
+/* slot, constant or count of an instruction that is neither a jump nor a register one, behind a wide prefix as well */
+int cw_op_arg(const uint8_t* ip);
+
+/* the generic opcode a typed one stands for, any other opcode is returned as it is */
+uint8_t cw_generic_op(uint8_t op);
+
+/* moves the slots at or above base in the code from begin to end by count, false if one would no longer fit */
+bool cw_shift_slots(cwChunk* chunk, int begin, int end, int base, int count, bool apply);
+
+/* jumps, the instruction at offset may be wide */
+bool cw_is_jump(uint8_t op);
+int  cw_jump_target(const uint8_t* code, int offset);
+
+/* encodes the distance from the jump at offset to target, which has to fit */
+void cw_write_jump(uint8_t* code, int offset, int target);
+
+/* a basic block is entered at its first instruction and left behind its last */
+typedef struct
+{
+    int first;          /* offsets of its first and last instruction */
+    int last;
+    int succ[2];        /* blocks it continues in */
+    int succ_count;
+} cwBasicBlock;
+
+/* false for instructions that never continue with the one behind them */
+bool cw_falls_through(uint8_t op);
+
+/*
+ * splits the len bytes of code into basic blocks and returns their number.
+ * instructions whose live entry is false are left out and a jump to one
+ * lands on the next kept instruction, targets replaces the targets encoded
+ * in the jumps. both are indexed by code offset and may be NULL. blocks
+ * needs room for one block per instruction, block_of receives the block of
+ * every kept instruction and -1 elsewhere, len + 1 entries.
+ */
+int cw_basic_blocks(const uint8_t* code, int len, const bool* live, const int* targets,
+                    cwBasicBlock* blocks, int* block_of);
+
+/*
+ * stack heights on entry of the blocks reached from the first one, which
+ * is entered at height entry, -1 for the others. returns the highest
+ * height anywhere in them or -1 if the heights do not add up.
+ */
+int cw_block_depths(const uint8_t* code, const cwBasicBlock* blocks, int count, int entry, int* depths);
+
 /* writing byte code */
 void cw_emit_byte(cwChunk* chunk, uint8_t byte, int line);
 void cw_emit_bytes(cwChunk* chunk, uint8_t a, uint8_t b, int line);
 
+/* op with a slot or constant index, wide if it does not fit a byte */
+void cw_emit_arg(cwChunk* chunk, uint8_t op, int arg, int line);
+
+/* returns the offset of the jump instruction to patch */
 int  cw_emit_jump(cwChunk* chunk, uint8_t instruction, int line);
 void cw_emit_loop(cwRuntime* cw, int start);
-void cw_patch_jump(cwRuntime* cw, int offset);
+
+/* points the jump at the end of the code, returns how far widening jumps moved the code right behind it */
+int  cw_patch_jump(cwRuntime* cw, int offset);
 
 #endif /* !CLOCKWORK_COMPILER_H */
\ No newline at end of file
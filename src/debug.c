@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 
+#include "register.h"
 #include "runtime.h"
 
 void cw_disassemble_chunk(const cwChunk* chunk, const char* name)
@@ -30,6 +31,15 @@ static int cw_disassemble_constant(const char* name, const cwChunk* chunk, int o
     return offset + 2;
 }
 
+static int cw_disassemble_constant_wide(const char* name, const cwChunk* chunk, int offset)
+{
+    int constant = (chunk->bytes[offset + 2] << 8) | chunk->bytes[offset + 3];
+    printf("%-16s %4d '", name, constant);
+    cw_print_value(chunk->constants[constant]);
+    printf("'\n");
+    return offset + 4;
+}
+
 static int cw_disassemble_byte(const char* name, const cwChunk* chunk, int offset)
 {
     uint8_t slot = chunk->bytes[offset + 1];
@@ -37,11 +47,93 @@ static int cw_disassemble_byte(const char* name, const cwChunk* chunk, int offse
     return offset + 2; 
 }
 
-static int cw_disassemble_jump(const char* name, int sign, const cwChunk* chunk, int offset)
+static int cw_disassemble_jump(const char* name, const cwChunk* chunk, int offset)
 {
-    uint16_t jump = (uint16_t)(chunk->bytes[offset + 1] << 8) | chunk->bytes[offset + 2];
-    printf("%-16s %4d -> %d\n", name, offset, offset + 3 + sign * jump);
-    return offset + 3;
+    printf("%-16s %4d -> %d\n", name, offset, cw_jump_target(chunk->bytes, offset));
+    return offset + cw_op_length(chunk->bytes + offset);
+}
+
+static void cw_disassemble_rk(const cwChunk* chunk, uint8_t mode, uint8_t bit, uint8_t operand)
+{
+    if (!CW_RK_IS_CONST(mode, bit))
+    {
+        printf(" r%d", operand);
+        return;
+    }
+
+    printf(" k%d '", operand);
+    cw_print_value(chunk->constants[operand]);
+    printf("'");
+}
+
+static int cw_disassemble_register(const char* name, const cwChunk* chunk, int offset)
+{
+    uint8_t mode = chunk->bytes[offset + 1];
+    printf("%-16s r%d =", name, chunk->bytes[offset + 2]);
+    cw_disassemble_rk(chunk, mode, CW_RK_B, chunk->bytes[offset + 3]);
+    if (chunk->bytes[offset] == OP_R_MOVE)
+    {
+        printf("\n");
+        return offset + 4;
+    }
+
+    cw_disassemble_rk(chunk, mode, CW_RK_C, chunk->bytes[offset + 4]);
+    printf("\n");
+    return offset + 5;
+}
+
+static int cw_disassemble_branch(const cwChunk* chunk, int offset)
+{
+    static const char* comparisons[] = { "==", "!=", "<", "<=", ">", ">=" };
+
+    bool wide = chunk->bytes[offset] == OP_WIDE;
+    const uint8_t* bytes = chunk->bytes + offset + wide;
+    uint8_t mode = bytes[1];
+    printf("%-16s", wide ? "OP_R_BRANCH_W" : "OP_R_BRANCH");
+    cw_disassemble_rk(chunk, mode, CW_RK_B, bytes[2]);
+    printf(" %s", comparisons[CW_RK_CMP(mode)]);
+    cw_disassemble_rk(chunk, mode, CW_RK_C, bytes[3]);
+    printf(" else %d -> %d\n", offset, cw_jump_target(chunk->bytes, offset));
+    return offset + cw_op_length(chunk->bytes + offset);
+}
+
+/* named after the short form with a _W suffix */
+static int cw_disassemble_wide(const cwChunk* chunk, int offset)
+{
+    const uint8_t* bytes = chunk->bytes + offset + 1;
+    const char* name;
+    switch (bytes[0])
+    {
+    case OP_JUMP_IF_FALSE:  return cw_disassemble_jump("OP_JUMP_IF_FALSE_W", chunk, offset);
+    case OP_JUMP_IF_FALSE_BOOL: return cw_disassemble_jump("OP_JUMP_IF_FALSE_BOOL_W", chunk, offset);
+    case OP_JUMP:           return cw_disassemble_jump("OP_JUMP_W", chunk, offset);
+    case OP_LOOP:           return cw_disassemble_jump("OP_LOOP_W", chunk, offset);
+    case OP_R_BRANCH:       return cw_disassemble_branch(chunk, offset);
+    case OP_CONSTANT:       return cw_disassemble_constant_wide("OP_CONSTANT_W", chunk, offset);
+    case OP_DEF_GLOBAL:     return cw_disassemble_constant_wide("OP_DEF_GLOBAL_W", chunk, offset);
+    case OP_SET_GLOBAL:     return cw_disassemble_constant_wide("OP_SET_GLOBAL_W", chunk, offset);
+    case OP_GET_GLOBAL:     return cw_disassemble_constant_wide("OP_GET_GLOBAL_W", chunk, offset);
+    case OP_INC_GLOBAL:     return cw_disassemble_constant_wide("OP_INC_GLOBAL_W", chunk, offset);
+    case OP_DEC_GLOBAL:     return cw_disassemble_constant_wide("OP_DEC_GLOBAL_W", chunk, offset);
+    case OP_ADD_GLOBAL:     return cw_disassemble_constant_wide("OP_ADD_GLOBAL_W", chunk, offset);
+    case OP_SUB_GLOBAL:     return cw_disassemble_constant_wide("OP_SUB_GLOBAL_W", chunk, offset);
+    case OP_MULT_GLOBAL:    return cw_disassemble_constant_wide("OP_MULT_GLOBAL_W", chunk, offset);
+    case OP_DIV_GLOBAL:     return cw_disassemble_constant_wide("OP_DIV_GLOBAL_W", chunk, offset);
+    case OP_SET_LOCAL:      name = "OP_SET_LOCAL_W"; break;
+    case OP_GET_LOCAL:      name = "OP_GET_LOCAL_W"; break;
+    case OP_INC_LOCAL:      name = "OP_INC_LOCAL_W"; break;
+    case OP_DEC_LOCAL:      name = "OP_DEC_LOCAL_W"; break;
+    case OP_ADD_LOCAL:      name = "OP_ADD_LOCAL_W"; break;
+    case OP_SUB_LOCAL:      name = "OP_SUB_LOCAL_W"; break;
+    case OP_MULT_LOCAL:     name = "OP_MULT_LOCAL_W"; break;
+    case OP_DIV_LOCAL:      name = "OP_DIV_LOCAL_W"; break;
+    default:
+        printf("Unknown wide opcode %d\n", bytes[0]);
+        return offset + 2;
+    }
+
+    printf("%-16s %4d\n", name, (bytes[1] << 8) | bytes[2]);
+    return offset + 4;
 }
 
 int  cw_disassemble_instruction(const cwChunk* chunk, int offset)
@@ -65,6 +157,18 @@ int  cw_disassemble_instruction(const cwChunk* chunk, int offset)
     case OP_DEF_GLOBAL:     return cw_disassemble_constant("OP_DEF_GLOBAL", chunk, offset);
     case OP_SET_GLOBAL:     return cw_disassemble_constant("OP_SET_GLOBAL", chunk, offset);
     case OP_GET_GLOBAL:     return cw_disassemble_constant("OP_GET_GLOBAL", chunk, offset);
+    case OP_INC_LOCAL:      return cw_disassemble_byte("OP_INC_LOCAL", chunk, offset);
+    case OP_INC_GLOBAL:     return cw_disassemble_constant("OP_INC_GLOBAL", chunk, offset);
+    case OP_DEC_LOCAL:      return cw_disassemble_byte("OP_DEC_LOCAL", chunk, offset);
+    case OP_DEC_GLOBAL:     return cw_disassemble_constant("OP_DEC_GLOBAL", chunk, offset);
+    case OP_ADD_LOCAL:      return cw_disassemble_byte("OP_ADD_LOCAL", chunk, offset);
+    case OP_ADD_GLOBAL:     return cw_disassemble_constant("OP_ADD_GLOBAL", chunk, offset);
+    case OP_SUB_LOCAL:      return cw_disassemble_byte("OP_SUB_LOCAL", chunk, offset);
+    case OP_SUB_GLOBAL:     return cw_disassemble_constant("OP_SUB_GLOBAL", chunk, offset);
+    case OP_MULT_LOCAL:     return cw_disassemble_byte("OP_MULT_LOCAL", chunk, offset);
+    case OP_MULT_GLOBAL:    return cw_disassemble_constant("OP_MULT_GLOBAL", chunk, offset);
+    case OP_DIV_LOCAL:      return cw_disassemble_byte("OP_DIV_LOCAL", chunk, offset);
+    case OP_DIV_GLOBAL:     return cw_disassemble_constant("OP_DIV_GLOBAL", chunk, offset);
     case OP_EQ:             return cw_disassemble_simple("OP_EQ", offset);
     case OP_NOTEQ:          return cw_disassemble_simple("OP_NOTEQ", offset);
     case OP_LT:             return cw_disassemble_simple("OP_LT", offset);
@@ -77,11 +181,49 @@ int  cw_disassemble_instruction(const cwChunk* chunk, int offset)
     case OP_DIVIDE:         return cw_disassemble_simple("OP_DIVIDE", offset);
     case OP_NEGATE:         return cw_disassemble_simple("OP_NEGATE", offset);
     case OP_NOT:            return cw_disassemble_simple("OP_NOT", offset);
-    case OP_JUMP_IF_FALSE:  return cw_disassemble_jump("OP_JUMP_IF_FALSE", 1, chunk, offset);
-    case OP_JUMP:           return cw_disassemble_jump("OP_JUMP", 1, chunk, offset);
-    case OP_LOOP:           return cw_disassemble_jump("OP_LOOP", -1, chunk, offset);
+    case OP_ARRAY:          return cw_disassemble_byte("OP_ARRAY", chunk, offset);
+    case OP_GET_INDEX:      return cw_disassemble_simple("OP_GET_INDEX", offset);
+    case OP_SET_INDEX:      return cw_disassemble_simple("OP_SET_INDEX", offset);
+    case OP_JUMP_IF_FALSE:  return cw_disassemble_jump("OP_JUMP_IF_FALSE", chunk, offset);
+    case OP_JUMP:           return cw_disassemble_jump("OP_JUMP", chunk, offset);
+    case OP_LOOP:           return cw_disassemble_jump("OP_LOOP", chunk, offset);
+    case OP_CALL:           return cw_disassemble_byte("OP_CALL", chunk, offset);
+    case OP_TAIL_CALL:      return cw_disassemble_byte("OP_TAIL_CALL", chunk, offset);
     case OP_PRINT:          return cw_disassemble_simple("OP_PRINT", offset);
     case OP_RETURN:         return cw_disassemble_simple("OP_RETURN", offset);
+    case OP_R_MOVE:         return cw_disassemble_register("OP_R_MOVE", chunk, offset);
+    case OP_R_ADD:          return cw_disassemble_register("OP_R_ADD", chunk, offset);
+    case OP_R_SUB:          return cw_disassemble_register("OP_R_SUB", chunk, offset);
+    case OP_R_MULT:         return cw_disassemble_register("OP_R_MULT", chunk, offset);
+    case OP_R_DIV:          return cw_disassemble_register("OP_R_DIV", chunk, offset);
+    case OP_R_EQ:           return cw_disassemble_register("OP_R_EQ", chunk, offset);
+    case OP_R_NOTEQ:        return cw_disassemble_register("OP_R_NOTEQ", chunk, offset);
+    case OP_R_LT:           return cw_disassemble_register("OP_R_LT", chunk, offset);
+    case OP_R_LTEQ:         return cw_disassemble_register("OP_R_LTEQ", chunk, offset);
+    case OP_R_GT:           return cw_disassemble_register("OP_R_GT", chunk, offset);
+    case OP_R_GTEQ:         return cw_disassemble_register("OP_R_GTEQ", chunk, offset);
+    case OP_R_BRANCH:       return cw_disassemble_branch(chunk, offset);
+    case OP_EQ_INT:         return cw_disassemble_simple("OP_EQ_INT", offset);
+    case OP_NOTEQ_INT:      return cw_disassemble_simple("OP_NOTEQ_INT", offset);
+    case OP_LT_INT:         return cw_disassemble_simple("OP_LT_INT", offset);
+    case OP_LTEQ_INT:       return cw_disassemble_simple("OP_LTEQ_INT", offset);
+    case OP_GT_INT:         return cw_disassemble_simple("OP_GT_INT", offset);
+    case OP_GTEQ_INT:       return cw_disassemble_simple("OP_GTEQ_INT", offset);
+    case OP_ADD_INT:        return cw_disassemble_simple("OP_ADD_INT", offset);
+    case OP_SUB_INT:        return cw_disassemble_simple("OP_SUB_INT", offset);
+    case OP_MULT_INT:       return cw_disassemble_simple("OP_MULT_INT", offset);
+    case OP_DIV_INT:        return cw_disassemble_simple("OP_DIV_INT", offset);
+    case OP_LT_FLOAT:       return cw_disassemble_simple("OP_LT_FLOAT", offset);
+    case OP_LTEQ_FLOAT:     return cw_disassemble_simple("OP_LTEQ_FLOAT", offset);
+    case OP_GT_FLOAT:       return cw_disassemble_simple("OP_GT_FLOAT", offset);
+    case OP_GTEQ_FLOAT:     return cw_disassemble_simple("OP_GTEQ_FLOAT", offset);
+    case OP_ADD_FLOAT:      return cw_disassemble_simple("OP_ADD_FLOAT", offset);
+    case OP_SUB_FLOAT:      return cw_disassemble_simple("OP_SUB_FLOAT", offset);
+    case OP_MULT_FLOAT:     return cw_disassemble_simple("OP_MULT_FLOAT", offset);
+    case OP_DIV_FLOAT:      return cw_disassemble_simple("OP_DIV_FLOAT", offset);
+    case OP_NOT_BOOL:       return cw_disassemble_simple("OP_NOT_BOOL", offset);
+    case OP_JUMP_IF_FALSE_BOOL: return cw_disassemble_jump("OP_JUMP_IF_FALSE_BOOL", chunk, offset);
+    case OP_WIDE:           return cw_disassemble_wide(chunk, offset);
     default:
         printf("Unknown opcode %d\n", instruction);
         return offset + 1;
@@ -104,29 +246,59 @@ void cw_print_object(cwValue val)
 {
     switch (OBJECT_TYPE(val))
     {
-    case OBJ_STRING: printf("%s", AS_RAWSTRING(val)); break;
+    case OBJ_STRING: printf("%.*s", (int)AS_STRING(val)->len, AS_RAWSTRING(val)); break;
+    case OBJ_FUNCTION:
+    {
+        cwFunction* function = AS_FUNCTION(val);
+        if (function->name) printf("<fn %s>", function->name->raw);
+        else                printf("<script>");
+        break;
+    }
+    case OBJ_NATIVE: printf("<native fn %s>", AS_NATIVE(val)->name->raw); break;
+    case OBJ_INT_ARRAY:
+    case OBJ_FLOAT_ARRAY:
+    {
+        cwArray* array = AS_ARRAY(val);
+        printf("[");
+        for (size_t i = 0; i < array->len; ++i)
+        {
+            if (i) printf(", ");
+            if (IS_INT_ARRAY(val)) printf("%d", array->as.ints[i]);
+            else                   printf("%g", array->as.floats[i]);
+        }
+        printf("]");
+        break;
+    }
     }
 }
 
 void cw_runtime_error(cwRuntime* cw, const char* fmt, ...)
 {
+    cw_output_flush(&cw->output);
+
     va_list args;
     va_start(args, fmt);
     vfprintf(stderr, fmt, args);
     va_end(args);
     fputs("\n", stderr);
 
-    size_t instruction = cw->ip - cw->chunk->bytes - 1;
-    int line = cw->chunk->lines[instruction];
-    fprintf(stderr, "[line %d] in script\n", line);
+    for (int i = cw->frame_count - 1; i >= 0; i--)
+    {
+        cwCallFrame* frame = &cw->frames[i];
+        size_t instruction = frame->ip - frame->chunk->bytes - 1;
+        fprintf(stderr, "[line %d] in ", frame->chunk->lines[instruction]);
+        if (frame->function->name) fprintf(stderr, "%s()\n", frame->function->name->raw);
+        else                       fprintf(stderr, "script\n");
+    }
+
     cw_reset_stack(cw);
 }
 
 
 void cw_syntax_error(cwRuntime* cw, int line, const char* fmt, ...)
 {
-    if (cw->panic) return;
-    cw->panic = true;
+    if (cw->parser->panic) return;
+    cw->parser->panic = true;
 
     fprintf(stderr, "[line %d] Syntax error: ", line);
 
@@ -136,13 +308,13 @@ void cw_syntax_error(cwRuntime* cw, int line, const char* fmt, ...)
     va_end(args);
     fputs("\n", stderr);
 
-    cw->error = true;
+    cw->parser->error = true;
 }
 
 void cw_syntax_error_at(cwRuntime* cw, cwToken* token, const char* msg)
 {
-    if (cw->panic) return;
-    cw->panic = true;
+    if (cw->parser->panic) return;
+    cw->parser->panic = true;
 
     fprintf(stderr, "[line %d] Syntax error", token->line);
 
@@ -152,6 +324,6 @@ void cw_syntax_error_at(cwRuntime* cw, cwToken* token, const char* msg)
         fprintf(stderr, " at '%.*s'", token->end - token->start, token->start);
 
     fprintf(stderr, ": %s\n", msg);
-    cw->error = true;
+    cw->parser->error = true;
 }
 
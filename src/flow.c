@@ -0,0 +1,318 @@
+#include "flow.h"
+
+#include <string.h>
+
+#include "compiler.h"
+#include "memory.h"
+
+typedef struct
+{
+    cwChunk* chunk;
+    int len;
+
+    /* indexed by code offset, one past the end included */
+    bool* start;        /* an instruction starts here */
+    bool* live;         /* the instruction here is kept */
+    bool* targeted;     /* a kept jump lands here, marks are only added during a round */
+    int*  targets;      /* offset the jump here was pointed at, -1 for other instructions */
+    int*  blocks;       /* block of the instruction here */
+} cwFlow;
+
+/* --------------------------| instructions |------------------------------------------- */
+static uint8_t cw_flow_op(const cwFlow* flow, int at)
+{
+    const uint8_t* bytes = flow->chunk->bytes;
+    return bytes[at] == OP_WIDE ? bytes[at + 1] : bytes[at];
+}
+
+static void cw_flow_set_op(cwFlow* flow, int at, uint8_t op)
+{
+    uint8_t* bytes = flow->chunk->bytes;
+    bytes[bytes[at] == OP_WIDE ? at + 1 : at] = op;
+}
+
+static int cw_flow_length(const cwFlow* flow, int at)
+{
+    return cw_op_length(flow->chunk->bytes + at);
+}
+
+/* first kept instruction at or after offset, the end of the code if there is none */
+static int cw_flow_next(const cwFlow* flow, int at)
+{
+    while (at < flow->len && !(flow->start[at] && flow->live[at])) at++;
+    return at;
+}
+
+static int cw_flow_after(const cwFlow* flow, int at)
+{
+    return cw_flow_next(flow, at + cw_flow_length(flow, at));
+}
+
+/* where the jump at offset lands, dropped instructions fall through to the next kept one */
+static int cw_flow_target(const cwFlow* flow, int at)
+{
+    return cw_flow_next(flow, flow->targets[at]);
+}
+
+/* distances measured before packing only shrink, a short jump has to fit 16 bits */
+static bool cw_flow_reaches(const cwFlow* flow, int at, int target)
+{
+    if (flow->chunk->bytes[at] == OP_WIDE) return true;
+
+    int next = at + cw_flow_length(flow, at);
+    int distance = target > next ? target - next : next - target;
+    return distance <= UINT16_MAX;
+}
+
+static void cw_flow_retarget(cwFlow* flow, int at, int target)
+{
+    flow->targets[at] = target;
+    flow->targeted[target] = true;
+}
+
+static void cw_flow_mark(cwFlow* flow)
+{
+    memset(flow->targeted, 0, (flow->len + 1) * sizeof(bool));
+    for (int at = 0; at < flow->len; at += cw_flow_length(flow, at))
+    {
+        if (flow->live[at] && flow->targets[at] >= 0) flow->targeted[cw_flow_target(flow, at)] = true;
+    }
+}
+
+/* --------------------------| threading |---------------------------------------------- */
+static bool cw_flow_thread(cwFlow* flow)
+{
+    bool changed = false;
+    for (int at = 0; at < flow->len; at += cw_flow_length(flow, at))
+    {
+        if (!flow->live[at] || flow->targets[at] < 0) continue;
+
+        uint8_t op = cw_flow_op(flow, at);
+        if (op == OP_LOOP) continue;
+
+        /* a conditional jump lands on the same condition, it passes on through conditional jumps too */
+        int target = cw_flow_target(flow, at);
+        int best = target;
+        for (int steps = 0; steps < flow->len && target < flow->len; ++steps)
+        {
+            uint8_t next = cw_flow_op(flow, target);
+            if (next != OP_JUMP && !(next == OP_JUMP_IF_FALSE && op == OP_JUMP_IF_FALSE)) break;
+
+            target = cw_flow_target(flow, target);
+            if (cw_flow_reaches(flow, at, target)) best = target;
+        }
+
+        /* a jump to a backedge takes it right away, the copy counts for the jit like the original */
+        if (op == OP_JUMP && best < flow->len && cw_flow_op(flow, best) == OP_LOOP)
+        {
+            int header = cw_flow_target(flow, best);
+            if (header <= at && cw_flow_reaches(flow, at, header))
+            {
+                cw_flow_set_op(flow, at, OP_LOOP);
+                cw_flow_retarget(flow, at, header);
+                changed = true;
+                continue;
+            }
+        }
+
+        if (best != cw_flow_target(flow, at))
+        {
+            cw_flow_retarget(flow, at, best);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/* --------------------------| folding |------------------------------------------------ */
+static bool cw_flow_is_constant(uint8_t op)
+{
+    return op == OP_CONSTANT || op == OP_NULL || op == OP_TRUE || op == OP_FALSE;
+}
+
+static bool cw_flow_falsey(const cwFlow* flow, int at)
+{
+    const cwChunk* chunk = flow->chunk;
+    switch (chunk->bytes[at])
+    {
+    case OP_CONSTANT: return cw_is_falsey(chunk->constants[chunk->bytes[at + 1]]);
+    case OP_TRUE:     return false;
+    default:          return true;
+    }
+}
+
+static bool cw_flow_fold(cwFlow* flow)
+{
+    bool changed = false;
+
+    /* the constant pushed right before the current instruction, which is only reached from it */
+    int constant = -1;
+    for (int at = 0; at < flow->len; at += cw_flow_length(flow, at))
+    {
+        if (!flow->live[at]) continue;
+
+        uint8_t op = cw_flow_op(flow, at);
+        int pushed = flow->targeted[at] ? -1 : constant;
+        constant = cw_flow_is_constant(flow->chunk->bytes[at]) ? at : -1;
+
+        if (op == OP_JUMP_IF_FALSE && pushed >= 0)
+        {
+            changed = true;
+            if (cw_flow_falsey(flow, pushed))
+            {
+                cw_flow_set_op(flow, at, OP_JUMP);
+                continue;
+            }
+
+            /* the constant stays for whatever follows */
+            flow->live[at] = false;
+            constant = pushed;
+            continue;
+        }
+
+        if (op == OP_POP && pushed >= 0)
+        {
+            flow->live[pushed] = false;
+            flow->live[at] = false;
+            changed = true;
+            continue;
+        }
+
+        /* jumping to the pop of a constant skips both */
+        if (op == OP_JUMP && pushed >= 0)
+        {
+            int target = cw_flow_target(flow, at);
+            int behind = target < flow->len && cw_flow_op(flow, target) == OP_POP ? cw_flow_after(flow, target) : -1;
+            if (behind >= 0 && cw_flow_reaches(flow, at, behind))
+            {
+                flow->live[pushed] = false;
+                cw_flow_retarget(flow, at, behind);
+                changed = true;
+                continue;
+            }
+        }
+
+        if ((op == OP_JUMP || op == OP_JUMP_IF_FALSE) && cw_flow_target(flow, at) == cw_flow_after(flow, at))
+        {
+            flow->live[at] = false;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/* --------------------------| reachability |------------------------------------------- */
+static bool cw_flow_reach(cwFlow* flow)
+{
+    cwBasicBlock* blocks = CW_ALLOCATE(cwBasicBlock, flow->len);
+    int count = cw_basic_blocks(flow->chunk->bytes, flow->len, flow->live, flow->targets, blocks, flow->blocks);
+
+    bool* reached = CW_ALLOCATE(bool, count);
+    int* stack = CW_ALLOCATE(int, count);
+    memset(reached, 0, count * sizeof(bool));
+    int top = 0;
+    if (count > 0)
+    {
+        reached[0] = true;
+        stack[top++] = 0;
+    }
+
+    while (top > 0)
+    {
+        const cwBasicBlock* block = &blocks[stack[--top]];
+        for (int i = 0; i < block->succ_count; ++i)
+        {
+            if (reached[block->succ[i]]) continue;
+            reached[block->succ[i]] = true;
+            stack[top++] = block->succ[i];
+        }
+    }
+
+    bool changed = false;
+    for (int i = 0; i < count; ++i)
+    {
+        if (reached[i]) continue;
+
+        for (int at = blocks[i].first; at <= blocks[i].last; at += cw_flow_length(flow, at)) flow->live[at] = false;
+        changed = true;
+    }
+
+    CW_FREE_ARRAY(bool, reached, count);
+    CW_FREE_ARRAY(int, stack, count);
+    CW_FREE_ARRAY(cwBasicBlock, blocks, flow->len);
+    return changed;
+}
+
+/* --------------------------| packing |------------------------------------------------ */
+static void cw_flow_pack(cwFlow* flow)
+{
+    cwChunk* chunk = flow->chunk;
+
+    /* new offsets, a dropped instruction maps to the next kept one */
+    int* offsets = flow->blocks;
+    int len = 0;
+    for (int at = 0; at < flow->len; at += cw_flow_length(flow, at))
+    {
+        offsets[at] = len;
+        if (flow->live[at]) len += cw_flow_length(flow, at);
+    }
+    offsets[flow->len] = len;
+
+    /* kept instructions only move down, the ones still to come are untouched */
+    for (int at = 0; at < flow->len; )
+    {
+        int length = cw_flow_length(flow, at);
+        if (flow->live[at])
+        {
+            memmove(chunk->bytes + offsets[at], chunk->bytes + at, length);
+            memmove(chunk->lines + offsets[at], chunk->lines + at, length * sizeof(int));
+        }
+        at += length;
+    }
+
+    for (int at = 0; at < flow->len; ++at)
+    {
+        if (!flow->start[at] || !flow->live[at] || flow->targets[at] < 0) continue;
+        cw_write_jump(chunk->bytes, offsets[at], offsets[flow->targets[at]]);
+    }
+    chunk->len = len;
+}
+
+void cw_flow_simplify(cwChunk* chunk)
+{
+    cwFlow flow;
+    flow.chunk = chunk;
+    flow.len = (int)chunk->len;
+
+    size_t size = chunk->len + 1;
+    flow.start = CW_ALLOCATE(bool, size);
+    flow.live = CW_ALLOCATE(bool, size);
+    flow.targeted = CW_ALLOCATE(bool, size);
+    flow.targets = CW_ALLOCATE(int, size);
+    flow.blocks = CW_ALLOCATE(int, size);
+    memset(flow.start, 0, size * sizeof(bool));
+    memset(flow.live, 0, size * sizeof(bool));
+
+    for (int at = 0; at < flow.len; at += cw_flow_length(&flow, at))
+    {
+        flow.start[at] = true;
+        flow.live[at] = true;
+        flow.targets[at] = cw_is_jump(cw_flow_op(&flow, at)) ? cw_jump_target(chunk->bytes, at) : -1;
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        cw_flow_mark(&flow);
+        changed = cw_flow_thread(&flow);
+        changed |= cw_flow_fold(&flow);
+        changed |= cw_flow_reach(&flow);
+    }
+    cw_flow_pack(&flow);
+
+    CW_FREE_ARRAY(bool, flow.start, size);
+    CW_FREE_ARRAY(bool, flow.live, size);
+    CW_FREE_ARRAY(bool, flow.targeted, size);
+    CW_FREE_ARRAY(int, flow.targets, size);
+    CW_FREE_ARRAY(int, flow.blocks, size);
+}
@@ -0,0 +1,22 @@
+#ifndef CLOCKWORK_FLOW_H
+#define CLOCKWORK_FLOW_H
+
+#include "common.h"
+
+/*
+ * Control flow clean-up of a finished chunk. The code is split into basic
+ * blocks and simplified until nothing changes:
+ *
+ *   - jumps to unconditional jumps are threaded to the final target, a
+ *     forward jump to an OP_LOOP becomes a copy of it
+ *   - conditional jumps on a constant become unconditional or disappear,
+ *     as do jumps to the next instruction and constants that are popped
+ *   - blocks that can not be reached from the entry are dropped
+ *
+ * The kept code is then packed together with its lines, every jump keeps
+ * its width and is pointed at the new offset of its target.
+ */
+
+void cw_flow_simplify(cwChunk* chunk);
+
+#endif /* !CLOCKWORK_FLOW_H */
@@ -0,0 +1,54 @@
+#include "host.h"
+
+#include <string.h>
+
+#include "debug.h"
+
+cwFunction* cw_get_function(cwRuntime* cw, const char* name)
+{
+    /* a name that was never interned can not be a global */
+    cwString* key = cw_find_str(cw, name, strlen(name));
+    if (!key) return NULL;
+
+    cwValue* value = cw_table_find(&cw->globals, key);
+    return (value && IS_FUNCTION(*value)) ? AS_FUNCTION(*value) : NULL;
+}
+
+InterpretResult cw_call(cwRuntime* cw, cwFunction* function, const cwValue* args, int argc, cwValue* result)
+{
+    if (cw->stack_index + argc + 1 > CW_STACK_MAX)
+    {
+        cw_runtime_error(cw, "Stack overflow.");
+        return INTERPRET_RUNTIME_ERROR;
+    }
+
+    /* an error unwinds to here, the frames of a native calling back into script survive it */
+    int frame_base = cw->frame_base;
+    size_t stack_base = cw->stack_base;
+    cw->frame_base = cw->frame_count;
+    cw->stack_base = cw->stack_index;
+
+    cw->stack[cw->stack_index++] = MAKE_OBJECT(function);
+    memcpy(&cw->stack[cw->stack_index], args, argc * sizeof(cwValue));
+    cw->stack_index += argc;
+
+    /* pure functions answered from their cache push no frame */
+    int depth = cw->frame_count;
+    InterpretResult status = INTERPRET_RUNTIME_ERROR;
+    if (cw_call_function(cw, function, argc)) status = cw->frame_count == depth ? INTERPRET_OK : cw_run_frame(cw);
+
+    if (status != INTERPRET_OK) cw_reset_stack(cw);
+    cw->frame_base = frame_base;
+    cw->stack_base = stack_base;
+    if (status != INTERPRET_OK) return status;
+
+    cwValue value = cw_pop_stack(cw);
+    if (result) *result = value;
+    return INTERPRET_OK;
+}
+
+void cw_define_native(cwRuntime* cw, const char* name, cwNativeFn function, int arity)
+{
+    cwString* key = cw_str_copy(cw, name, strlen(name));
+    cw_table_insert(&cw->globals, key, MAKE_OBJECT(cw_native_new(cw, key, function, arity)));
+}
@@ -0,0 +1,46 @@
+#ifndef CLOCKWORK_HOST_H
+#define CLOCKWORK_HOST_H
+
+#include "common.h"
+#include "runtime.h"
+
+/*
+ * Calling script functions from C. Look a function up once with
+ * cw_get_function and call it as often as needed, arguments are copied
+ * straight onto the VM stack. Strings can be passed without copying as
+ * views (cw_str_view) on memory the host keeps alive during the call:
+ *
+ *   cwFunction* score = cw_get_function(cw, "score");
+ *   cwString name;
+ *   cwValue args[2] = { MAKE_INT(42), cw_str_view(&name, buf, len) };
+ *   cwValue result;
+ *   if (cw_call(cw, score, args, 2, &result) == INTERPRET_OK) ...
+ *
+ * Views stored into globals are copied into the runtime, a view returned
+ * as result is the one passed in.
+ *
+ * The other direction works through natives, C functions stored in a global
+ * and called by scripts like any other function:
+ *
+ *   static bool clamp(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+ *   {
+ *       if (!IS_NUMBER(args[0])) { cw_runtime_error(cw, "Expected a number."); return false; }
+ *       *result = MAKE_INT(AS_INT(args[0]) < 0 ? 0 : AS_INT(args[0]));
+ *       return true;
+ *   }
+ *
+ *   cw_define_native(cw, "clamp", clamp, 1);
+ *
+ * Worker runtimes (see worker.h) define their natives in the setup hook.
+ */
+
+/* returns the function stored in global name or NULL */
+cwFunction* cw_get_function(cwRuntime* cw, const char* name);
+
+/* calls function with argc arguments and stores its return value in result if not NULL */
+InterpretResult cw_call(cwRuntime* cw, cwFunction* function, const cwValue* args, int argc, cwValue* result);
+
+/* stores function in global name, arity -1 accepts any number of arguments */
+void cw_define_native(cwRuntime* cw, const char* name, cwNativeFn function, int arity);
+
+#endif /* !CLOCKWORK_HOST_H */
@@ -0,0 +1,327 @@
+#include "inline.h"
+
+#include <string.h>
+
+#include "compiler.h"
+#include "memory.h"
+#include "register.h"
+#include "runtime.h"
+
+typedef struct
+{
+    const cwFunction* function;
+    const cwChunk* callee;
+    const cwChunk* caller;
+    const cwString* caller_name;
+
+    /* caller slot of callee slot 1, slot 0 held the callee and is gone */
+    int base;
+
+    /* the copy has the line of the call, runtime errors in it are reported there */
+    int line;
+
+    /* indexed by callee offset, one past the end included */
+    int* depths;        /* stack depth of the callee in front of the instruction, -1 if unknown */
+    int* offsets;       /* offset of the instruction in code */
+
+    /* caller constant of every callee constant (-1 if unused) and the callee constants to add in order */
+    int constants[UINT8_MAX + 1];
+    uint8_t missing[UINT8_MAX + 1];
+    int added;
+
+    /* jumps behind the copy, one per return */
+    int* exits;
+    int exit_count;
+
+    cwChunk code;
+} cwInliner;
+
+/* --------------------------| callees |------------------------------------------------ */
+/* the function a global always holds when code compiled now reads it, NULL if there is none */
+static const cwFunction* cw_inline_callee(cwRuntime* cw, const cwString* name)
+{
+    cwValue* value = cw_table_find(&cw->parser->declared, name);
+    if (!value && cw_table_find(&cw->parser->immutables, name)) value = cw_table_find(&cw->globals, name);
+    /* calls of pure functions go through their cache */
+    return (value && IS_FUNCTION(*value) && AS_FUNCTION(*value)->memo < 0) ? AS_FUNCTION(*value) : NULL;
+}
+
+/* stack depth in front of the instruction at offset, which belongs to the statement being compiled, -1 if unknown */
+static int cw_inline_depth(const cwRuntime* cw, int offset)
+{
+    const cwCompiler* compiler = cw->parser->compiler;
+    const cwChunk* chunk = cw->parser->chunk;
+    int begin = compiler->stmt_start;
+
+    /* a declared local is only on the stack once its initializer is done */
+    int depth = compiler->local_count;
+    if (depth > 0 && compiler->locals[depth - 1].depth < 0) depth--;
+
+    /* code behind an unconditional jump is entered through a jump to it, e.g. the ones of inlined returns */
+    int* targets = CW_ALLOCATE(int, offset - begin + 1);
+    for (int i = 0; i <= offset - begin; ++i) targets[i] = -1;
+
+    bool reached = true;
+    for (int at = begin; at <= offset; at += cw_op_length(chunk->bytes + at))
+    {
+        if (!reached) depth = targets[at - begin];
+        if (at == offset || depth < 0) break;
+
+        const uint8_t* ip = chunk->bytes + at;
+        uint8_t op = cw_generic_op(ip[ip[0] == OP_WIDE]);
+        depth += cw_stack_effect(ip, NULL, NULL);
+        if (cw_is_jump(op))
+        {
+            int target = cw_jump_target(chunk->bytes, at);
+            if (target > at && target <= offset) targets[target - begin] = depth;
+        }
+        reached = cw_falls_through(op);
+    }
+
+    CW_FREE_ARRAY(int, targets, offset - begin + 1);
+    return depth;
+}
+
+/* --------------------------| operands |----------------------------------------------- */
+static bool cw_inline_constant(cwInliner* inliner, uint8_t* operand)
+{
+    int* mapped = &inliner->constants[*operand];
+    if (*mapped < 0)
+    {
+        cwValue value = inliner->callee->constants[*operand];
+        for (size_t i = 0; i < inliner->caller->const_len && *mapped < 0; ++i)
+        {
+            if (cw_same_constant(inliner->caller->constants[i], value)) *mapped = (int)i;
+        }
+
+        /* the caller adds a value once, a copy of one that is missing already shares its index */
+        for (int i = 0; i < inliner->added && *mapped < 0; ++i)
+        {
+            if (cw_same_constant(inliner->callee->constants[inliner->missing[i]], value)) *mapped = (int)inliner->caller->const_len + i;
+        }
+
+        if (*mapped < 0)
+        {
+            *mapped = (int)inliner->caller->const_len + inliner->added;
+            if (*mapped <= UINT8_MAX) inliner->missing[inliner->added++] = *operand;
+        }
+    }
+
+    if (*mapped > UINT8_MAX) return false;
+    *operand = (uint8_t)*mapped;
+    return true;
+}
+
+/* a global the callee uses, reading itself or the caller would make a function recursive */
+static bool cw_inline_global(cwInliner* inliner, uint8_t* operand)
+{
+    const cwString* name = AS_STRING(inliner->callee->constants[*operand]);
+    if (name == inliner->function->name || name == inliner->caller_name) return false;
+    return cw_inline_constant(inliner, operand);
+}
+
+static bool cw_inline_slot(const cwInliner* inliner, uint8_t* operand)
+{
+    int slot = inliner->base + *operand - 1;
+    if (*operand == 0 || slot > UINT8_MAX) return false;
+    *operand = (uint8_t)slot;
+    return true;
+}
+
+static bool cw_inline_rk(cwInliner* inliner, uint8_t mode, uint8_t bit, uint8_t* operand)
+{
+    return CW_RK_IS_CONST(mode, bit) ? cw_inline_constant(inliner, operand) : cw_inline_slot(inliner, operand);
+}
+
+/* copies the instruction at offset into bytes with the operands of the caller, false if it has none */
+static bool cw_inline_operands(cwInliner* inliner, int offset, uint8_t* bytes)
+{
+    const uint8_t* ip = inliner->callee->bytes + offset;
+    if (ip[0] == OP_WIDE) return false;
+    memcpy(bytes, ip, cw_op_length(ip));
+
+    /* the typing of the caller covers the copy */
+    uint8_t op = bytes[0] = cw_generic_op(ip[0]);
+
+    switch (op)
+    {
+    case OP_GET_LOCAL: case OP_SET_LOCAL:
+        return cw_inline_slot(inliner, bytes + 1);
+    case OP_CONSTANT:
+        return cw_inline_constant(inliner, bytes + 1);
+    case OP_DEF_GLOBAL: case OP_GET_GLOBAL: case OP_SET_GLOBAL:
+        return cw_inline_global(inliner, bytes + 1);
+    case OP_INC_LOCAL:  case OP_INC_GLOBAL:
+    case OP_DEC_LOCAL:  case OP_DEC_GLOBAL:
+    case OP_ADD_LOCAL:  case OP_ADD_GLOBAL:
+    case OP_SUB_LOCAL:  case OP_SUB_GLOBAL:
+    case OP_MULT_LOCAL: case OP_MULT_GLOBAL:
+    case OP_DIV_LOCAL:  case OP_DIV_GLOBAL:
+        /* local and global variants alternate */
+        return ((op - OP_INC_LOCAL) % 2 == 0) ? cw_inline_slot(inliner, bytes + 1) : cw_inline_global(inliner, bytes + 1);
+    case OP_R_MOVE:
+        return cw_inline_slot(inliner, bytes + 2) && cw_inline_rk(inliner, bytes[1], CW_RK_B, bytes + 3);
+    case OP_R_ADD: case OP_R_SUB: case OP_R_MULT: case OP_R_DIV:
+    case OP_R_EQ:  case OP_R_NOTEQ:
+    case OP_R_LT:  case OP_R_LTEQ:
+    case OP_R_GT:  case OP_R_GTEQ:
+        return cw_inline_slot(inliner, bytes + 2)
+            && cw_inline_rk(inliner, bytes[1], CW_RK_B, bytes + 3)
+            && cw_inline_rk(inliner, bytes[1], CW_RK_C, bytes + 4);
+    case OP_R_BRANCH:
+        return cw_inline_rk(inliner, bytes[1], CW_RK_B, bytes + 2) && cw_inline_rk(inliner, bytes[1], CW_RK_C, bytes + 3);
+    case OP_TAIL_CALL:
+        /* a copy would keep the frame of the caller, deep recursion through it would overflow */
+        return false;
+    default:
+        return true;
+    }
+}
+
+/* --------------------------| copying |------------------------------------------------ */
+/* stack depths of the callee and a check of every operand, false if the callee can not be inlined */
+static bool cw_inline_check(cwInliner* inliner)
+{
+    const cwChunk* callee = inliner->callee;
+    for (int at = 0; at <= (int)callee->len; ++at) inliner->depths[at] = -1;
+
+    int depth = 1 + inliner->function->arity;
+    bool reached = true;
+    for (int at = 0; at < (int)callee->len; at += cw_op_length(callee->bytes + at))
+    {
+        if (inliner->depths[at] >= 0)
+        {
+            if (reached && inliner->depths[at] != depth) return false;
+            depth = inliner->depths[at];
+            reached = true;
+        }
+        if (!reached) return false;
+        inliner->depths[at] = depth;
+
+        uint8_t bytes[8];
+        if (!cw_inline_operands(inliner, at, bytes)) return false;
+
+        uint8_t op = bytes[0];
+        depth += cw_stack_effect(bytes, NULL, NULL);
+        if (cw_is_jump(op))
+        {
+            int target = cw_jump_target(callee->bytes, at);
+            if (inliner->depths[target] >= 0 && inliner->depths[target] != depth) return false;
+            inliner->depths[target] = depth;
+        }
+        reached = cw_falls_through(op);
+    }
+    return !reached;
+}
+
+/* the value on top goes where the call leaves its result, the callee's locals are popped */
+static void cw_inline_return(cwInliner* inliner, int offset)
+{
+    cwChunk* code = &inliner->code;
+    int depth = inliner->depths[offset];
+    int line = inliner->line;
+
+    /* slot 0 is gone, the value is the only thing left once depth is 2 */
+    if (depth > 2)
+    {
+        cw_emit_bytes(code, OP_SET_LOCAL, (uint8_t)inliner->base, line);
+        for (int i = 2; i < depth; ++i) cw_emit_byte(code, OP_POP, line);
+    }
+
+    if (offset + 1 < (int)inliner->callee->len)
+    {
+        inliner->exits[inliner->exit_count++] = code->len;
+        cw_emit_jump(code, OP_JUMP, line);
+    }
+}
+
+static void cw_inline_copy(cwInliner* inliner)
+{
+    const cwChunk* callee = inliner->callee;
+    cwChunk* code = &inliner->code;
+
+    for (int at = 0; at < (int)callee->len; at += cw_op_length(callee->bytes + at))
+    {
+        inliner->offsets[at] = code->len;
+        if (callee->bytes[at] == OP_RETURN)
+        {
+            cw_inline_return(inliner, at);
+            continue;
+        }
+
+        uint8_t bytes[8];
+        cw_inline_operands(inliner, at, bytes);
+        for (int i = 0; i < cw_op_length(bytes); ++i) cw_emit_byte(code, bytes[i], inliner->line);
+    }
+    inliner->offsets[callee->len] = code->len;
+
+    /* the copy is small, every jump fits its short form */
+    for (int at = 0; at < (int)callee->len; at += cw_op_length(callee->bytes + at))
+    {
+        if (cw_is_jump(cw_generic_op(callee->bytes[at])))
+            cw_write_jump(code->bytes, inliner->offsets[at], inliner->offsets[cw_jump_target(callee->bytes, at)]);
+    }
+    for (int i = 0; i < inliner->exit_count; ++i) cw_write_jump(code->bytes, inliner->exits[i], code->len);
+}
+
+/* --------------------------| inlining |----------------------------------------------- */
+bool cw_inline_call(cwRuntime* cw, int callee, int argc)
+{
+    cwParser* parser = cw->parser;
+    cwCompiler* compiler = parser->compiler;
+    cwChunk* chunk = parser->chunk;
+    if (callee < 0 || parser->error || chunk->bytes[callee] == OP_WIDE) return false;
+
+    const cwFunction* function = cw_inline_callee(cw, AS_STRING(chunk->constants[chunk->bytes[callee + 1]]));
+    if (!function || function->arity != argc || function->chunk.len > CW_INLINE_MAX) return false;
+
+    /* the callee sat at the stack depth in front of its read, its arguments are right above */
+    int base = cw_inline_depth(cw, callee);
+    if (base < 0 || base > UINT8_MAX) return false;
+
+    int len = (int)function->chunk.len;
+    cwInliner inliner;
+    inliner.function = function;
+    inliner.callee = &function->chunk;
+    inliner.caller = chunk;
+    inliner.caller_name = compiler->function->name;
+    inliner.base = base;
+    inliner.line = parser->previous.line;
+    inliner.depths = CW_ALLOCATE(int, len + 1);
+    inliner.offsets = CW_ALLOCATE(int, len + 1);
+    inliner.exits = CW_ALLOCATE(int, len);
+    inliner.exit_count = 0;
+    inliner.added = 0;
+    for (int i = 0; i <= UINT8_MAX; ++i) inliner.constants[i] = -1;
+    cw_chunk_init(&inliner.code);
+
+    bool inlined = cw_inline_check(&inliner);
+    if (inlined) cw_inline_copy(&inliner);
+    inlined = inlined && compiler->inlined + (int)inliner.code.len <= CW_INLINE_BUDGET;
+
+    if (inlined)
+    {
+        for (int i = 0; i < inliner.added; ++i) cw_make_constant(cw, inliner.callee->constants[inliner.missing[i]]);
+
+        /* the arguments take the place of the read */
+        memmove(chunk->bytes + callee, chunk->bytes + callee + 2, chunk->len - callee - 2);
+        memmove(chunk->lines + callee, chunk->lines + callee + 2, (chunk->len - callee - 2) * sizeof(int));
+        chunk->len -= 2;
+
+        /* so do calls inlined into them, which were placed above the read */
+        cw_shift_slots(chunk, callee, chunk->len, base + 1, -1, true);
+
+        for (size_t i = 0; i < inliner.code.len; ++i) cw_emit_byte(chunk, inliner.code.bytes[i], inliner.code.lines[i]);
+        compiler->inlined += (int)inliner.code.len;
+
+        /* the expression is no longer a lone in-place update or call */
+        parser->inplace_start = -1;
+        compiler->last_call = -1;
+    }
+
+    cw_chunk_free(&inliner.code);
+    CW_FREE_ARRAY(int, inliner.depths, len + 1);
+    CW_FREE_ARRAY(int, inliner.offsets, len + 1);
+    CW_FREE_ARRAY(int, inliner.exits, len);
+    return inlined;
+}
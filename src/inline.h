@@ -0,0 +1,37 @@
+#ifndef CLOCKWORK_INLINE_H
+#define CLOCKWORK_INLINE_H
+
+#include "common.h"
+
+/*
+ * Inlining of calls to small functions while the caller is compiled. A call
+ * whose callee is read from a global that can only ever hold one function,
+ * i.e. a function declared before the call or one an immutable global held
+ * when the code was compiled, gets a copy of the callee's code in place of
+ * the call:
+ *
+ *   - the read of the callee is dropped, the arguments become the callee's
+ *     parameters where they are, and its other locals follow them, so every
+ *     slot of the callee moves up to the stack depth of the call
+ *   - constants are looked up in or added to the caller's pool
+ *   - a return moves its value down to where the result of the call goes
+ *     and pops the callee's locals, then jumps behind the copy
+ *
+ * Only callees of at most CW_INLINE_MAX bytes of code are inlined. Callees
+ * that read themselves or the caller are left alone, as are tail calls in
+ * them, so that no function turns recursive and recursion keeps running in
+ * constant stack space. A function takes at most CW_INLINE_BUDGET bytes of
+ * inlined code.
+ */
+#define CW_INLINE_MAX       48
+#define CW_INLINE_BUDGET    2048
+
+/*
+ * called while cw is compiling, in place of emitting an OP_CALL with argc
+ * arguments. callee is the offset of the read of the called global right
+ * in front of the arguments or -1. returns false if the call is left to
+ * be emitted.
+ */
+bool cw_inline_call(cwRuntime* cw, int callee, int argc);
+
+#endif /* !CLOCKWORK_INLINE_H */
@@ -0,0 +1,1009 @@
+/* mmap and MAP_ANONYMOUS are not part of c99 */
+#define _DEFAULT_SOURCE
+
+#include "jit.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "memory.h"
+#include "register.h"
+#include "runtime.h"
+
+#ifdef CW_JIT
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef uint8_t* (*cwJitCode)(cwValue* slots, cwValue* top, cwValue** top_out, cwRuntime* cw);
+
+typedef struct
+{
+    const uint8_t* header;
+
+    /* the compiled region, which can start before the header */
+    const uint8_t* start;
+    const uint8_t* end;
+    cwJitCode code;
+    size_t size;    /* of the mapping, whole pages */
+    size_t len;     /* of the emitted code */
+    uint32_t hotness;
+    uint32_t fails;
+    int max_depth;
+    bool failed;
+} cwJitLoop;
+
+struct cwJit
+{
+    cwJitLoop loops[CW_JIT_MAX_LOOPS];
+    FILE* perf_map;
+};
+
+/* --------------------------| assembler |----------------------------------------------- */
+enum
+{
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+enum
+{
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7,
+    CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf
+};
+
+/* register usage of compiled loops, all callee-saved */
+#define REG_SLOTS   RBX
+#define REG_TOP     R12
+#define REG_TOP_OUT R13
+#define REG_CW      R14
+
+#define VALUE_SIZE  ((int32_t)sizeof(cwValue))
+#define TYPE_OFFSET ((int32_t)offsetof(cwValue, type))
+#define AS_OFFSET   ((int32_t)offsetof(cwValue, as))
+
+/* a rel32 at pos that jumps to the bytecode at target or leaves the loop there */
+typedef struct
+{
+    int pos;
+    int target;
+    bool exit;
+} cwJitFixup;
+
+typedef struct
+{
+    uint8_t* code;
+    size_t len;
+    size_t cap;
+
+    /* machine code offset of every bytecode offset in the loop, -1 if not emitted */
+    int* labels;
+    cwJitFixup* fixups;
+    int fixup_len;
+    int fixup_cap;
+
+    const cwChunk* chunk;
+    int start;
+    int end;
+} cwAssembler;
+
+static void asm_byte(cwAssembler* a, uint8_t byte)
+{
+    if (a->cap < a->len + 1)
+    {
+        size_t old_cap = a->cap;
+        a->cap = CW_GROW_CAPACITY(old_cap);
+        a->code = CW_GROW_ARRAY(uint8_t, a->code, old_cap, a->cap);
+    }
+    a->code[a->len++] = byte;
+}
+
+static void asm_u32(cwAssembler* a, uint32_t val)
+{
+    for (int i = 0; i < 4; ++i) asm_byte(a, (val >> (8 * i)) & 0xff);
+}
+
+static void asm_u64(cwAssembler* a, uint64_t val)
+{
+    for (int i = 0; i < 8; ++i) asm_byte(a, (val >> (8 * i)) & 0xff);
+}
+
+static void asm_patch_u32(cwAssembler* a, int pos, uint32_t val)
+{
+    for (int i = 0; i < 4; ++i) a->code[pos + i] = (val >> (8 * i)) & 0xff;
+}
+
+/* [prefix] [rex] opcode modrm [sib] disp32 for an operation on [base + disp] */
+static void asm_mem(cwAssembler* a, uint8_t prefix, bool wide, const char* opcode, int reg, int base, int32_t disp)
+{
+    if (prefix) asm_byte(a, prefix);
+
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((base & 8) ? 0x01 : 0);
+    if (rex != 0x40) asm_byte(a, rex);
+
+    while (*opcode) asm_byte(a, (uint8_t)*opcode++);
+
+    asm_byte(a, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) asm_byte(a, 0x24);
+    asm_u32(a, (uint32_t)disp);
+}
+
+static void asm_mov_imm64(cwAssembler* a, int reg, uint64_t imm)
+{
+    asm_byte(a, 0x48 | ((reg & 8) ? 0x01 : 0));
+    asm_byte(a, 0xb8 | (reg & 7));
+    asm_u64(a, imm);
+}
+
+static void asm_add_top(cwAssembler* a, int8_t values)
+{
+    /* add/sub r12, imm8 */
+    asm_byte(a, 0x49);
+    asm_byte(a, 0x83);
+    asm_byte(a, values < 0 ? 0xec : 0xc4);
+    asm_byte(a, (uint8_t)((values < 0 ? -values : values) * VALUE_SIZE));
+}
+
+static void asm_call(cwAssembler* a, void* function)
+{
+    asm_mov_imm64(a, RAX, (uint64_t)(uintptr_t)function);
+    asm_byte(a, 0xff);  /* call rax */
+    asm_byte(a, 0xd0);
+}
+
+static void asm_setcc_eax(cwAssembler* a, int cc)
+{
+    asm_byte(a, 0x0f); asm_byte(a, 0x90 | cc); asm_byte(a, 0xc0);   /* setcc al */
+    asm_byte(a, 0x0f); asm_byte(a, 0xb6); asm_byte(a, 0xc0);        /* movzx eax, al */
+}
+
+/* jumps inside of the emitted code, cc < 0 is an unconditional jump */
+static int asm_jump_forward(cwAssembler* a, int cc)
+{
+    if (cc < 0)
+    {
+        asm_byte(a, 0xe9);
+    }
+    else
+    {
+        asm_byte(a, 0x0f);
+        asm_byte(a, 0x80 | cc);
+    }
+    asm_u32(a, 0);
+    return (int)a->len - 4;
+}
+
+static void asm_bind(cwAssembler* a, int pos)
+{
+    asm_patch_u32(a, pos, (uint32_t)((int)a->len - (pos + 4)));
+}
+
+/* jumps to a bytecode offset, or leaves the loop with target as the resume point */
+static void asm_jump_bytecode(cwAssembler* a, int cc, int target, bool exit)
+{
+    if (a->fixup_cap < a->fixup_len + 1)
+    {
+        int old_cap = a->fixup_cap;
+        a->fixup_cap = CW_GROW_CAPACITY(old_cap);
+        a->fixups = CW_GROW_ARRAY(cwJitFixup, a->fixups, old_cap, a->fixup_cap);
+    }
+
+    cwJitFixup* fixup = &a->fixups[a->fixup_len++];
+    fixup->pos = asm_jump_forward(a, cc);
+    fixup->target = target;
+    fixup->exit = exit;
+}
+
+/* --------------------------| values |-------------------------------------------------- */
+/* a value either in memory at [base + disp] or an int constant */
+typedef struct
+{
+    bool constant;
+    int32_t imm;
+    int base;
+    int32_t disp;
+} cwJitOperand;
+
+static cwJitOperand cw_jit_mem(int base, int32_t disp)
+{
+    return (cwJitOperand){ .constant = false, .imm = 0, .base = base, .disp = disp };
+}
+
+static cwJitOperand cw_jit_stack(int distance) { return cw_jit_mem(REG_TOP, -(distance + 1) * VALUE_SIZE); }
+static cwJitOperand cw_jit_slot(int slot)      { return cw_jit_mem(REG_SLOTS, slot * VALUE_SIZE); }
+
+static void cw_jit_guard_type(cwAssembler* a, const cwJitOperand* x, cwValueType type, int ip)
+{
+    if (x->constant) return;
+
+    asm_mem(a, 0, false, "\x81", 7, x->base, x->disp + TYPE_OFFSET);  /* cmp dword [x.type], type */
+    asm_u32(a, type);
+    asm_jump_bytecode(a, CC_NE, ip, true);
+}
+
+/*
+ * values are always written as two qwords (type and payload, upper halves
+ * zeroed) so that the qword loads of cw_jit_copy can be store forwarded.
+ */
+static void cw_jit_store_type(cwAssembler* a, const cwJitOperand* dst, cwValueType type)
+{
+    asm_mem(a, 0, true, "\xc7", 0, dst->base, dst->disp + TYPE_OFFSET);   /* mov qword [dst.type], type */
+    asm_u32(a, type);
+}
+
+/* expects the upper half of rax to be zero, which every write to eax does */
+static void cw_jit_store_eax(cwAssembler* a, const cwJitOperand* dst, cwValueType type)
+{
+    cw_jit_store_type(a, dst, type);
+    asm_mem(a, 0, true, "\x89", RAX, dst->base, dst->disp + AS_OFFSET);   /* mov [dst.as], rax */
+}
+
+/* copies a whole value between memory locations */
+static void cw_jit_copy(cwAssembler* a, const cwJitOperand* dst, const cwJitOperand* src)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        asm_mem(a, 0, true, "\x8b", RAX, src->base, src->disp + i * 8);   /* mov rax, [src] */
+        asm_mem(a, 0, true, "\x89", RAX, dst->base, dst->disp + i * 8);   /* mov [dst], rax */
+    }
+}
+
+/* writes a known value to memory */
+static void cw_jit_store_value(cwAssembler* a, const cwJitOperand* dst, cwValue val)
+{
+    uint64_t words[2];
+    memcpy(words, &val, sizeof(words));
+    for (int i = 0; i < 2; ++i)
+    {
+        asm_mov_imm64(a, RAX, words[i]);
+        asm_mem(a, 0, true, "\x89", RAX, dst->base, dst->disp + i * 8);   /* mov [dst], rax */
+    }
+}
+
+/* --------------------------| arithmetic |---------------------------------------------- */
+typedef enum
+{
+    JIT_ADD, JIT_SUB, JIT_MULT, JIT_DIV,
+    JIT_EQ, JIT_NOTEQ, JIT_LT, JIT_LTEQ, JIT_GT, JIT_GTEQ
+} cwJitOp;
+
+static bool cw_jit_is_compare(cwJitOp op) { return op >= JIT_EQ; }
+
+static int cw_jit_condition(cwJitOp op)
+{
+    switch (op)
+    {
+    case JIT_EQ:    return CC_E;
+    case JIT_NOTEQ: return CC_NE;
+    case JIT_LT:    return CC_L;
+    case JIT_LTEQ:  return CC_LE;
+    case JIT_GT:    return CC_G;
+    default:        return CC_GE;
+    }
+}
+
+static void cw_jit_load_eax(cwAssembler* a, const cwJitOperand* x)
+{
+    if (x->constant)
+    {
+        asm_byte(a, 0xb8);  /* mov eax, imm32 */
+        asm_u32(a, (uint32_t)x->imm);
+    }
+    else
+    {
+        asm_mem(a, 0, false, "\x8b", RAX, x->base, x->disp + AS_OFFSET);
+    }
+}
+
+/* eax = eax op y, comparisons only set the flags */
+static void cw_jit_int_op(cwAssembler* a, cwJitOp op, const cwJitOperand* y, int ip)
+{
+    if (op == JIT_DIV)
+    {
+        /* division by zero and INT32_MIN / -1 are left to the interpreter */
+        if (y->constant)
+        {
+            asm_byte(a, 0xb9);  /* mov ecx, imm32 */
+            asm_u32(a, (uint32_t)y->imm);
+        }
+        else
+        {
+            asm_mem(a, 0, false, "\x8b", RCX, y->base, y->disp + AS_OFFSET);
+        }
+        asm_byte(a, 0x85); asm_byte(a, 0xc9);   /* test ecx, ecx */
+        asm_jump_bytecode(a, CC_E, ip, true);
+        asm_byte(a, 0x83); asm_byte(a, 0xf9); asm_byte(a, 0xff);   /* cmp ecx, -1 */
+        asm_jump_bytecode(a, CC_E, ip, true);
+        asm_byte(a, 0x99);                      /* cdq */
+        asm_byte(a, 0xf7); asm_byte(a, 0xf9);   /* idiv ecx */
+        return;
+    }
+
+    if (y->constant)
+    {
+        switch (op)
+        {
+        case JIT_ADD:  asm_byte(a, 0x05); break;                    /* add eax, imm32 */
+        case JIT_SUB:  asm_byte(a, 0x2d); break;                    /* sub eax, imm32 */
+        case JIT_MULT: asm_byte(a, 0x69); asm_byte(a, 0xc0); break; /* imul eax, eax, imm32 */
+        default:       asm_byte(a, 0x3d); break;                    /* cmp eax, imm32 */
+        }
+        asm_u32(a, (uint32_t)y->imm);
+        return;
+    }
+
+    const char* opcode;
+    switch (op)
+    {
+    case JIT_ADD:  opcode = "\x03"; break;
+    case JIT_SUB:  opcode = "\x2b"; break;
+    case JIT_MULT: opcode = "\x0f\xaf"; break;
+    default:       opcode = "\x3b"; break;
+    }
+    asm_mem(a, 0, false, opcode, RAX, y->base, y->disp + AS_OFFSET);
+}
+
+/* dst = x op y for two values proven to be ints */
+static void cw_jit_int_typed(cwAssembler* a, cwJitOp op, const cwJitOperand* dst, const cwJitOperand* x, const cwJitOperand* y, int ip)
+{
+    cw_jit_load_eax(a, x);
+    cw_jit_int_op(a, op, y, ip);
+
+    if (cw_jit_is_compare(op))
+    {
+        asm_setcc_eax(a, cw_jit_condition(op));
+        cw_jit_store_eax(a, dst, VAL_BOOL);
+    }
+    else
+    {
+        cw_jit_store_eax(a, dst, VAL_INT);
+    }
+}
+
+/* dst = x op y for two ints, leaves the loop on any other type */
+static void cw_jit_int_binary(cwAssembler* a, cwJitOp op, const cwJitOperand* dst, const cwJitOperand* x, const cwJitOperand* y, int ip)
+{
+    cw_jit_guard_type(a, x, VAL_INT, ip);
+    cw_jit_guard_type(a, y, VAL_INT, ip);
+    cw_jit_int_typed(a, op, dst, x, y, ip);
+}
+
+/* loads x into xmm, ints are converted like the interpreter does, exits on any other type */
+static void cw_jit_load_float(cwAssembler* a, int xmm, const cwJitOperand* x, int ip)
+{
+    if (x->constant)
+    {
+        asm_byte(a, 0xb8); asm_u32(a, (uint32_t)x->imm);                              /* mov eax, imm */
+        asm_byte(a, 0xf3); asm_byte(a, 0x0f); asm_byte(a, 0x2a); asm_byte(a, 0xc0 | (xmm << 3));  /* cvtsi2ss xmm, eax */
+        return;
+    }
+
+    asm_mem(a, 0, false, "\x81", 7, x->base, x->disp + TYPE_OFFSET);  /* cmp dword [x.type], VAL_INT */
+    asm_u32(a, VAL_INT);
+    int not_int = asm_jump_forward(a, CC_NE);
+    asm_mem(a, 0xf3, false, "\x0f\x2a", xmm, x->base, x->disp + AS_OFFSET);   /* cvtsi2ss xmm, [x] */
+    int done = asm_jump_forward(a, -1);
+
+    asm_bind(a, not_int);
+    cw_jit_guard_type(a, x, VAL_FLOAT, ip);
+    asm_mem(a, 0xf3, false, "\x0f\x10", xmm, x->base, x->disp + AS_OFFSET);   /* movss xmm, [x] */
+    asm_bind(a, done);
+}
+
+/* dst = x op y for two numbers of which the interpreter makes floats, returns false if op has no float variant */
+static bool cw_jit_float_binary(cwAssembler* a, cwJitOp op, const cwJitOperand* dst, const cwJitOperand* x, const cwJitOperand* y, int ip)
+{
+    if (op == JIT_EQ || op == JIT_NOTEQ) return false;
+
+    if (cw_jit_is_compare(op))
+    {
+        /* a < b is b > a, so unordered operands always compare false */
+        bool swap = (op == JIT_LT || op == JIT_LTEQ);
+        cw_jit_load_float(a, 0, swap ? y : x, ip);
+        cw_jit_load_float(a, 1, swap ? x : y, ip);
+
+        asm_byte(a, 0x0f); asm_byte(a, 0x2e); asm_byte(a, 0xc1);    /* ucomiss xmm0, xmm1 */
+        asm_setcc_eax(a, (op == JIT_LT || op == JIT_GT) ? CC_A : CC_AE);
+        cw_jit_store_eax(a, dst, VAL_BOOL);
+        return true;
+    }
+
+    uint8_t opcode;
+    switch (op)
+    {
+    case JIT_ADD:  opcode = 0x58; break;
+    case JIT_SUB:  opcode = 0x5c; break;
+    case JIT_MULT: opcode = 0x59; break;
+    default:       opcode = 0x5e; break;
+    }
+
+    cw_jit_load_float(a, 0, x, ip);
+    cw_jit_load_float(a, 1, y, ip);
+    asm_byte(a, 0xf3); asm_byte(a, 0x0f); asm_byte(a, opcode); asm_byte(a, 0xc1);   /* <op>ss xmm0, xmm1 */
+    asm_byte(a, 0x66); asm_byte(a, 0x0f); asm_byte(a, 0x7e); asm_byte(a, 0xc0);     /* movd eax, xmm0 */
+    cw_jit_store_eax(a, dst, VAL_FLOAT);
+    return true;
+}
+
+/* dst = x op y for two values in memory, with an int and a float path */
+static void cw_jit_binary(cwAssembler* a, cwJitOp op, const cwJitOperand* dst, const cwJitOperand* x, const cwJitOperand* y, int ip)
+{
+    asm_mem(a, 0, false, "\x81", 7, x->base, x->disp + TYPE_OFFSET);  /* cmp dword [x.type], VAL_INT */
+    asm_u32(a, VAL_INT);
+    int x_not_int = asm_jump_forward(a, CC_NE);
+
+    /* an int and a float take the float path too */
+    int y_not_int = -1;
+    if (!y->constant)
+    {
+        asm_mem(a, 0, false, "\x81", 7, y->base, y->disp + TYPE_OFFSET);  /* cmp dword [y.type], VAL_INT */
+        asm_u32(a, VAL_INT);
+        y_not_int = asm_jump_forward(a, CC_NE);
+    }
+
+    cw_jit_int_typed(a, op, dst, x, y, ip);
+    int done = asm_jump_forward(a, -1);
+
+    asm_bind(a, x_not_int);
+    if (y_not_int >= 0) asm_bind(a, y_not_int);
+    if (!cw_jit_float_binary(a, op, dst, x, y, ip)) asm_jump_bytecode(a, -1, ip, true);
+
+    asm_bind(a, done);
+}
+
+/* --------------------------| globals |------------------------------------------------- */
+/* leaves a pointer to the global's value in rsi, exits if it is not defined */
+static void cw_jit_find_global(cwAssembler* a, cwString* name, int ip)
+{
+    asm_mem(a, 0, true, "\x8d", RDI, REG_CW, (int32_t)offsetof(cwRuntime, globals));   /* lea rdi, [cw->globals] */
+    asm_mov_imm64(a, RSI, (uint64_t)(uintptr_t)name);
+    asm_call(a, (void*)cw_table_find);
+
+    asm_byte(a, 0x48); asm_byte(a, 0x85); asm_byte(a, 0xc0);    /* test rax, rax */
+    asm_jump_bytecode(a, CC_E, ip, true);
+    asm_byte(a, 0x48); asm_byte(a, 0x89); asm_byte(a, 0xc6);    /* mov rsi, rax */
+}
+
+static void cw_jit_print(cwOutput* out, const cwValue* val)
+{
+    cw_output_value(out, *val);
+    cw_output_write(out, "\n", 1);
+}
+
+/* --------------------------| translation |--------------------------------------------- */
+static bool cw_jit_op(uint8_t instruction, cwJitOp* op)
+{
+    switch (instruction)
+    {
+    case OP_ADD:      case OP_ADD_LOCAL:  case OP_ADD_GLOBAL:  case OP_R_ADD:   *op = JIT_ADD; return true;
+    case OP_SUBTRACT: case OP_SUB_LOCAL:  case OP_SUB_GLOBAL:  case OP_R_SUB:   *op = JIT_SUB; return true;
+    case OP_MULTIPLY: case OP_MULT_LOCAL: case OP_MULT_GLOBAL: case OP_R_MULT:  *op = JIT_MULT; return true;
+    case OP_DIVIDE:   case OP_DIV_LOCAL:  case OP_DIV_GLOBAL:  case OP_R_DIV:   *op = JIT_DIV; return true;
+    case OP_EQ:       case OP_R_EQ:       *op = JIT_EQ; return true;
+    case OP_NOTEQ:    case OP_R_NOTEQ:    *op = JIT_NOTEQ; return true;
+    case OP_LT:       case OP_R_LT:       *op = JIT_LT; return true;
+    case OP_LTEQ:     case OP_R_LTEQ:     *op = JIT_LTEQ; return true;
+    case OP_GT:       case OP_R_GT:       *op = JIT_GT; return true;
+    case OP_GTEQ:     case OP_R_GTEQ:     *op = JIT_GTEQ; return true;
+    default: return false;
+    }
+}
+
+/* register operands, constants are only supported as int immediates */
+static bool cw_jit_rk(const cwChunk* chunk, uint8_t mode, uint8_t bit, uint8_t operand, cwJitOperand* x)
+{
+    if (!CW_RK_IS_CONST(mode, bit))
+    {
+        *x = cw_jit_slot(operand);
+        return true;
+    }
+
+    cwValue val = chunk->constants[operand];
+    if (!IS_INT(val)) return false;
+
+    *x = (cwJitOperand){ .constant = true, .imm = val.as.ival, .base = 0, .disp = 0 };
+    return true;
+}
+
+static int16_t cw_jit_jump_offset(const uint8_t* bytes, int offset)
+{
+    return (int16_t)((bytes[offset] << 8) | bytes[offset + 1]);
+}
+
+/* translates the instruction at offset, returns false if it is not supported */
+static bool cw_jit_instruction(cwAssembler* a, int offset)
+{
+    const cwChunk* chunk = a->chunk;
+    const uint8_t* bytes = chunk->bytes;
+    uint8_t instruction = bytes[offset];
+    int next = offset + cw_op_length(bytes + offset);
+
+    cwJitOp op;
+    cwJitOperand top = cw_jit_stack(0);
+    cwJitOperand second = cw_jit_stack(1);
+    cwJitOperand push = cw_jit_stack(-1);
+
+    switch (instruction)
+    {
+    case OP_CONSTANT:
+        cw_jit_store_value(a, &push, chunk->constants[bytes[offset + 1]]);
+        asm_add_top(a, 1);
+        return true;
+    case OP_NULL:  cw_jit_store_value(a, &push, MAKE_NULL());      asm_add_top(a, 1); return true;
+    case OP_TRUE:  cw_jit_store_value(a, &push, MAKE_BOOL(true));  asm_add_top(a, 1); return true;
+    case OP_FALSE: cw_jit_store_value(a, &push, MAKE_BOOL(false)); asm_add_top(a, 1); return true;
+    case OP_POP:   asm_add_top(a, -1); return true;
+    case OP_GET_LOCAL:
+    {
+        cwJitOperand slot = cw_jit_slot(bytes[offset + 1]);
+        cw_jit_copy(a, &push, &slot);
+        asm_add_top(a, 1);
+        return true;
+    }
+    case OP_SET_LOCAL:
+    {
+        cwJitOperand slot = cw_jit_slot(bytes[offset + 1]);
+        cw_jit_copy(a, &slot, &top);
+        return true;
+    }
+    case OP_GET_GLOBAL:
+    case OP_SET_GLOBAL:
+    {
+        cw_jit_find_global(a, AS_STRING(chunk->constants[bytes[offset + 1]]), offset);
+        cwJitOperand global = cw_jit_mem(RSI, 0);
+        if (instruction == OP_GET_GLOBAL)
+        {
+            cw_jit_copy(a, &push, &global);
+            asm_add_top(a, 1);
+        }
+        else
+        {
+            /* objects might be borrowed strings the interpreter has to copy */
+            asm_mem(a, 0, false, "\x81", 7, top.base, top.disp + TYPE_OFFSET);
+            asm_u32(a, VAL_OBJECT);
+            asm_jump_bytecode(a, CC_E, offset, true);
+            cw_jit_copy(a, &global, &top);
+        }
+        return true;
+    }
+    case OP_INC_LOCAL:  case OP_DEC_LOCAL:
+    case OP_INC_GLOBAL: case OP_DEC_GLOBAL:
+    {
+        cwJitOperand target = cw_jit_slot(bytes[offset + 1]);
+        if (instruction == OP_INC_GLOBAL || instruction == OP_DEC_GLOBAL)
+        {
+            cw_jit_find_global(a, AS_STRING(chunk->constants[bytes[offset + 1]]), offset);
+            target = cw_jit_mem(RSI, 0);
+        }
+
+        bool inc = (instruction == OP_INC_LOCAL || instruction == OP_INC_GLOBAL);
+        cw_jit_guard_type(a, &target, VAL_INT, offset);
+        cw_jit_load_eax(a, &target);
+        asm_byte(a, 0x05);  /* add eax, +-1 */
+        asm_u32(a, inc ? 1u : (uint32_t)-1);
+        asm_mem(a, 0, true, "\x89", RAX, target.base, target.disp + AS_OFFSET);
+        return true;
+    }
+    case OP_ADD_LOCAL:  case OP_SUB_LOCAL:  case OP_MULT_LOCAL:  case OP_DIV_LOCAL:
+    case OP_ADD_GLOBAL: case OP_SUB_GLOBAL: case OP_MULT_GLOBAL: case OP_DIV_GLOBAL:
+    {
+        cw_jit_op(instruction, &op);
+        cwJitOperand target = cw_jit_slot(bytes[offset + 1]);
+        if ((instruction - OP_INC_LOCAL) & 1)
+        {
+            cw_jit_find_global(a, AS_STRING(chunk->constants[bytes[offset + 1]]), offset);
+            target = cw_jit_mem(RSI, 0);
+        }
+
+        cw_jit_binary(a, op, &target, &target, &top, offset);
+        asm_add_top(a, -1);
+        return true;
+    }
+    case OP_EQ:  case OP_NOTEQ:
+    case OP_LT:  case OP_LTEQ:
+    case OP_GT:  case OP_GTEQ:
+    case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+        cw_jit_op(instruction, &op);
+        if (op == JIT_EQ || op == JIT_NOTEQ)
+            cw_jit_int_binary(a, op, &second, &second, &top, offset);
+        else
+            cw_jit_binary(a, op, &second, &second, &top, offset);
+        asm_add_top(a, -1);
+        return true;
+    case OP_EQ_INT:  case OP_NOTEQ_INT:
+    case OP_LT_INT:  case OP_LTEQ_INT:  case OP_GT_INT:  case OP_GTEQ_INT:
+    case OP_ADD_INT: case OP_SUB_INT:   case OP_MULT_INT: case OP_DIV_INT:
+        cw_jit_op(cw_generic_op(instruction), &op);
+        cw_jit_int_typed(a, op, &second, &second, &top, offset);
+        asm_add_top(a, -1);
+        return true;
+    case OP_LT_FLOAT:  case OP_LTEQ_FLOAT: case OP_GT_FLOAT:   case OP_GTEQ_FLOAT:
+    case OP_ADD_FLOAT: case OP_SUB_FLOAT:  case OP_MULT_FLOAT: case OP_DIV_FLOAT:
+        /* an int operand is converted like in the generic float path */
+        cw_jit_op(cw_generic_op(instruction), &op);
+        cw_jit_float_binary(a, op, &second, &second, &top, offset);
+        asm_add_top(a, -1);
+        return true;
+    case OP_NEGATE:
+    {
+        asm_mem(a, 0, false, "\x81", 7, top.base, top.disp + TYPE_OFFSET);
+        asm_u32(a, VAL_INT);
+        int not_int = asm_jump_forward(a, CC_NE);
+        cw_jit_load_eax(a, &top);
+        asm_byte(a, 0xf7); asm_byte(a, 0xd8);   /* neg eax */
+        int done = asm_jump_forward(a, -1);
+
+        asm_bind(a, not_int);
+        cw_jit_guard_type(a, &top, VAL_FLOAT, offset);
+        cw_jit_load_eax(a, &top);
+        asm_byte(a, 0x35);                      /* xor eax, sign */
+        asm_u32(a, 0x80000000u);
+
+        asm_bind(a, done);
+        asm_mem(a, 0, true, "\x89", RAX, top.base, top.disp + AS_OFFSET);
+        return true;
+    }
+    case OP_JUMP_IF_FALSE:
+    {
+        int target = next + cw_jit_jump_offset(bytes, offset + 1);
+
+        /* null is falsey, objects are truthy, bools and ints test their payload */
+        asm_mem(a, 0, false, "\x8b", RAX, top.base, top.disp + TYPE_OFFSET);
+        asm_byte(a, 0x83); asm_byte(a, 0xf8); asm_byte(a, VAL_NULL);     /* cmp eax, VAL_NULL */
+        asm_jump_bytecode(a, CC_E, target, false);
+        asm_byte(a, 0x83); asm_byte(a, 0xf8); asm_byte(a, VAL_OBJECT);   /* cmp eax, VAL_OBJECT */
+        int truthy = asm_jump_forward(a, CC_E);
+        asm_byte(a, 0x83); asm_byte(a, 0xf8); asm_byte(a, VAL_FLOAT);    /* cmp eax, VAL_FLOAT */
+        asm_jump_bytecode(a, CC_E, offset, true);
+
+        asm_mem(a, 0, false, "\x81", 7, top.base, top.disp + AS_OFFSET);
+        asm_u32(a, 0);
+        asm_jump_bytecode(a, CC_E, target, false);
+        asm_bind(a, truthy);
+        return true;
+    }
+    case OP_JUMP_IF_FALSE_BOOL:
+        asm_mem(a, 0, false, "\x81", 7, top.base, top.disp + AS_OFFSET);
+        asm_u32(a, 0);
+        asm_jump_bytecode(a, CC_E, next + cw_jit_jump_offset(bytes, offset + 1), false);
+        return true;
+    case OP_JUMP:
+        asm_jump_bytecode(a, -1, next + cw_jit_jump_offset(bytes, offset + 1), false);
+        return true;
+    case OP_LOOP:
+        asm_jump_bytecode(a, -1, next - (uint16_t)cw_jit_jump_offset(bytes, offset + 1), false);
+        return true;
+    case OP_PRINT:
+        asm_mem(a, 0, true, "\x8d", RDI, REG_CW, (int32_t)offsetof(cwRuntime, output));  /* lea rdi, [cw->output] */
+        asm_mem(a, 0, true, "\x8d", RSI, top.base, top.disp);   /* lea rsi, [top] */
+        asm_call(a, (void*)cw_jit_print);
+        asm_add_top(a, -1);
+        return true;
+    case OP_R_MOVE:
+    {
+        uint8_t mode = bytes[offset + 1];
+        cwJitOperand dst = cw_jit_slot(bytes[offset + 2]);
+        if (CW_RK_IS_CONST(mode, CW_RK_B))
+        {
+            cw_jit_store_value(a, &dst, chunk->constants[bytes[offset + 3]]);
+        }
+        else
+        {
+            cwJitOperand src = cw_jit_slot(bytes[offset + 3]);
+            cw_jit_copy(a, &dst, &src);
+        }
+        return true;
+    }
+    case OP_R_ADD: case OP_R_SUB: case OP_R_MULT: case OP_R_DIV:
+    case OP_R_EQ:  case OP_R_NOTEQ:
+    case OP_R_LT:  case OP_R_LTEQ:
+    case OP_R_GT:  case OP_R_GTEQ:
+    {
+        uint8_t mode = bytes[offset + 1];
+        cwJitOperand dst = cw_jit_slot(bytes[offset + 2]);
+        cwJitOperand x, y;
+        if (!cw_jit_rk(chunk, mode, CW_RK_B, bytes[offset + 3], &x)) return false;
+        if (!cw_jit_rk(chunk, mode, CW_RK_C, bytes[offset + 4], &y)) return false;
+
+        cw_jit_op(instruction, &op);
+        if (op == JIT_DIV && y.constant && y.imm == 0) return false;
+        cw_jit_int_binary(a, op, &dst, &x, &y, offset);
+        return true;
+    }
+    case OP_R_BRANCH:
+    {
+        uint8_t mode = bytes[offset + 1];
+        cwJitOperand x, y;
+        if (!cw_jit_rk(chunk, mode, CW_RK_B, bytes[offset + 2], &x)) return false;
+        if (!cw_jit_rk(chunk, mode, CW_RK_C, bytes[offset + 3], &y)) return false;
+
+        cw_jit_op(OP_R_EQ + CW_RK_CMP(mode), &op);
+        cw_jit_guard_type(a, &x, VAL_INT, offset);
+        cw_jit_guard_type(a, &y, VAL_INT, offset);
+        cw_jit_load_eax(a, &x);
+        cw_jit_int_op(a, op, &y, offset);
+
+        /* jump if the comparison is false */
+        asm_jump_bytecode(a, cw_jit_condition(op) ^ 1, next + cw_jit_jump_offset(bytes, offset + 4), false);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static void cw_jit_prologue(cwAssembler* a)
+{
+    /* push rbx, r12, r13, r14, r15 keeps the stack 16 byte aligned for calls */
+    asm_byte(a, 0x53);
+    asm_byte(a, 0x41); asm_byte(a, 0x54);
+    asm_byte(a, 0x41); asm_byte(a, 0x55);
+    asm_byte(a, 0x41); asm_byte(a, 0x56);
+    asm_byte(a, 0x41); asm_byte(a, 0x57);
+
+    asm_byte(a, 0x48); asm_byte(a, 0x89); asm_byte(a, 0xfb);   /* mov rbx, rdi */
+    asm_byte(a, 0x49); asm_byte(a, 0x89); asm_byte(a, 0xf4);   /* mov r12, rsi */
+    asm_byte(a, 0x49); asm_byte(a, 0x89); asm_byte(a, 0xd5);   /* mov r13, rdx */
+    asm_byte(a, 0x49); asm_byte(a, 0x89); asm_byte(a, 0xce);   /* mov r14, rcx */
+}
+
+/* stores the stack top and returns ip to the interpreter */
+static void cw_jit_exit(cwAssembler* a, const uint8_t* ip)
+{
+    asm_byte(a, 0x4d); asm_byte(a, 0x89); asm_byte(a, 0x65); asm_byte(a, 0x00);   /* mov [r13], r12 */
+    asm_mov_imm64(a, RAX, (uint64_t)(uintptr_t)ip);
+
+    asm_byte(a, 0x41); asm_byte(a, 0x5f);
+    asm_byte(a, 0x41); asm_byte(a, 0x5e);
+    asm_byte(a, 0x41); asm_byte(a, 0x5d);
+    asm_byte(a, 0x41); asm_byte(a, 0x5c);
+    asm_byte(a, 0x5b);
+    asm_byte(a, 0xc3);
+}
+
+static bool cw_jit_assemble(cwAssembler* a, int entry, int* max_depth)
+{
+    int depth = 0;
+    *max_depth = 0;
+
+    cw_jit_prologue(a);
+    if (entry != a->start) asm_jump_bytecode(a, -1, entry, false);
+    for (int offset = a->start; offset < a->end; offset += cw_op_length(a->chunk->bytes + offset))
+    {
+        a->labels[offset - a->start] = (int)a->len;
+        if (!cw_jit_instruction(a, offset)) return false;
+
+        depth += cw_stack_effect(a->chunk->bytes + offset, NULL, NULL);
+        if (depth > *max_depth) *max_depth = depth;
+    }
+
+    /* resolve jumps, everything that leaves the loop gets an exit stub */
+    for (int i = 0; i < a->fixup_len; ++i)
+    {
+        cwJitFixup* fixup = &a->fixups[i];
+        bool inside = fixup->target >= a->start && fixup->target < a->end;
+        if (inside && !fixup->exit && a->labels[fixup->target - a->start] >= 0)
+        {
+            asm_patch_u32(a, fixup->pos, (uint32_t)(a->labels[fixup->target - a->start] - (fixup->pos + 4)));
+            continue;
+        }
+
+        asm_bind(a, fixup->pos);
+        cw_jit_exit(a, a->chunk->bytes + fixup->target);
+    }
+    return true;
+}
+
+/* --------------------------| loops |--------------------------------------------------- */
+/*
+ * grows [start, end) from a single backedge to the whole loop: a for loop
+ * spreads over the condition, the increment and the body which are only
+ * connected by unconditional jumps. conditional jumps out of it are exits.
+ * a loop can have more than one backedge once jumps to it are threaded,
+ * the region reaches up to the last one.
+ */
+static void cw_jit_region(const cwChunk* chunk, int* start, int* end)
+{
+    bool grown = true;
+    while (grown)
+    {
+        grown = false;
+        for (int offset = 0; offset < (int)chunk->len; offset += cw_op_length(chunk->bytes + offset))
+        {
+            uint8_t instruction = chunk->bytes[offset];
+            if (offset < *start) continue;
+            if (instruction != OP_JUMP && instruction != OP_LOOP) continue;
+
+            int next = offset + 3;
+            int target = (instruction == OP_LOOP)
+                ? next - (uint16_t)cw_jit_jump_offset(chunk->bytes, offset + 1)
+                : next + cw_jit_jump_offset(chunk->bytes, offset + 1);
+
+            if (offset >= *end)
+            {
+                if (instruction == OP_LOOP && target >= *start && target < *end)
+                {
+                    *end = next;
+                    grown = true;
+                }
+                continue;
+            }
+
+            if (target < *start)
+            {
+                *start = target;
+                grown = true;
+            }
+            else if (target >= *end)
+            {
+                /* the jump only stays in the loop if code behind it loops back into the region */
+                for (int back = target; back < (int)chunk->len; back += cw_op_length(chunk->bytes + back))
+                {
+                    if (chunk->bytes[back] != OP_LOOP) continue;
+
+                    int back_target = back + 3 - (uint16_t)cw_jit_jump_offset(chunk->bytes, back + 1);
+                    if (back_target >= *start && back_target < *end)
+                    {
+                        *end = back + 3;
+                        grown = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void cw_jit_perf_map(cwJit* jit, cwJitLoop* loop, cwFunction* function, int start)
+{
+    if (!jit->perf_map)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+        jit->perf_map = fopen(path, "a");
+        if (!jit->perf_map) return;
+    }
+
+    fprintf(jit->perf_map, "%lx %zx clockwork:%s+%d\n", (unsigned long)(uintptr_t)loop->code, loop->len,
+            function->name ? function->name->raw : "script", start);
+    fflush(jit->perf_map);
+}
+
+static void cw_jit_compile(cwJit* jit, cwJitLoop* loop, cwFunction* function, uint8_t* loop_end)
+{
+    const cwChunk* chunk = &function->chunk;
+    cwAssembler a = { 0 };
+    a.chunk = chunk;
+    a.start = (int)(loop->header - chunk->bytes);
+    a.end = (int)(loop_end - chunk->bytes);
+    cw_jit_region(chunk, &a.start, &a.end);
+    loop->start = chunk->bytes + a.start;
+    loop->end = chunk->bytes + a.end;
+    a.labels = CW_ALLOCATE(int, a.end - a.start);
+    for (int i = 0; i < a.end - a.start; ++i) a.labels[i] = -1;
+
+    loop->failed = !cw_jit_assemble(&a, (int)(loop->header - chunk->bytes), &loop->max_depth);
+    if (!loop->failed)
+    {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size = (a.len + page - 1) & ~(page - 1);
+        void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem != MAP_FAILED)
+        {
+            memcpy(mem, a.code, a.len);
+            mprotect(mem, size, PROT_READ | PROT_EXEC);
+            loop->code = (cwJitCode)mem;
+            loop->size = size;
+            loop->len = a.len;
+            cw_jit_perf_map(jit, loop, function, a.start);
+        }
+        else
+        {
+            loop->failed = true;
+        }
+    }
+
+    CW_FREE_ARRAY(int, a.labels, a.end - a.start);
+    CW_FREE_ARRAY(cwJitFixup, a.fixups, a.fixup_cap);
+    CW_FREE_ARRAY(uint8_t, a.code, a.cap);
+}
+
+static void cw_jit_release(cwJitLoop* loop)
+{
+    if (loop->code) munmap((void*)loop->code, loop->size);
+    loop->code = NULL;
+    loop->size = 0;
+    loop->len = 0;
+}
+
+static cwJitLoop* cw_jit_find_loop(cwJit* jit, const uint8_t* header)
+{
+    uint32_t index = (uint32_t)(((uintptr_t)header >> 2) * 2654435761u) % CW_JIT_MAX_LOOPS;
+    for (int i = 0; i < CW_JIT_MAX_LOOPS; ++i)
+    {
+        cwJitLoop* loop = &jit->loops[index];
+        if (loop->header == header) return loop;
+        if (loop->header == NULL)
+        {
+            loop->header = header;
+            return loop;
+        }
+        index = (index + 1) % CW_JIT_MAX_LOOPS;
+    }
+    return NULL;
+}
+
+cwJit* cw_jit_new(void)
+{
+    cwJit* jit = cw_reallocate(NULL, 0, sizeof(cwJit));
+    memset(jit, 0, sizeof(cwJit));
+    return jit;
+}
+
+void cw_jit_free(cwJit* jit)
+{
+    if (!jit) return;
+
+    for (int i = 0; i < CW_JIT_MAX_LOOPS; ++i) cw_jit_release(&jit->loops[i]);
+    if (jit->perf_map) fclose(jit->perf_map);
+    cw_reallocate(jit, sizeof(cwJit), 0);
+}
+
+void cw_jit_forget(cwJit* jit, const cwChunk* chunk)
+{
+    if (!jit) return;
+
+    /* entries keep their header for probing, code loaded there later starts cold */
+    for (int i = 0; i < CW_JIT_MAX_LOOPS; ++i)
+    {
+        cwJitLoop* loop = &jit->loops[i];
+        if (loop->header >= chunk->bytes && loop->header < chunk->bytes + chunk->len)
+        {
+            cw_jit_release(loop);
+            const uint8_t* header = loop->header;
+            memset(loop, 0, sizeof(cwJitLoop));
+            loop->header = header;
+        }
+    }
+}
+
+uint8_t* cw_jit_backedge(cwRuntime* cw, cwFunction* function, cwValue* slots, uint8_t* header, uint8_t* loop_end)
+{
+    cwJitLoop* loop = cw_jit_find_loop(cw->jit, header);
+    if (!loop || loop->failed) return header;
+
+    if (!loop->code)
+    {
+        if (++loop->hotness < CW_JIT_THRESHOLD) return header;
+        cw_jit_compile(cw->jit, loop, function, loop_end);
+        if (!loop->code) return header;
+    }
+
+    cwValue* top = cw->stack + cw->stack_index;
+    if (top + loop->max_depth >= cw->stack + CW_STACK_MAX) return header;
+
+    uint8_t* ip = loop->code(slots, top, &top, cw);
+    cw->stack_index = top - cw->stack;
+
+    /* resuming inside of the loop means a guard failed */
+    if (ip >= loop->start && ip < loop->end && ++loop->fails >= CW_JIT_MAX_FAILS)
+    {
+        cw_jit_release(loop);
+        loop->failed = true;
+    }
+    return ip;
+}
+
+#else
+
+cwJit* cw_jit_new(void)         { return NULL; }
+void   cw_jit_free(cwJit* jit)  { }
+void   cw_jit_forget(cwJit* jit, const cwChunk* chunk) { }
+
+uint8_t* cw_jit_backedge(cwRuntime* cw, cwFunction* function, cwValue* slots, uint8_t* header, uint8_t* loop_end)
+{
+    return header;
+}
+
+#endif /* CW_JIT */
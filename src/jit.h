@@ -0,0 +1,40 @@
+#ifndef CLOCKWORK_JIT_H
+#define CLOCKWORK_JIT_H
+
+#include "common.h"
+
+/*
+ * Baseline template JIT for hot loops. Every taken OP_LOOP counts a backedge
+ * for its loop header, once a loop reaches CW_JIT_THRESHOLD its body (from
+ * the header to the end of the OP_LOOP) is translated instruction by
+ * instruction into x86-64 machine code working on the VM stack and slots.
+ *
+ * Arithmetic, comparisons and branches carry inline type guards for ints
+ * and floats. A failed guard, an exit from the loop or anything the JIT can
+ * not handle returns to the interpreter at the bytecode of that instruction.
+ * Compiled loops are registered in /tmp/perf-<pid>.map for perf.
+ */
+#if defined(__x86_64__) && defined(__linux__) && !defined(CW_NO_JIT)
+#define CW_JIT
+#endif
+
+#define CW_JIT_THRESHOLD    1024    /* backedges before a loop gets compiled */
+#define CW_JIT_MAX_LOOPS    256     /* loops tracked per runtime */
+#define CW_JIT_MAX_FAILS    64      /* guard failures before a loop falls back for good */
+
+typedef struct cwJit cwJit;
+
+cwJit* cw_jit_new(void);
+void   cw_jit_free(cwJit* jit);
+
+/* drops the loops compiled from chunk before it is freed */
+void   cw_jit_forget(cwJit* jit, const cwChunk* chunk);
+
+/*
+ * called on a taken backedge to header, loop_end points behind the OP_LOOP.
+ * returns the ip to continue interpreting at, which is header if the loop
+ * is not compiled (yet).
+ */
+uint8_t* cw_jit_backedge(cwRuntime* cw, cwFunction* function, cwValue* slots, uint8_t* header, uint8_t* loop_end);
+
+#endif /* !CLOCKWORK_JIT_H */
@@ -0,0 +1,187 @@
+/* sysconf(_SC_NPROCESSORS_ONLN) is not part of c99 */
+#define _DEFAULT_SOURCE
+
+#include "lexer.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+
+#define CW_TOKEN_MOD_SHIFT 6
+
+static void cw_lex_grow(cwTokenBuffer* tokens, size_t capacity)
+{
+    tokens->types   = CW_GROW_ARRAY(uint8_t, tokens->types, tokens->capacity, capacity);
+    tokens->offsets = CW_GROW_ARRAY(uint32_t, tokens->offsets, tokens->capacity, capacity);
+    tokens->lengths = CW_GROW_ARRAY(uint32_t, tokens->lengths, tokens->capacity, capacity);
+    tokens->lines   = CW_GROW_ARRAY(uint32_t, tokens->lines, tokens->capacity, capacity);
+    tokens->hashes  = CW_GROW_ARRAY(uint32_t, tokens->hashes, tokens->capacity, capacity);
+    tokens->capacity = capacity;
+}
+
+static void cw_lex_push(cwTokenBuffer* tokens, const char* src, const cwToken* token, uint32_t lines)
+{
+    if (tokens->count == tokens->capacity) cw_lex_grow(tokens, CW_GROW_CAPACITY(tokens->capacity));
+
+    size_t i = tokens->count++;
+    tokens->types[i]   = (uint8_t)(token->type | (token->mod << CW_TOKEN_MOD_SHIFT));
+    tokens->offsets[i] = (uint32_t)(token->start - src);
+    tokens->lengths[i] = (uint32_t)(token->end - token->start);
+    tokens->lines[i]   = lines;
+    tokens->hashes[i]  = token->hash;
+}
+
+void cw_lex_free(cwTokenBuffer* tokens)
+{
+    CW_FREE_ARRAY(uint8_t, tokens->types, tokens->capacity);
+    CW_FREE_ARRAY(uint32_t, tokens->offsets, tokens->capacity);
+    CW_FREE_ARRAY(uint32_t, tokens->lengths, tokens->capacity);
+    CW_FREE_ARRAY(uint32_t, tokens->lines, tokens->capacity);
+    CW_FREE_ARRAY(uint32_t, tokens->hashes, tokens->capacity);
+    memset(tokens, 0, sizeof(cwTokenBuffer));
+}
+
+void cw_lex_token(const cwTokenBuffer* tokens, const char* src, size_t index, int line, cwToken* token)
+{
+    /* reading past the end keeps returning TOKEN_EOF */
+    uint32_t lines = 0;
+    if (index < tokens->count) lines = tokens->lines[index];
+    else                       index = tokens->count - 1;
+
+    token->type  = (cwTokenType)(tokens->types[index] & ((1 << CW_TOKEN_MOD_SHIFT) - 1));
+    token->mod   = (cwTokenMod)(tokens->types[index] >> CW_TOKEN_MOD_SHIFT);
+    token->start = src + tokens->offsets[index];
+    token->end   = token->start + tokens->lengths[index];
+    token->line  = line + (int)lines;
+    token->hash  = tokens->hashes[index];
+}
+
+/* --------------------------| pieces |-------------------------------------------------- */
+typedef struct
+{
+    pthread_t thread;
+    const char* src;
+    size_t start;
+    size_t end;
+    bool last;
+
+    /* lines are counted from 0 at the start of the piece */
+    cwTokenBuffer tokens;
+    int last_line;      /* of the last token */
+    int newlines;       /* in the whole piece */
+} cwLexPiece;
+
+/* tokens starting at or after the end of a piece belong to the next one */
+static void* cw_lex_piece(void* arg)
+{
+    cwLexPiece* piece = arg;
+    const char* end = piece->src + piece->end;
+
+    /* about one token per four bytes of source, growing is rare */
+    cw_lex_grow(&piece->tokens, (piece->end - piece->start) / 4 + 16);
+
+    cwToken token;
+    const char* cursor = piece->src + piece->start;
+    int line = 0;
+    for (;;)
+    {
+        cursor = cw_scan_token(NULL, &token, cursor, line);
+        if (!piece->last && token.start >= end) break;
+
+        cw_lex_push(&piece->tokens, piece->src, &token, (uint32_t)(token.line - line));
+        line = token.line;
+        if (token.type == TOKEN_EOF) break;
+    }
+    piece->last_line = line;
+
+    if (!piece->last)
+    {
+        for (const char* c = piece->src + piece->start; (c = memchr(c, '\n', (size_t)(end - c))) != NULL; ++c)
+            piece->newlines++;
+    }
+    return NULL;
+}
+
+/* appends the tokens of piece, line is the line of the last token so far and is updated */
+static void cw_lex_append(cwTokenBuffer* tokens, const cwLexPiece* piece, int base, int* line)
+{
+    const cwTokenBuffer* part = &piece->tokens;
+    if (part->count == 0) return;
+
+    size_t at = tokens->count;
+    memcpy(tokens->types + at,   part->types,   part->count * sizeof(uint8_t));
+    memcpy(tokens->offsets + at, part->offsets, part->count * sizeof(uint32_t));
+    memcpy(tokens->lengths + at, part->lengths, part->count * sizeof(uint32_t));
+    memcpy(tokens->lines + at,   part->lines,   part->count * sizeof(uint32_t));
+    memcpy(tokens->hashes + at,  part->hashes,  part->count * sizeof(uint32_t));
+    tokens->count += part->count;
+
+    /* the first token counted its lines from the start of the piece */
+    tokens->lines[at] += (uint32_t)(base - *line);
+    *line = base + piece->last_line;
+}
+
+void cw_lex(cwTokenBuffer* tokens, const char* src)
+{
+    memset(tokens, 0, sizeof(cwTokenBuffer));
+
+    size_t len = strlen(src);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int count = (int)(len / CW_LEX_SPLIT);
+    if (count > CW_LEX_THREADS) count = CW_LEX_THREADS;
+    if (count > cpus)           count = (int)cpus;
+    if (count < 1)              count = 1;
+
+    /* cut after the first newline past every count-th of the source */
+    cwLexPiece pieces[CW_LEX_THREADS];
+    int n = 0;
+    size_t start = 0;
+    for (int i = 1; i < count; ++i)
+    {
+        size_t target = len / count * i;
+        if (target < start) continue;
+
+        const char* newline = memchr(src + target, '\n', len - target);
+        if (!newline) break;
+
+        size_t end = (size_t)(newline - src) + 1;
+        pieces[n++] = (cwLexPiece){ .src = src, .start = start, .end = end, .last = false };
+        start = end;
+    }
+    pieces[n++] = (cwLexPiece){ .src = src, .start = start, .end = len, .last = true };
+
+    if (n == 1)
+    {
+        pieces[0].tokens = *tokens;
+        cw_lex_piece(&pieces[0]);
+        *tokens = pieces[0].tokens;
+        return;
+    }
+
+    /* the first piece is lexed here, a piece whose thread fails to start as well */
+    bool started[CW_LEX_THREADS] = { false };
+    for (int i = 1; i < n; ++i)
+        started[i] = pthread_create(&pieces[i].thread, NULL, cw_lex_piece, &pieces[i]) == 0;
+
+    cw_lex_piece(&pieces[0]);
+
+    size_t total = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (started[i])   pthread_join(pieces[i].thread, NULL);
+        else if (i > 0)   cw_lex_piece(&pieces[i]);
+        total += pieces[i].tokens.count;
+    }
+
+    cw_lex_grow(tokens, total);
+    int base = 1;
+    int line = 1;
+    for (int i = 0; i < n; ++i)
+    {
+        cw_lex_append(tokens, &pieces[i], base, &line);
+        base += pieces[i].newlines;
+        cw_lex_free(&pieces[i].tokens);
+    }
+}
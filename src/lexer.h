@@ -0,0 +1,40 @@
+#ifndef CLOCKWORK_LEXER_H
+#define CLOCKWORK_LEXER_H
+
+#include "common.h"
+#include "scanner.h"
+
+/*
+ * Tokenizes a whole source before it is parsed. Tokens are kept as a struct
+ * of arrays, the parser reads them in order and builds a cwToken for the
+ * current and previous one only.
+ *
+ * Neither strings nor comments continue past a newline, so every newline is
+ * a safe place to split a source. Sources of at least CW_LEX_SPLIT bytes per
+ * thread are cut into pieces at newlines, lexed on up to CW_LEX_THREADS
+ * threads, no more than there are cores, and stitched back together.
+ */
+
+#define CW_LEX_THREADS 8
+#define CW_LEX_SPLIT   (1 << 20)   /* smallest piece of a source lexed on a thread of its own */
+
+typedef struct
+{
+    size_t count;
+    size_t capacity;
+
+    uint8_t*  types;     /* cwTokenType, the cwTokenMod in the upper two bits */
+    uint32_t* offsets;   /* start in the source */
+    uint32_t* lengths;
+    uint32_t* lines;     /* lines since the previous token */
+    uint32_t* hashes;    /* see cwToken */
+} cwTokenBuffer;
+
+/* lexes src, which must be shorter than 4 GiB, up to and including its TOKEN_EOF */
+void cw_lex(cwTokenBuffer* tokens, const char* src);
+void cw_lex_free(cwTokenBuffer* tokens);
+
+/* token index of tokens lexed from src, line is the line of token index - 1 */
+void cw_lex_token(const cwTokenBuffer* tokens, const char* src, size_t index, int line, cwToken* token);
+
+#endif /* !CLOCKWORK_LEXER_H */
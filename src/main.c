@@ -1,5 +1,11 @@
 #include "runtime.h"
+#include "aot.h"
+#include "array.h"
 #include "debug.h"
+#include "host.h"
+#include "memo.h"
+#include "memory.h"
+#include "program.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -70,19 +76,232 @@ static InterpretResult run_file(cwRuntime* cw, const char* path)
     return result;
 }
 
+static int compile_file(cwRuntime* cw, const char* path, const char* out_path)
+{
+    char* source = read_file(path);
+    if (!source) return INTERPRET_COMPILE_ERROR;
+
+    int status = INTERPRET_COMPILE_ERROR;
+    cwFunction* function = cw_compile(cw, source);
+    if (function)
+    {
+        FILE* out = fopen(out_path, "w");
+        if (!out)
+            fprintf(stderr, "Could not open file \"%s\".\n", out_path);
+        else if (!cw_aot_emit(function, out))
+            fprintf(stderr, "Could not write file \"%s\".\n", out_path);
+        else
+            status = 0;
+
+        if (out) fclose(out);
+    }
+
+    free(source);
+    return status;
+}
+
+/* reports the result caches of the pure functions that were called */
+static void print_memo_stats(const cwRuntime* cw)
+{
+    for (int i = 0; i < cw->memo_cap; ++i)
+    {
+        const cwMemo* memo = cw->memos[i];
+        if (!memo) continue;
+
+        fprintf(stderr, "%s(): %zu hits, %zu misses, %d cached\n",
+                memo->name ? memo->name->raw : "?", memo->hits, memo->misses, memo->count);
+    }
+}
+
+/* --------------------------| streaming |---------------------------------------------- */
+#define STREAM_BUFFER_SIZE  (1 << 20)   /* initial read buffer, grows for longer records */
+
+/* the current record, line and fields are views into the read buffer */
+static struct
+{
+    cwString line;
+    cwString* fields;
+    int count;
+    int cap;
+    char separator;     /* '\0' splits at runs of blanks */
+} record;
+
+static bool native_field(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    static cwString empty;
+
+    if (!IS_INT(args[0]))
+    {
+        cw_runtime_error(cw, "Field index must be an integer.");
+        return false;
+    }
+
+    int i = AS_INT(args[0]);
+    if (i == 0)                         *result = MAKE_OBJECT(&record.line);
+    else if (i > 0 && i <= record.count) *result = MAKE_OBJECT(&record.fields[i - 1]);
+    else                                *result = cw_str_view(&empty, "", 0);
+    return true;
+}
+
+static void split_record(const char* start, size_t len)
+{
+    cw_str_view(&record.line, start, len);
+    record.count = 0;
+
+    if (len == 0) return;
+
+    const char* end = start + len;
+    const char* cursor = start;
+    while (true)
+    {
+        const char* field = cursor;
+        if (record.separator)
+        {
+            while (cursor < end && *cursor != record.separator) cursor++;
+        }
+        else
+        {
+            while (field < end && (*field == ' ' || *field == '\t')) field++;
+            if (field == end) break;
+            cursor = field;
+            while (cursor < end && *cursor != ' ' && *cursor != '\t') cursor++;
+        }
+
+        if (record.count == record.cap)
+        {
+            int old_cap = record.cap;
+            record.cap = CW_GROW_CAPACITY(old_cap);
+            record.fields = CW_GROW_ARRAY(cwString, record.fields, old_cap, record.cap);
+        }
+        cw_str_view(&record.fields[record.count++], field, cursor - field);
+
+        if (cursor == end) break;
+        cursor++;
+    }
+}
+
+/* compiles the script once and runs it for every record read from stdin */
+static int stream_file(cwRuntime* cw, const char* path, char separator, char delimiter)
+{
+    char* source = read_file(path);
+    if (!source) return INTERPRET_COMPILE_ERROR;
+
+    cwProgram* program = cw_program_compile(cw, source);
+    free(source);
+    if (!program) return INTERPRET_COMPILE_ERROR;
+
+    /* print writes straight to the stdout descriptor in blocks, past stdio */
+    fflush(stdout);
+    cw_set_output_fd(cw, 1);
+
+    record.separator = separator;
+    cw_define_native(cw, "field", native_field, 1);
+    cwString* line_name = cw_str_copy(cw, "line", 4);
+    cwString* nf_name = cw_str_copy(cw, "NF", 2);
+    cwString* nr_name = cw_str_copy(cw, "NR", 2);
+
+    size_t cap = STREAM_BUFFER_SIZE;
+    char* buffer = CW_ALLOCATE(char, cap);
+    size_t start = 0;       /* first byte of the next record */
+    size_t scanned = 0;     /* bytes searched for the delimiter */
+    size_t len = 0;
+    int32_t nr = 0;
+    bool eof = false;
+
+    InterpretResult status = INTERPRET_OK;
+    while (status == INTERPRET_OK)
+    {
+        char* end = memchr(buffer + scanned, delimiter, len - scanned);
+        if (!end && !eof)
+        {
+            /* move the partial record to the front, grow if it fills the buffer, read more */
+            memmove(buffer, buffer + start, len - start);
+            len -= start;
+            scanned = len;
+            start = 0;
+            if (len == cap)
+            {
+                buffer = CW_GROW_ARRAY(char, buffer, cap, cap * 2);
+                cap *= 2;
+            }
+
+            size_t n = fread(buffer + len, 1, cap - len, stdin);
+            if (n == 0) eof = true;
+            len += n;
+            continue;
+        }
+
+        /* the last record may lack its delimiter */
+        size_t record_end = end ? (size_t)(end - buffer) : len;
+        if (!end && start == len) break;
+
+        split_record(buffer + start, record_end - start);
+        cw_table_insert(&cw->globals, line_name, MAKE_OBJECT(&record.line));
+        cw_table_insert(&cw->globals, nf_name, MAKE_INT(record.count));
+        cw_table_insert(&cw->globals, nr_name, MAKE_INT(++nr));
+        status = cw_program_run(cw, program);
+
+        start = scanned = end ? record_end + 1 : len;
+    }
+
+    cw_output_flush(&cw->output);
+    CW_FREE_ARRAY(char, buffer, cap);
+    CW_FREE_ARRAY(cwString, record.fields, record.cap);
+    cw_program_free(cw, program);
+    return status;
+}
+
+/* parses [-F sep] [-R sep] <path> */
+static int stream_args(cwRuntime* cw, int argc, const char* argv[])
+{
+    char separator = '\0';
+    char delimiter = '\n';
+    int i = 0;
+    for (; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-F") == 0)      separator = argv[i + 1][0];
+        else if (strcmp(argv[i], "-R") == 0) delimiter = argv[i + 1][0];
+        else break;
+    }
+
+    if (i != argc - 1)
+    {
+        fprintf(stderr, "Usage: clockwork -n [-F sep] [-R sep] <path> < input\n");
+        return INTERPRET_COMPILE_ERROR;
+    }
+    return stream_file(cw, argv[i], separator, delimiter);
+}
+
 int main(int argc, const char* argv[])
 {
     cwRuntime cw = { 0 };
     cw_init(&cw);
+    cw_define_array_natives(&cw);
+
+    /* -O and -M go in front of everything else */
+    bool memo_stats = false;
+    while (argc >= 2 && (strcmp(argv[1], "-O") == 0 || strcmp(argv[1], "-M") == 0))
+    {
+        if (argv[1][1] == 'O') cw.optimize = true;
+        else                   memo_stats = true;
+        argc--;
+        argv++;
+    }
 
     int status = 0;
     if (argc == 1) 
         repl(&cw);
     else if (argc == 2)
         status = run_file(&cw, argv[1]);
+    else if (argc == 4 && strcmp(argv[1], "-c") == 0)
+        status = compile_file(&cw, argv[2], argv[3]);
+    else if (argc >= 3 && strcmp(argv[1], "-n") == 0)
+        status = stream_args(&cw, argc - 2, argv + 2);
     else
-        fprintf(stderr, "Usage: clockwork <path>\n");
+        fprintf(stderr, "Usage: clockwork [-O] [-M] [path]\n       clockwork [-O] -c <path> <out.c>\n"
+                        "       clockwork [-O] [-M] -n [-F sep] [-R sep] <path> < input\n");
 
+    if (memo_stats) print_memo_stats(&cw);
     cw_free(&cw);
 
     return status;
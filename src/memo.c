@@ -0,0 +1,197 @@
+#include "memo.h"
+
+#include <string.h>
+
+#include "memory.h"
+#include "runtime.h"
+
+/* --------------------------| keys |---------------------------------------------------- */
+/* writes the argument into the key at len, returns the new length or -1 if it can not be a key */
+static int cw_memo_write(char* key, int len, cwValue arg)
+{
+    const void* bits = &arg.as.ival;
+    int size = 0;
+    char tag;
+
+    switch (arg.type)
+    {
+    case VAL_NULL:   tag = 'n'; break;
+    case VAL_BOOL:   tag = 'b'; size = sizeof(int32_t); break;
+    case VAL_INT:    tag = 'i'; size = sizeof(int32_t); break;
+    case VAL_FLOAT:  tag = 'f'; size = sizeof(float); break;
+    case VAL_OBJECT:
+    {
+        if (!IS_STRING(arg) || AS_STRING(arg)->len > CW_MEMO_KEY_MAX) return -1;
+
+        /* the length keeps the text apart from the arguments behind it */
+        uint32_t text = (uint32_t)AS_STRING(arg)->len;
+        if (len + 1 + (int)sizeof(text) + (int)text > CW_MEMO_KEY_MAX) return -1;
+        key[len++] = 's';
+        memcpy(key + len, &text, sizeof(text));
+        memcpy(key + len + sizeof(text), AS_RAWSTRING(arg), text);
+        return len + sizeof(text) + text;
+    }
+    }
+
+    if (len + 1 + size > CW_MEMO_KEY_MAX) return -1;
+    key[len++] = tag;
+    memcpy(key + len, bits, size);
+    return len + size;
+}
+
+/* keys are owned by their cache, they are neither interned nor objects of the runtime */
+static cwString* cw_memo_key_new(const char* src, int len, uint32_t hash)
+{
+    cwString* key = cw_reallocate(NULL, 0, sizeof(cwString));
+    key->obj.type = OBJ_STRING;
+    key->obj.next = NULL;
+    key->raw = CW_ALLOCATE(char, len + 1);
+    memcpy(key->raw, src, len);
+    key->raw[len] = '\0';
+    key->len = len;
+    key->hash = hash;
+    key->view = false;
+    return key;
+}
+
+void cw_memo_discard(cwString* key)
+{
+    if (!key) return;
+    CW_FREE_ARRAY(char, key->raw, key->len + 1);
+    cw_reallocate(key, sizeof(cwString), 0);
+}
+
+/* --------------------------| order of use |-------------------------------------------- */
+static void cw_memo_unlink(cwMemo* memo, int index)
+{
+    cwMemoEntry* entry = &memo->entries[index];
+    if (entry->prev >= 0) memo->entries[entry->prev].next = entry->next;
+    else                  memo->head = entry->next;
+    if (entry->next >= 0) memo->entries[entry->next].prev = entry->prev;
+    else                  memo->tail = entry->prev;
+}
+
+static void cw_memo_push_front(cwMemo* memo, int index)
+{
+    cwMemoEntry* entry = &memo->entries[index];
+    entry->prev = -1;
+    entry->next = memo->head;
+    if (memo->head >= 0) memo->entries[memo->head].prev = index;
+    memo->head = index;
+    if (memo->tail < 0) memo->tail = index;
+}
+
+/* --------------------------| caches |-------------------------------------------------- */
+static cwMemo* cw_memo_get(cwRuntime* cw, cwFunction* function)
+{
+    if (function->memo >= cw->memo_cap)
+    {
+        int old_cap = cw->memo_cap;
+        while (cw->memo_cap <= function->memo) cw->memo_cap = CW_GROW_CAPACITY(cw->memo_cap);
+        cw->memos = CW_GROW_ARRAY(cwMemo*, cw->memos, old_cap, cw->memo_cap);
+        for (int i = old_cap; i < cw->memo_cap; ++i) cw->memos[i] = NULL;
+    }
+
+    cwMemo* memo = cw->memos[function->memo];
+    if (memo) return memo;
+
+    memo = cw_reallocate(NULL, 0, sizeof(cwMemo));
+    memo->name = function->name;
+    cw_table_init(&memo->keys);
+    memo->count = 0;
+    memo->head = memo->tail = -1;
+    memo->hits = memo->misses = 0;
+    cw->memos[function->memo] = memo;
+    return memo;
+}
+
+bool cw_memo_lookup(cwRuntime* cw, cwFunction* function, int argc, cwMemo** memo, cwString** key)
+{
+    *memo = cw_memo_get(cw, function);
+    *key = NULL;
+
+    char raw[CW_MEMO_KEY_MAX];
+    int len = 0;
+    const cwValue* args = cw->stack + cw->stack_index - argc;
+    for (int i = 0; i < argc && len >= 0; ++i) len = cw_memo_write(raw, len, args[i]);
+
+    if (len < 0)
+    {
+        (*memo)->misses++;
+        return false;
+    }
+
+    uint32_t hash = cw_hash_str(raw, len);
+    cwString* found = cw_table_find_key(&(*memo)->keys, raw, len, hash);
+    if (!found)
+    {
+        (*memo)->misses++;
+        *key = cw_memo_key_new(raw, len, hash);
+        return false;
+    }
+
+    int index = AS_INT(*cw_table_find(&(*memo)->keys, found));
+    if (index != (*memo)->head)
+    {
+        cw_memo_unlink(*memo, index);
+        cw_memo_push_front(*memo, index);
+    }
+
+    (*memo)->hits++;
+    cw->stack_index -= argc + 1;
+    cw->stack[cw->stack_index++] = (*memo)->entries[index].result;
+    return true;
+}
+
+void cw_memo_store(cwMemo* memo, cwString* key, cwValue result)
+{
+    /* arrays can change after the call, views only live during it */
+    if (IS_ARRAY(result) || (IS_STRING(result) && AS_STRING(result)->view)
+        || cw_table_find_key(&memo->keys, key->raw, key->len, key->hash))
+    {
+        cw_memo_discard(key);
+        return;
+    }
+
+    int index;
+    if (memo->count < CW_MEMO_SIZE)
+    {
+        index = memo->count++;
+    }
+    else
+    {
+        /* the least recently used result makes room */
+        index = memo->tail;
+        cw_memo_unlink(memo, index);
+        cw_table_remove(&memo->keys, memo->entries[index].key);
+        cw_memo_discard(memo->entries[index].key);
+    }
+
+    memo->entries[index].key = key;
+    memo->entries[index].result = result;
+    cw_table_insert(&memo->keys, key, MAKE_INT(index));
+    cw_memo_push_front(memo, index);
+}
+
+const cwMemo* cw_memo_find(const cwRuntime* cw, const cwFunction* function)
+{
+    if (function->memo < 0 || function->memo >= cw->memo_cap) return NULL;
+    return cw->memos[function->memo];
+}
+
+void cw_memo_free(cwRuntime* cw)
+{
+    for (int i = 0; i < cw->memo_cap; ++i)
+    {
+        cwMemo* memo = cw->memos[i];
+        if (!memo) continue;
+
+        for (int j = 0; j < memo->count; ++j) cw_memo_discard(memo->entries[j].key);
+        cw_table_free(&memo->keys);
+        cw_reallocate(memo, sizeof(cwMemo), 0);
+    }
+
+    CW_FREE_ARRAY(cwMemo*, cw->memos, cw->memo_cap);
+    cw->memos = NULL;
+    cw->memo_cap = 0;
+}
@@ -0,0 +1,81 @@
+#ifndef CLOCKWORK_MEMO_H
+#define CLOCKWORK_MEMO_H
+
+#include "common.h"
+#include "table.h"
+
+/*
+ * Result caches of functions declared pure:
+ *
+ *   pure function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+ *
+ * Every runtime keeps a cache per pure function, compiled functions are
+ * shared with worker runtimes and never modified. A call is looked up by
+ * its arguments, which are written into a key string of a type tag and
+ * the bits of the value per argument (the text for strings). On a hit the
+ * cached result replaces the call without a frame, on a miss the frame of
+ * the call carries the key and its result is stored when it returns.
+ *
+ *   - calls with arrays, functions or more than CW_MEMO_KEY_MAX bytes of
+ *     arguments are not looked up, results that are arrays or string views
+ *     are not stored
+ *   - a cache keeps the CW_MEMO_SIZE most recently used results
+ *   - tail calls are looked up as well, a frame they replace stores the
+ *     result only under the first key it missed with
+ *
+ * The compiler checks the body as written, before anything is inlined: a
+ * pure function must not print or assign globals, only calls itself and
+ * functions declared pure before it and reads no globals but functions,
+ * literal let globals and let globals of earlier compiles that are no
+ * arrays. Natives are not pure. Pure functions are never inlined.
+ */
+#define CW_MEMO_SIZE        256
+#define CW_MEMO_KEY_MAX     256
+
+typedef struct
+{
+    cwString* key;
+    cwValue result;
+
+    /* neighbours in the order of use, -1 at the ends */
+    int prev;
+    int next;
+} cwMemoEntry;
+
+struct cwMemo
+{
+    cwString* name;
+
+    /* keys to the index of their entry */
+    Table keys;
+    cwMemoEntry entries[CW_MEMO_SIZE];
+    int count;
+
+    /* most and least recently used entry */
+    int head;
+    int tail;
+
+    size_t hits;
+    size_t misses;
+};
+
+/*
+ * looks up the call of function, which has a memo index, with the argc
+ * arguments on top of the stack. on a hit the callee's window is replaced
+ * by the result and true is returned. otherwise key receives the key to
+ * store the result under or NULL and memo the function's cache.
+ */
+bool cw_memo_lookup(cwRuntime* cw, cwFunction* function, int argc, cwMemo** memo, cwString** key);
+
+/* stores the result of a call that missed and takes the key */
+void cw_memo_store(cwMemo* memo, cwString* key, cwValue result);
+
+/* frees the key of a call that never returned */
+void cw_memo_discard(cwString* key);
+
+/* the cache of function if it was called since cw was created, NULL otherwise */
+const cwMemo* cw_memo_find(const cwRuntime* cw, const cwFunction* function);
+
+void cw_memo_free(cwRuntime* cw);
+
+#endif /* !CLOCKWORK_MEMO_H */
@@ -0,0 +1,366 @@
+#ifndef CLOCKWORK_OPS_H
+#define CLOCKWORK_OPS_H
+
+#include <stdio.h>
+
+#include "array.h"
+#include "common.h"
+#include "compiler.h"
+#include "debug.h"
+#include "memo.h"
+#include "runtime.h"
+
+/*
+ * Opcode semantics shared by cw_run and ahead-of-time compiled code. Every
+ * operation works on the VM stack of cw, the fallible ones report through
+ * cw_runtime_error and return false.
+ */
+
+/* arithmetic and comparisons involving arrays apply element-wise, everything else is a type error */
+static inline bool cw_op_fallback(cwRuntime* cw, uint8_t op, cwValue a, cwValue b, cwValue* result, const char* message)
+{
+    if (IS_ARRAY(a) || IS_ARRAY(b)) return cw_array_binary(cw, op, a, b, result);
+
+    /* cw_value_div refuses an int division by zero */
+    if (op == OP_DIVIDE && cw_is_number(a) && cw_is_number(b) && !IS_FLOAT(a) && !IS_FLOAT(b)) message = "Division by zero.";
+    cw_runtime_error(cw, message);
+    return false;
+}
+
+/* maps cw_value_sub, cw_value_mult and cw_value_div to their opcode */
+static inline uint8_t cw_arith_opcode(cwValue* (*op)(cwValue*, const cwValue*))
+{
+    return op == cw_value_sub ? OP_SUBTRACT : op == cw_value_mult ? OP_MULTIPLY : OP_DIVIDE;
+}
+
+/* --------------------------| globals |------------------------------------------------- */
+/* globals outlive a call from the host, borrowed strings are copied into the runtime */
+static inline cwValue cw_own_value(cwRuntime* cw, cwValue val)
+{
+    if (IS_STRING(val) && AS_STRING(val)->view)
+    {
+        return MAKE_OBJECT(cw_str_copy(cw, AS_RAWSTRING(val), AS_STRING(val)->len));
+    }
+    return val;
+}
+
+static inline void cw_op_def_global(cwRuntime* cw, cwString* name)
+{
+    cw_table_insert(&cw->globals, name, cw_own_value(cw, cw_peek_stack(cw, 0)));
+    cw_pop_stack(cw);
+}
+
+static inline bool cw_op_set_global(cwRuntime* cw, cwString* name)
+{
+    if (cw_table_insert(&cw->globals, name, cw_own_value(cw, cw_peek_stack(cw, 0))))
+    {
+        cw_table_remove(&cw->globals, name);
+        cw_runtime_error(cw, "Undefined variable '%s'.", name->raw);
+        return false;
+    }
+    return true;
+}
+
+static inline bool cw_op_get_global(cwRuntime* cw, cwString* name)
+{
+    cwValue* value = cw_table_find(&cw->globals, name);
+    if (!value)
+    {
+        cw_runtime_error(cw, "Undefined variable '%s'.", name->raw);
+        return false;
+    }
+    cw_push_stack(cw, *value);
+    return true;
+}
+
+/* --------------------------| in-place |------------------------------------------------ */
+/* applies an in-place opcode (local variant) to target, binary ones consume the stack top */
+static inline bool cw_inplace_update(cwRuntime* cw, cwValue* target, uint8_t op)
+{
+    if (op == OP_INC_LOCAL || op == OP_DEC_LOCAL)
+    {
+        int32_t step = (op == OP_INC_LOCAL) ? 1 : -1;
+        if (IS_INT(*target))        target->as.ival += step;
+        else if (IS_FLOAT(*target)) target->as.fval += step;
+        else
+        {
+            cw_runtime_error(cw, "Operand must be a number.");
+            return false;
+        }
+        return true;
+    }
+
+    cwValue* operand = &cw->stack[cw->stack_index - 1];
+    cwValue* result = NULL;
+    switch (op)
+    {
+    case OP_ADD_LOCAL:
+        if (IS_STRING(*target) && IS_STRING(*operand))
+        {
+            *target = MAKE_OBJECT(cw_str_concat(cw, AS_STRING(*target), AS_STRING(*operand)));
+            result = target;
+        }
+        else
+        {
+            result = cw_value_add(target, operand);
+        }
+        break;
+    case OP_SUB_LOCAL:  result = cw_value_sub(target, operand); break;
+    case OP_MULT_LOCAL: result = cw_value_mult(target, operand); break;
+    case OP_DIV_LOCAL:  result = cw_value_div(target, operand); break;
+    }
+
+    /* the binary opcodes follow OP_ADD in the same order */
+    if (!result && !cw_op_fallback(cw, OP_ADD + (op - OP_ADD_LOCAL) / 2, *target, *operand, target,
+                                   "Operands must be two numbers."))
+    {
+        return false;
+    }
+
+    cw_pop_stack(cw);
+    return true;
+}
+
+/* op is the global variant of an in-place opcode */
+static inline bool cw_op_inplace_global(cwRuntime* cw, cwString* name, uint8_t op)
+{
+    cwValue* value = cw_table_find(&cw->globals, name);
+    if (!value)
+    {
+        cw_runtime_error(cw, "Undefined variable '%s'.", name->raw);
+        return false;
+    }
+    return cw_inplace_update(cw, value, op - 1);
+}
+
+/* --------------------------| arithmetic |---------------------------------------------- */
+static inline void cw_op_equal(cwRuntime* cw, bool equal)
+{
+    cwValue b = cw_pop_stack(cw);
+    cwValue a = cw_pop_stack(cw);
+    bool eq = cw_values_equal(a, b);
+    cw_push_stack(cw, MAKE_BOOL((equal ? eq : !eq)));
+}
+
+/* op is one of OP_LT, OP_LTEQ, OP_GT or OP_GTEQ */
+static inline bool cw_op_compare(cwRuntime* cw, uint8_t op)
+{
+    if (!IS_NUMBER(cw_peek_stack(cw, 0)) || !IS_NUMBER(cw_peek_stack(cw, 1)))
+    {
+        cwValue* a = &cw->stack[cw->stack_index - 2];
+        if (!cw_op_fallback(cw, op, *a, a[1], a, "Operands must be numbers.")) return false;
+        cw_pop_stack(cw);
+        return true;
+    }
+
+    cwValue b = cw_pop_stack(cw);
+    cwValue a = cw_pop_stack(cw);
+    bool is_float = IS_FLOAT(a) || IS_FLOAT(b);
+    bool result = false;
+    switch (op)
+    {
+    case OP_LT:   result = is_float ? AS_FLOAT(a) <  AS_FLOAT(b) : AS_INT(a) <  AS_INT(b); break;
+    case OP_LTEQ: result = is_float ? AS_FLOAT(a) <= AS_FLOAT(b) : AS_INT(a) <= AS_INT(b); break;
+    case OP_GT:   result = is_float ? AS_FLOAT(a) >  AS_FLOAT(b) : AS_INT(a) >  AS_INT(b); break;
+    case OP_GTEQ: result = is_float ? AS_FLOAT(a) >= AS_FLOAT(b) : AS_INT(a) >= AS_INT(b); break;
+    }
+    cw_push_stack(cw, MAKE_BOOL(result));
+    return true;
+}
+
+static inline bool cw_op_add(cwRuntime* cw)
+{
+    if (IS_STRING(cw_peek_stack(cw, 0)) && IS_STRING(cw_peek_stack(cw, 1)))
+    {
+        cwString* b = AS_STRING(cw_pop_stack(cw));
+        cwString* a = AS_STRING(cw_pop_stack(cw));
+        cw_push_stack(cw, MAKE_OBJECT(cw_str_concat(cw, a, b)));
+        return true;
+    }
+
+    cwValue* a = &cw->stack[cw->stack_index - 2];
+    if (!cw_value_add(a, &a[1]) && !cw_op_fallback(cw, OP_ADD, *a, a[1], a, "Operands must be two numbers or two strings."))
+    {
+        return false;
+    }
+    cw_pop_stack(cw);
+    return true;
+}
+
+/* op is one of cw_value_sub, cw_value_mult or cw_value_div */
+static inline bool cw_op_arith(cwRuntime* cw, cwValue* (*op)(cwValue*, const cwValue*))
+{
+    cwValue* a = &cw->stack[cw->stack_index - 2];
+    if (!op(a, &a[1]) && !cw_op_fallback(cw, cw_arith_opcode(op), *a, a[1], a, "Operands must be two numbers."))
+    {
+        return false;
+    }
+    cw_pop_stack(cw);
+    return true;
+}
+
+static inline bool cw_op_negate(cwRuntime* cw)
+{
+    if (!IS_NUMBER(cw_peek_stack(cw, 0)))
+    {
+        cw_runtime_error(cw, "Operand must be a number.");
+        return false;
+    }
+
+    cwValue val = cw_pop_stack(cw);
+    if (IS_FLOAT(val)) cw_push_stack(cw, MAKE_FLOAT(-AS_FLOAT(val)));
+    else               cw_push_stack(cw, MAKE_INT(-AS_INT(val)));
+    return true;
+}
+
+/* --------------------------| typed |--------------------------------------------------- */
+/* op is one of OP_EQ_INT ... OP_DIV_FLOAT, the compiler proved the operands fit it (see typing.h) */
+static inline bool cw_op_typed(cwRuntime* cw, uint8_t op)
+{
+    cwValue* a = &cw->stack[cw->stack_index - 2];
+    cwValue b = a[1];
+    cw->stack_index--;
+
+    switch (op)
+    {
+    case OP_EQ_INT:     *a = MAKE_BOOL(a->as.ival == b.as.ival); break;
+    case OP_NOTEQ_INT:  *a = MAKE_BOOL(a->as.ival != b.as.ival); break;
+    case OP_LT_INT:     *a = MAKE_BOOL(a->as.ival <  b.as.ival); break;
+    case OP_LTEQ_INT:   *a = MAKE_BOOL(a->as.ival <= b.as.ival); break;
+    case OP_GT_INT:     *a = MAKE_BOOL(a->as.ival >  b.as.ival); break;
+    case OP_GTEQ_INT:   *a = MAKE_BOOL(a->as.ival >= b.as.ival); break;
+    case OP_ADD_INT:    a->as.ival += b.as.ival; break;
+    case OP_SUB_INT:    a->as.ival -= b.as.ival; break;
+    case OP_MULT_INT:   a->as.ival *= b.as.ival; break;
+    case OP_DIV_INT:
+        if (b.as.ival == 0)
+        {
+            cw_runtime_error(cw, "Division by zero.");
+            return false;
+        }
+        a->as.ival = cw_int_div(a->as.ival, b.as.ival);
+        break;
+
+    /* one of the two is a float, the other one may be an int */
+    case OP_LT_FLOAT:   *a = MAKE_BOOL(AS_FLOAT(*a) <  AS_FLOAT(b)); break;
+    case OP_LTEQ_FLOAT: *a = MAKE_BOOL(AS_FLOAT(*a) <= AS_FLOAT(b)); break;
+    case OP_GT_FLOAT:   *a = MAKE_BOOL(AS_FLOAT(*a) >  AS_FLOAT(b)); break;
+    case OP_GTEQ_FLOAT: *a = MAKE_BOOL(AS_FLOAT(*a) >= AS_FLOAT(b)); break;
+    case OP_ADD_FLOAT:  *a = MAKE_FLOAT(AS_FLOAT(*a) + AS_FLOAT(b)); break;
+    case OP_SUB_FLOAT:  *a = MAKE_FLOAT(AS_FLOAT(*a) - AS_FLOAT(b)); break;
+    case OP_MULT_FLOAT: *a = MAKE_FLOAT(AS_FLOAT(*a) * AS_FLOAT(b)); break;
+    case OP_DIV_FLOAT:  *a = MAKE_FLOAT(AS_FLOAT(*a) / AS_FLOAT(b)); break;
+    }
+    return true;
+}
+
+/* --------------------------| registers |----------------------------------------------- */
+/* compares a and b with the comparison of a register opcode (OP_R_EQ ... OP_R_GTEQ) */
+static inline bool cw_register_compare(cwRuntime* cw, uint8_t op, cwValue a, cwValue b, bool* result)
+{
+    if (op == OP_R_EQ || op == OP_R_NOTEQ)
+    {
+        *result = cw_values_equal(a, b) == (op == OP_R_EQ);
+        return true;
+    }
+
+    if (!IS_NUMBER(a) || !IS_NUMBER(b))
+    {
+        cw_runtime_error(cw, "Operands must be numbers.");
+        return false;
+    }
+
+    bool is_float = IS_FLOAT(a) || IS_FLOAT(b);
+    switch (op)
+    {
+    case OP_R_LT:   *result = is_float ? AS_FLOAT(a) <  AS_FLOAT(b) : AS_INT(a) <  AS_INT(b); break;
+    case OP_R_LTEQ: *result = is_float ? AS_FLOAT(a) <= AS_FLOAT(b) : AS_INT(a) <= AS_INT(b); break;
+    case OP_R_GT:   *result = is_float ? AS_FLOAT(a) >  AS_FLOAT(b) : AS_INT(a) >  AS_INT(b); break;
+    case OP_R_GTEQ: *result = is_float ? AS_FLOAT(a) >= AS_FLOAT(b) : AS_INT(a) >= AS_INT(b); break;
+    }
+    return true;
+}
+
+static inline bool cw_op_register_add(cwRuntime* cw, cwValue* dst, cwValue a, cwValue b)
+{
+    if (IS_STRING(a) && IS_STRING(b))
+    {
+        *dst = MAKE_OBJECT(cw_str_concat(cw, AS_STRING(a), AS_STRING(b)));
+        return true;
+    }
+
+    if (!cw_value_add(&a, &b)) return cw_op_fallback(cw, OP_ADD, a, b, dst, "Operands must be two numbers or two strings.");
+    *dst = a;
+    return true;
+}
+
+static inline bool cw_op_register_arith(cwRuntime* cw, cwValue* (*op)(cwValue*, const cwValue*), cwValue* dst, cwValue a, cwValue b)
+{
+    if (!op(&a, &b)) return cw_op_fallback(cw, cw_arith_opcode(op), a, b, dst, "Operands must be two numbers.");
+    *dst = a;
+    return true;
+}
+
+/* register comparisons storing their result, arrays compare to a mask */
+static inline bool cw_op_register_compare(cwRuntime* cw, uint8_t op, cwValue* dst, cwValue a, cwValue b)
+{
+    if ((IS_ARRAY(a) || IS_ARRAY(b)) && op != OP_R_EQ && op != OP_R_NOTEQ)
+    {
+        return cw_array_binary(cw, OP_LT + (op - OP_R_LT), a, b, dst);
+    }
+
+    bool result;
+    if (!cw_register_compare(cw, op, a, b, &result)) return false;
+    *dst = MAKE_BOOL(result);
+    return true;
+}
+
+/* --------------------------| calls |--------------------------------------------------- */
+/* calls native on the argc values on top of the stack, its result replaces the callee's window */
+static inline bool cw_call_native(cwRuntime* cw, cwNative* native, int argc)
+{
+    if (native->arity >= 0 && argc != native->arity)
+    {
+        cw_runtime_error(cw, "Expected %d arguments but got %d.", native->arity, argc);
+        return false;
+    }
+
+    cwValue* args = cw->stack + cw->stack_index - argc;
+    if (!native->function(cw, args, argc, args - 1)) return false;
+    cw->stack_index = args - cw->stack;
+    return true;
+}
+
+/* calls the value below the argc arguments on top of the stack and runs it to completion */
+static inline bool cw_op_call(cwRuntime* cw, int argc)
+{
+    cwValue callee = cw_peek_stack(cw, argc);
+    if (IS_NATIVE(callee)) return cw_call_native(cw, AS_NATIVE(callee), argc);
+
+    /* pure callees answered from their cache push no frame */
+    int depth = cw->frame_count;
+    if (!cw_call_value(cw, callee, argc)) return false;
+    return cw->frame_count == depth || cw_run_frame(cw) == INTERPRET_OK;
+}
+
+/* --------------------------| statements |---------------------------------------------- */
+static inline void cw_op_print(cwRuntime* cw)
+{
+    cw_output_value(&cw->output, cw_pop_stack(cw));
+    cw_output_write(&cw->output, "\n", 1);
+#ifdef DEBUG_TRACE_EXECUTION
+    cw_output_flush(&cw->output);   /* keeps the trace in order */
+#endif
+}
+
+/* pops the innermost frame, the callee's window is replaced by its result */
+static inline void cw_op_return(cwRuntime* cw)
+{
+    cwValue result = cw_pop_stack(cw);
+    cwCallFrame* frame = &cw->frames[--cw->frame_count];
+    if (frame->memo_key) cw_memo_store(frame->memo, frame->memo_key, result);
+    cw->stack_index = frame->slots - cw->stack;
+    cw_push_stack(cw, result);
+}
+
+#endif /* !CLOCKWORK_OPS_H */
@@ -0,0 +1,1030 @@
+#include "optimize.h"
+
+#include <string.h>
+
+#include "compiler.h"
+#include "memory.h"
+#include "register.h"
+#include "runtime.h"
+
+/* what is known about the value in a slot, from most to least precise */
+typedef enum
+{
+    FACT_CONSTANT,
+    FACT_NUMBER,        /* int, float or bool, never an array */
+    FACT_ANY
+} cwIrFactKind;
+
+typedef struct
+{
+    cwIrFactKind kind;
+    cwValue value;      /* for FACT_CONSTANT */
+} cwIrFact;
+
+typedef struct
+{
+    uint8_t op;         /* behind a wide prefix */
+    int arg;            /* slot, constant or count, the target offset of a jump */
+    int offset;
+    int length;
+    int line;
+    int pops;           /* values it takes off the stack and puts on it */
+    int pushes;
+    int depth;          /* stack height in front of it, -1 if never reached */
+    bool targeted;
+
+    /* the tree computing the value it pushes starts at instruction first, -1 unless contiguous */
+    int first;
+    bool pure;          /* the tree has no side effects */
+    bool safe;          /* the tree can not fail either */
+
+    /* a removed instruction is dropped, a replaced one stands for its whole tree */
+    bool removed;
+    bool replaced;
+    uint8_t new_op;
+    int new_arg;
+} cwIrInst;
+
+typedef struct
+{
+    int first;
+    int last;
+    int depth;          /* stack height on entry, -1 if never reached */
+    int succ[2];
+    int succ_count;
+    cwIrFact* in;       /* facts about the slots on entry */
+} cwIrBlock;
+
+typedef struct
+{
+    int number;         /* equal numbers hold equal values */
+    int inst;           /* instruction that pushed it in the current block, -1 otherwise */
+    cwIrFact fact;
+} cwIrEntry;
+
+/* an expression and its value number, valid for the block walked in its generation */
+typedef struct
+{
+    uint32_t generation;
+    uint8_t op;
+    int a;
+    int b;
+    uintptr_t extra;
+    int number;
+} cwIrKey;
+
+typedef struct
+{
+    cwFunction* function;
+    cwChunk* chunk;
+    const Table* immutables;    /* let globals, they only change when they are defined */
+
+    cwIrInst* insts;
+    int count;
+    int len;            /* of the code as lifted */
+    int* index;         /* instruction starting at a code offset */
+    cwIrBlock* blocks;
+    int block_count;
+    int max_depth;
+
+    /* walking a block */
+    cwIrEntry* stack;
+    int depth;
+    int* holders;       /* lowest slot known to hold a value number */
+    int holder_cap;
+    int numbers;
+    cwIrKey* keys;
+    int key_cap;
+    uint32_t generation;
+    int globals_epoch;  /* bumped by everything that may write a global */
+    int defs_epoch;     /* bumped by definitions of globals */
+    int memory_epoch;   /* bumped by everything that may write an array element */
+} cwIr;
+
+/* --------------------------| instructions |------------------------------------------- */
+static bool cw_ir_is_register(uint8_t op)
+{
+    return op >= OP_R_MOVE && op <= OP_R_BRANCH;
+}
+
+static void cw_ir_lift(cwIr* ir)
+{
+    cwChunk* chunk = ir->chunk;
+    const uint8_t* bytes = chunk->bytes;
+    int len = ir->len = (int)chunk->len;
+
+    ir->count = 0;
+    for (int at = 0; at < len; at += cw_op_length(bytes + at)) ir->count++;
+
+    ir->insts = CW_ALLOCATE(cwIrInst, ir->count);
+    ir->index = CW_ALLOCATE(int, len + 1);
+    int i = 0;
+    for (int at = 0; at < len; at += cw_op_length(bytes + at), ++i)
+    {
+        bool wide = bytes[at] == OP_WIDE;
+        cwIrInst* inst = &ir->insts[i];
+        memset(inst, 0, sizeof(cwIrInst));
+        inst->op = bytes[at + wide];
+        inst->offset = at;
+        inst->length = cw_op_length(bytes + at);
+        inst->line = chunk->lines[at];
+        cw_stack_effect(bytes + at, &inst->pops, &inst->pushes);
+        inst->depth = -1;
+        inst->first = -1;
+
+        if (cw_is_jump(inst->op))                               inst->arg = cw_jump_target(bytes, at);
+        else if (wide)                                          inst->arg = (bytes[at + 2] << 8) | bytes[at + 3];
+        else if (inst->length > 1 && !cw_ir_is_register(inst->op)) inst->arg = bytes[at + 1];
+        ir->index[at] = i;
+    }
+    ir->index[len] = ir->count;
+
+    for (i = 0; i < ir->count; ++i)
+    {
+        if (cw_is_jump(ir->insts[i].op)) ir->insts[ir->index[ir->insts[i].arg]].targeted = true;
+    }
+}
+
+/* the basic blocks by instruction and the stack heights in front of every reached instruction, false if they do not add up */
+static bool cw_ir_blocks(cwIr* ir)
+{
+    const uint8_t* bytes = ir->chunk->bytes;
+    cwBasicBlock* blocks = CW_ALLOCATE(cwBasicBlock, ir->len);
+    int* block_of = CW_ALLOCATE(int, ir->len + 1);
+    ir->block_count = cw_basic_blocks(bytes, ir->len, NULL, NULL, blocks, block_of);
+
+    int* depths = CW_ALLOCATE(int, ir->block_count);
+    ir->max_depth = cw_block_depths(bytes, blocks, ir->block_count, ir->function->arity + 1, depths);
+
+    ir->blocks = CW_ALLOCATE(cwIrBlock, ir->count);
+    for (int b = 0; b < ir->block_count; ++b)
+    {
+        cwIrBlock* block = &ir->blocks[b];
+        block->first = ir->index[blocks[b].first];
+        block->last = ir->index[blocks[b].last];
+        block->depth = ir->max_depth >= 0 ? depths[b] : -1;
+        block->succ_count = blocks[b].succ_count;
+        for (int s = 0; s < block->succ_count; ++s) block->succ[s] = blocks[b].succ[s];
+        block->in = NULL;
+
+        int depth = block->depth;
+        for (int i = block->first; i <= block->last && depth >= 0; ++i)
+        {
+            ir->insts[i].depth = depth;
+            depth += ir->insts[i].pushes - ir->insts[i].pops;
+        }
+    }
+
+    CW_FREE_ARRAY(cwBasicBlock, blocks, ir->len);
+    CW_FREE_ARRAY(int, block_of, ir->len + 1);
+    CW_FREE_ARRAY(int, depths, ir->block_count);
+    return ir->max_depth >= 0;
+}
+
+/* --------------------------| constants |---------------------------------------------- */
+/* index of value in the constants of the chunk, -1 if it does not fit */
+static int cw_ir_constant(cwChunk* chunk, cwValue value)
+{
+    for (size_t i = 0; i < chunk->const_len; ++i)
+    {
+        if (cw_same_constant(chunk->constants[i], value)) return (int)i;
+    }
+
+    if (chunk->const_len > UINT8_MAX) return -1;
+    if (chunk->const_cap < chunk->const_len + 1)
+    {
+        size_t old_cap = chunk->const_cap;
+        chunk->const_cap = CW_GROW_CAPACITY(old_cap);
+        chunk->constants = CW_GROW_ARRAY(cwValue, chunk->constants, old_cap, chunk->const_cap);
+    }
+    chunk->constants[chunk->const_len] = value;
+    return (int)chunk->const_len++;
+}
+
+/* the value of a binary operation on constants, false if it is left to the runtime */
+static bool cw_ir_fold(uint8_t op, cwValue a, cwValue b, cwValue* result)
+{
+    if (op == OP_EQ || op == OP_NOTEQ)
+    {
+        *result = MAKE_BOOL(cw_values_equal(a, b) == (op == OP_EQ));
+        return true;
+    }
+    if (!cw_is_number(a) || !cw_is_number(b)) return false;
+
+    bool is_float = IS_FLOAT(a) || IS_FLOAT(b);
+    *result = a;
+    switch (op)
+    {
+    case OP_LT:       *result = MAKE_BOOL(is_float ? AS_FLOAT(a) <  AS_FLOAT(b) : AS_INT(a) <  AS_INT(b)); return true;
+    case OP_LTEQ:     *result = MAKE_BOOL(is_float ? AS_FLOAT(a) <= AS_FLOAT(b) : AS_INT(a) <= AS_INT(b)); return true;
+    case OP_GT:       *result = MAKE_BOOL(is_float ? AS_FLOAT(a) >  AS_FLOAT(b) : AS_INT(a) >  AS_INT(b)); return true;
+    case OP_GTEQ:     *result = MAKE_BOOL(is_float ? AS_FLOAT(a) >= AS_FLOAT(b) : AS_INT(a) >= AS_INT(b)); return true;
+    case OP_ADD:      return cw_value_add(result, &b) != NULL;
+    case OP_SUBTRACT: return cw_value_sub(result, &b) != NULL;
+    case OP_MULTIPLY: return cw_value_mult(result, &b) != NULL;
+    case OP_DIVIDE:
+        /* integer division by zero is reported at runtime, INT32_MIN / -1 wraps there */
+        if (!is_float && (AS_INT(b) == 0 || (AS_INT(a) == INT32_MIN && AS_INT(b) == -1))) return false;
+        return cw_value_div(result, &b) != NULL;
+    default:
+        return false;
+    }
+}
+
+/* --------------------------| facts |-------------------------------------------------- */
+static cwIrFact cw_ir_fact(cwIrFactKind kind)
+{
+    return (cwIrFact){ .kind = kind, .value = MAKE_NULL() };
+}
+
+static cwIrFact cw_ir_constant_fact(cwValue value)
+{
+    return (cwIrFact){ .kind = FACT_CONSTANT, .value = value };
+}
+
+static bool cw_ir_numeric(const cwIrFact* fact)
+{
+    return fact->kind == FACT_NUMBER || (fact->kind == FACT_CONSTANT && cw_is_number(fact->value));
+}
+
+/* combines what is known on two paths into into, returns whether it changed */
+static bool cw_ir_meet(cwIrFact* into, const cwIrFact* fact)
+{
+    if (into->kind == FACT_ANY) return false;
+    if (into->kind == FACT_CONSTANT && fact->kind == FACT_CONSTANT && cw_same_constant(into->value, fact->value)) return false;
+
+    cwIrFactKind kind = cw_ir_numeric(into) && cw_ir_numeric(fact) ? FACT_NUMBER : FACT_ANY;
+    if (kind == into->kind) return false;
+
+    *into = cw_ir_fact(kind);
+    return true;
+}
+
+static cwIrFact cw_ir_binary_fact(uint8_t op, const cwIrFact* a, const cwIrFact* b)
+{
+    cwValue result;
+    if (a->kind == FACT_CONSTANT && b->kind == FACT_CONSTANT && cw_ir_fold(op, a->value, b->value, &result))
+        return cw_ir_constant_fact(result);
+
+    /* comparisons of arrays give arrays, equality is always a bool */
+    if (op == OP_EQ || op == OP_NOTEQ) return cw_ir_fact(FACT_NUMBER);
+    return cw_ir_fact(cw_ir_numeric(a) && cw_ir_numeric(b) ? FACT_NUMBER : FACT_ANY);
+}
+
+static cwIrFact cw_ir_unary_fact(uint8_t op, const cwIrFact* a)
+{
+    if (a->kind != FACT_CONSTANT) return cw_ir_fact(FACT_NUMBER);
+    if (op == OP_NOT) return cw_ir_constant_fact(MAKE_BOOL(cw_is_falsey(a->value)));
+    if (!cw_is_number(a->value)) return cw_ir_fact(FACT_NUMBER);
+
+    cwValue value = a->value;
+    return cw_ir_constant_fact(IS_FLOAT(value) ? MAKE_FLOAT(-AS_FLOAT(value)) : MAKE_INT(-AS_INT(value)));
+}
+
+/* --------------------------| value numbers |------------------------------------------ */
+static int cw_ir_fresh(cwIr* ir)
+{
+    if (ir->numbers == ir->holder_cap)
+    {
+        int old_cap = ir->holder_cap;
+        ir->holder_cap = CW_GROW_CAPACITY(old_cap);
+        ir->holders = CW_GROW_ARRAY(int, ir->holders, old_cap, ir->holder_cap);
+    }
+    ir->holders[ir->numbers] = -1;
+    return ir->numbers++;
+}
+
+/* entry of an expression in the current block, a new one has number -1 */
+static cwIrKey* cw_ir_key(cwIr* ir, uint8_t op, int a, int b, uintptr_t extra)
+{
+    uint32_t hash = (uint32_t)op * 31u + (uint32_t)a * 2654435761u + (uint32_t)b * 40503u;
+    hash ^= (uint32_t)(extra ^ (extra >> 16)) * 97u;
+
+    uint32_t mask = (uint32_t)ir->key_cap - 1;
+    for (uint32_t i = hash & mask; ; i = (i + 1) & mask)
+    {
+        cwIrKey* key = &ir->keys[i];
+        if (key->generation != ir->generation)
+        {
+            *key = (cwIrKey){ ir->generation, op, a, b, extra, -1 };
+            return key;
+        }
+        if (key->op == op && key->a == a && key->b == b && key->extra == extra) return key;
+    }
+}
+
+/* value number of an expression, found tells if the block already computed it */
+static int cw_ir_number(cwIr* ir, uint8_t op, int a, int b, uintptr_t extra, bool* found)
+{
+    cwIrKey* key = cw_ir_key(ir, op, a, b, extra);
+    *found = key->number >= 0;
+    if (!*found) key->number = cw_ir_fresh(ir);
+    return key->number;
+}
+
+static int cw_ir_constant_number(cwIr* ir, cwValue value)
+{
+    bool found;
+    uintptr_t bits = value.type == VAL_OBJECT ? (uintptr_t)AS_OBJECT(value) : (uintptr_t)(uint32_t)value.as.ival;
+    return cw_ir_number(ir, OP_CONSTANT, (int)value.type, 0, value.type == VAL_NULL ? 0 : bits, &found);
+}
+
+static int cw_ir_fact_number(cwIr* ir, const cwIrFact* fact)
+{
+    return fact->kind == FACT_CONSTANT ? cw_ir_constant_number(ir, fact->value) : cw_ir_fresh(ir);
+}
+
+/* --------------------------| stack |-------------------------------------------------- */
+static bool cw_ir_holds(const cwIr* ir, int slot, int number)
+{
+    return slot >= 0 && slot < ir->depth && ir->stack[slot].number == number;
+}
+
+static void cw_ir_hold(cwIr* ir, int number, int slot)
+{
+    int holder = ir->holders[number];
+    if (!cw_ir_holds(ir, holder, number) || holder > slot) ir->holders[number] = slot;
+}
+
+static void cw_ir_release(cwIr* ir, int slot)
+{
+    int number = ir->stack[slot].number;
+    if (ir->holders[number] == slot) ir->holders[number] = -1;
+}
+
+static void cw_ir_push(cwIr* ir, int inst, int number, cwIrFact fact)
+{
+    ir->stack[ir->depth] = (cwIrEntry){ number, inst, fact };
+    cw_ir_hold(ir, number, ir->depth);
+    ir->depth++;
+}
+
+static cwIrEntry cw_ir_pop(cwIr* ir)
+{
+    cw_ir_release(ir, ir->depth - 1);
+    return ir->stack[--ir->depth];
+}
+
+/* overwrites the slot of a local */
+static void cw_ir_store(cwIr* ir, int slot, int number, cwIrFact fact)
+{
+    cw_ir_release(ir, slot);
+    ir->stack[slot] = (cwIrEntry){ number, -1, fact };
+    cw_ir_hold(ir, number, slot);
+}
+
+/* --------------------------| trees |-------------------------------------------------- */
+/* the tree of instruction i is contiguous if its operands were pushed right in front of it */
+static void cw_ir_tree(cwIr* ir, int i, const cwIrEntry* operands, int count, bool pure, bool safe)
+{
+    cwIrInst* inst = &ir->insts[i];
+    inst->pure = pure;
+    inst->safe = safe;
+    inst->first = i;
+    for (int k = count - 1; k >= 0; --k)
+    {
+        int producer = operands[k].inst;
+        if (producer < 0 || producer != inst->first - 1 || ir->insts[producer].first < 0)
+        {
+            inst->first = -1;
+            inst->pure = inst->safe = false;
+            return;
+        }
+
+        inst->pure &= ir->insts[producer].pure;
+        inst->safe &= ir->insts[producer].safe;
+        inst->first = ir->insts[producer].first;
+    }
+}
+
+static int cw_ir_encoded_length(uint8_t op, int arg)
+{
+    if (op == OP_NULL || op == OP_TRUE || op == OP_FALSE) return 1;
+    return arg > UINT8_MAX ? 4 : 2;
+}
+
+/* whether the tree of instruction i can make way for length bytes of code */
+static bool cw_ir_replaceable(const cwIr* ir, int i, int length)
+{
+    const cwIrInst* inst = &ir->insts[i];
+    if (inst->first < 0 || !inst->pure) return false;
+    if (length > inst->offset + inst->length - ir->insts[inst->first].offset) return false;
+
+    for (int k = inst->first + 1; k <= i; ++k)
+    {
+        if (ir->insts[k].targeted) return false;
+    }
+    return true;
+}
+
+static void cw_ir_replace(cwIr* ir, int i, uint8_t op, int arg)
+{
+    cwIrInst* inst = &ir->insts[i];
+    for (int k = inst->first; k < i; ++k) ir->insts[k].removed = true;
+    inst->replaced = true;
+    inst->new_op = op;
+    inst->new_arg = arg;
+    inst->safe = true;
+}
+
+/* replaces the tree of instruction i by a push of its constant value */
+static bool cw_ir_materialize(cwIr* ir, int i, cwValue value)
+{
+    cwIrInst* inst = &ir->insts[i];
+    bool literal = inst->op == OP_CONSTANT || inst->op == OP_NULL || inst->op == OP_TRUE || inst->op == OP_FALSE;
+    if (literal && inst->first == i) return false;
+
+    uint8_t op = OP_CONSTANT;
+    int arg = 0;
+    if (IS_NULL(value))      op = OP_NULL;
+    else if (IS_BOOL(value)) op = AS_BOOL(value) ? OP_TRUE : OP_FALSE;
+
+    if (!cw_ir_replaceable(ir, i, cw_ir_encoded_length(op, 0))) return false;
+    if (op == OP_CONSTANT && (arg = cw_ir_constant(ir->chunk, value)) < 0) return false;
+
+    cw_ir_replace(ir, i, op, arg);
+    return true;
+}
+
+/* replaces the tree of instruction i by a read of a slot below limit that holds the same value */
+static void cw_ir_reuse(cwIr* ir, int i, int number, int limit)
+{
+    int holder = ir->holders[number];
+    if (!cw_ir_holds(ir, holder, number) || holder >= limit) return;
+    if (cw_ir_replaceable(ir, i, cw_ir_encoded_length(OP_GET_LOCAL, holder))) cw_ir_replace(ir, i, OP_GET_LOCAL, holder);
+}
+
+/* folds the value of instruction i or computes it from a slot that already holds it */
+static void cw_ir_rewrite(cwIr* ir, int i, int number, const cwIrFact* fact, bool found, int limit)
+{
+    if (fact->kind == FACT_CONSTANT && cw_ir_materialize(ir, i, fact->value)) return;
+    if (found) cw_ir_reuse(ir, i, number, limit);
+}
+
+/* --------------------------| walking blocks |----------------------------------------- */
+static uintptr_t cw_ir_name(const cwIr* ir, const cwIrInst* inst)
+{
+    return (uintptr_t)AS_OBJECT(ir->chunk->constants[inst->arg]);
+}
+
+static cwValue cw_ir_literal(const cwIr* ir, const cwIrInst* inst)
+{
+    switch (inst->op)
+    {
+    case OP_CONSTANT: return ir->chunk->constants[inst->arg];
+    case OP_TRUE:     return MAKE_BOOL(true);
+    case OP_FALSE:    return MAKE_BOOL(false);
+    default:          return MAKE_NULL();
+    }
+}
+
+/* the commutative operations number their operands in order */
+static bool cw_ir_commutes(uint8_t op)
+{
+    return op == OP_EQ || op == OP_NOTEQ || op == OP_ADD || op == OP_MULTIPLY;
+}
+
+static void cw_ir_binary(cwIr* ir, int i, bool rewrite)
+{
+    uint8_t op = ir->insts[i].op;
+    cwIrEntry operands[2];
+    operands[1] = cw_ir_pop(ir);
+    operands[0] = cw_ir_pop(ir);
+
+    /* only numbers are known to never make arrays, which must not be shared */
+    bool numeric = cw_ir_numeric(&operands[0].fact) && cw_ir_numeric(&operands[1].fact);
+    bool equality = op == OP_EQ || op == OP_NOTEQ;
+    cwIrFact fact = cw_ir_binary_fact(op, &operands[0].fact, &operands[1].fact);
+    cw_ir_tree(ir, i, operands, 2, true, equality || (numeric && op != OP_DIVIDE));
+
+    int a = operands[0].number;
+    int b = operands[1].number;
+    if (cw_ir_commutes(op) && a > b)
+    {
+        a = operands[1].number;
+        b = operands[0].number;
+    }
+
+    bool found = false;
+    int number;
+    if (fact.kind == FACT_CONSTANT)    number = cw_ir_constant_number(ir, fact.value);
+    else if (numeric || equality)      number = cw_ir_number(ir, op, a, b, 0, &found);
+    else                               number = cw_ir_fresh(ir);
+
+    if (rewrite) cw_ir_rewrite(ir, i, number, &fact, found, ir->depth);
+    cw_ir_push(ir, i, number, fact);
+}
+
+static void cw_ir_unary(cwIr* ir, int i, bool rewrite)
+{
+    uint8_t op = ir->insts[i].op;
+    cwIrEntry operand = cw_ir_pop(ir);
+
+    cwIrFact fact = cw_ir_unary_fact(op, &operand.fact);
+    cw_ir_tree(ir, i, &operand, 1, true, op == OP_NOT || cw_ir_numeric(&operand.fact));
+
+    bool found = false;
+    int number = fact.kind == FACT_CONSTANT ? cw_ir_constant_number(ir, fact.value)
+                                            : cw_ir_number(ir, op, operand.number, 0, 0, &found);
+
+    if (rewrite) cw_ir_rewrite(ir, i, number, &fact, found, ir->depth);
+    cw_ir_push(ir, i, number, fact);
+}
+
+/* in-place update of a local, the binary ones consume the stack top */
+static void cw_ir_inplace(cwIr* ir, int i)
+{
+    const cwIrInst* inst = &ir->insts[i];
+    cwIrFact target = ir->stack[inst->arg].fact;
+    cwIrFact fact = cw_ir_fact(cw_ir_numeric(&target) ? FACT_NUMBER : FACT_ANY);
+
+    if (inst->op == OP_INC_LOCAL || inst->op == OP_DEC_LOCAL)
+    {
+        cwValue value = target.value;
+        if (target.kind == FACT_CONSTANT && (IS_INT(value) || IS_FLOAT(value)))
+        {
+            int32_t step = inst->op == OP_INC_LOCAL ? 1 : -1;
+            fact = cw_ir_constant_fact(IS_INT(value) ? MAKE_INT((int32_t)((uint32_t)value.as.ival + (uint32_t)step))
+                                                     : MAKE_FLOAT(value.as.fval + step));
+        }
+    }
+    else
+    {
+        /* the binary opcodes follow OP_ADD in the same order */
+        cwIrEntry operand = cw_ir_pop(ir);
+        fact = cw_ir_binary_fact(OP_ADD + (inst->op - OP_ADD_LOCAL) / 2, &target, &operand.fact);
+    }
+
+    cw_ir_store(ir, inst->arg, cw_ir_fact_number(ir, &fact), fact);
+}
+
+/* a register instruction writes its destination slot, which is left unknown */
+static void cw_ir_register(cwIr* ir, int i)
+{
+    const cwIrInst* inst = &ir->insts[i];
+    if (inst->op == OP_R_BRANCH) return;
+
+    int dst = ir->chunk->bytes[inst->offset + 2];
+    cw_ir_store(ir, dst, cw_ir_fresh(ir), cw_ir_fact(FACT_ANY));
+}
+
+/* a value with side effects, it is never reused */
+static void cw_ir_opaque(cwIr* ir, int i, int count)
+{
+    for (int k = 0; k < count; ++k) cw_ir_pop(ir);
+
+    cwIrInst* inst = &ir->insts[i];
+    inst->first = -1;
+    inst->pure = inst->safe = false;
+    cw_ir_push(ir, i, cw_ir_fresh(ir), cw_ir_fact(FACT_ANY));
+}
+
+static void cw_ir_walk(cwIr* ir, int b, bool rewrite)
+{
+    const cwIrBlock* block = &ir->blocks[b];
+
+    ir->generation++;
+    ir->numbers = 0;
+    ir->depth = 0;
+    for (int s = 0; s < block->depth; ++s) cw_ir_push(ir, -1, cw_ir_fact_number(ir, &block->in[s]), block->in[s]);
+
+    for (int i = block->first; i <= block->last; ++i)
+    {
+        cwIrInst* inst = &ir->insts[i];
+        bool found = false;
+        switch (inst->op)
+        {
+        case OP_CONSTANT: case OP_NULL: case OP_TRUE: case OP_FALSE:
+        {
+            cwValue value = cw_ir_literal(ir, inst);
+            cw_ir_tree(ir, i, NULL, 0, true, true);
+            cw_ir_push(ir, i, cw_ir_constant_number(ir, value), cw_ir_constant_fact(value));
+            break;
+        }
+        case OP_POP:
+        case OP_PRINT:
+        case OP_RETURN:
+            cw_ir_pop(ir);
+            break;
+        case OP_GET_LOCAL:
+        {
+            /* the slot keeps its number, a read is a copy */
+            cwIrEntry slot = ir->stack[inst->arg];
+            cw_ir_tree(ir, i, NULL, 0, true, true);
+            if (rewrite) cw_ir_rewrite(ir, i, slot.number, &slot.fact, true, inst->arg);
+            cw_ir_push(ir, i, slot.number, slot.fact);
+            break;
+        }
+        case OP_SET_LOCAL:
+        {
+            cwIrEntry value = cw_ir_pop(ir);
+            cw_ir_store(ir, inst->arg, value.number, value.fact);
+            cw_ir_tree(ir, i, &value, 1, false, false);
+            cw_ir_push(ir, i, value.number, value.fact);
+            break;
+        }
+        case OP_DEF_GLOBAL:
+            cw_ir_pop(ir);
+            ir->globals_epoch++;
+            ir->defs_epoch++;
+            break;
+        case OP_SET_GLOBAL:
+        {
+            /* the stored value is what the global reads until the next write */
+            cwIrEntry value = cw_ir_pop(ir);
+            ir->globals_epoch++;
+            cw_ir_key(ir, OP_GET_GLOBAL, ir->globals_epoch, 0, cw_ir_name(ir, inst))->number = value.number;
+            cw_ir_tree(ir, i, &value, 1, false, false);
+            cw_ir_push(ir, i, value.number, value.fact);
+            break;
+        }
+        case OP_GET_GLOBAL:
+        {
+            bool immutable = cw_table_find(ir->immutables, AS_STRING(ir->chunk->constants[inst->arg])) != NULL;
+            int epoch = immutable ? ir->defs_epoch : ir->globals_epoch;
+            int number = cw_ir_number(ir, OP_GET_GLOBAL, epoch, immutable, cw_ir_name(ir, inst), &found);
+            cwIrFact fact = cw_ir_fact(FACT_ANY);
+            cw_ir_tree(ir, i, NULL, 0, true, false);
+            if (rewrite) cw_ir_rewrite(ir, i, number, &fact, found, ir->depth);
+            cw_ir_push(ir, i, number, fact);
+            break;
+        }
+        case OP_INC_LOCAL:  case OP_DEC_LOCAL:
+        case OP_ADD_LOCAL:  case OP_SUB_LOCAL:
+        case OP_MULT_LOCAL: case OP_DIV_LOCAL:
+            cw_ir_inplace(ir, i);
+            break;
+        case OP_ADD_GLOBAL:  case OP_SUB_GLOBAL:
+        case OP_MULT_GLOBAL: case OP_DIV_GLOBAL:
+            cw_ir_pop(ir);
+            /* fall through */
+        case OP_INC_GLOBAL: case OP_DEC_GLOBAL:
+            ir->globals_epoch++;
+            break;
+        case OP_EQ: case OP_NOTEQ:
+        case OP_LT: case OP_LTEQ:
+        case OP_GT: case OP_GTEQ:
+        case OP_ADD: case OP_SUBTRACT:
+        case OP_MULTIPLY: case OP_DIVIDE:
+            cw_ir_binary(ir, i, rewrite);
+            break;
+        case OP_NEGATE:
+        case OP_NOT:
+            cw_ir_unary(ir, i, rewrite);
+            break;
+        case OP_GET_INDEX:
+        {
+            cwIrEntry operands[2];
+            operands[1] = cw_ir_pop(ir);
+            operands[0] = cw_ir_pop(ir);
+            int number = cw_ir_number(ir, OP_GET_INDEX, operands[0].number, operands[1].number, (uintptr_t)ir->memory_epoch, &found);
+            cwIrFact fact = cw_ir_fact(FACT_NUMBER);
+            cw_ir_tree(ir, i, operands, 2, true, false);
+            if (rewrite) cw_ir_rewrite(ir, i, number, &fact, found, ir->depth);
+            cw_ir_push(ir, i, number, fact);
+            break;
+        }
+        case OP_SET_INDEX:
+        {
+            cwIrEntry value = ir->stack[ir->depth - 1];
+            ir->memory_epoch++;
+            cw_ir_opaque(ir, i, 3);
+            ir->stack[ir->depth - 1].number = value.number;
+            ir->stack[ir->depth - 1].fact = value.fact;
+            break;
+        }
+        case OP_ARRAY:
+            cw_ir_opaque(ir, i, inst->arg);
+            break;
+        case OP_CALL:
+        case OP_TAIL_CALL:
+            /* the callee may write any global or array */
+            ir->globals_epoch++;
+            ir->memory_epoch++;
+            cw_ir_opaque(ir, i, inst->arg + 1);
+            break;
+        default:
+            if (cw_ir_is_register(inst->op)) cw_ir_register(ir, i);
+            break;
+        }
+    }
+}
+
+/* --------------------------| propagation |------------------------------------------- */
+/* merges the slots at the end of the walked block into the entry of a successor */
+static bool cw_ir_flow_into(cwIr* ir, cwIrBlock* succ)
+{
+    if (!succ->in)
+    {
+        succ->in = CW_ALLOCATE(cwIrFact, succ->depth > 0 ? succ->depth : 1);
+        for (int s = 0; s < succ->depth; ++s) succ->in[s] = ir->stack[s].fact;
+        return true;
+    }
+
+    bool changed = false;
+    for (int s = 0; s < succ->depth; ++s) changed |= cw_ir_meet(&succ->in[s], &ir->stack[s].fact);
+    return changed;
+}
+
+static void cw_ir_propagate(cwIr* ir)
+{
+    int* work = CW_ALLOCATE(int, ir->block_count);
+    bool* queued = CW_ALLOCATE(bool, ir->block_count);
+    memset(queued, 0, ir->block_count * sizeof(bool));
+
+    /* nothing is known about the function and its arguments */
+    cwIrBlock* entry = &ir->blocks[0];
+    entry->in = CW_ALLOCATE(cwIrFact, entry->depth);
+    for (int s = 0; s < entry->depth; ++s) entry->in[s] = cw_ir_fact(FACT_ANY);
+
+    int top = 0;
+    work[top++] = 0;
+    queued[0] = true;
+    while (top > 0)
+    {
+        int b = work[--top];
+        queued[b] = false;
+        cw_ir_walk(ir, b, false);
+
+        const cwIrBlock* block = &ir->blocks[b];
+        for (int s = 0; s < block->succ_count; ++s)
+        {
+            int next = block->succ[s];
+            if (cw_ir_flow_into(ir, &ir->blocks[next]) && !queued[next])
+            {
+                queued[next] = true;
+                work[top++] = next;
+            }
+        }
+    }
+
+    /* the facts are final, now they may change the code */
+    for (int b = 0; b < ir->block_count; ++b)
+    {
+        if (ir->blocks[b].in) cw_ir_walk(ir, b, true);
+    }
+
+    CW_FREE_ARRAY(bool, queued, ir->block_count);
+    CW_FREE_ARRAY(int, work, ir->block_count);
+}
+
+/* --------------------------| dead stores |-------------------------------------------- */
+typedef uint64_t cwIrSet;
+
+static void cw_ir_set_add(cwIrSet* set, int slot)    { set[slot / 64] |= (cwIrSet)1 << (slot % 64); }
+static void cw_ir_set_remove(cwIrSet* set, int slot) { set[slot / 64] &= ~((cwIrSet)1 << (slot % 64)); }
+static bool cw_ir_set_has(const cwIrSet* set, int slot) { return (set[slot / 64] >> (slot % 64)) & 1; }
+
+/* slots read by a register instruction, constant operands aside */
+static void cw_ir_register_uses(const cwIr* ir, const cwIrInst* inst, cwIrSet* live)
+{
+    const uint8_t* bytes = ir->chunk->bytes + inst->offset + (ir->chunk->bytes[inst->offset] == OP_WIDE);
+    uint8_t mode = bytes[1];
+    int b = inst->op == OP_R_BRANCH ? 2 : 3;
+
+    if (!CW_RK_IS_CONST(mode, CW_RK_B)) cw_ir_set_add(live, bytes[b]);
+    if (inst->op != OP_R_MOVE && !CW_RK_IS_CONST(mode, CW_RK_C)) cw_ir_set_add(live, bytes[b + 1]);
+}
+
+/* live slots in front of instruction i given the ones behind it */
+static void cw_ir_transfer(const cwIr* ir, const cwIrInst* inst, cwIrSet* live)
+{
+    int after = inst->depth + inst->pushes - inst->pops;
+    if (inst->pushes > 0) cw_ir_set_remove(live, after - 1);
+
+    /* a replaced instruction only pushes its value */
+    uint8_t op = inst->replaced ? inst->new_op : inst->op;
+    int arg = inst->replaced ? inst->new_arg : inst->arg;
+    if (inst->replaced)
+    {
+        if (op == OP_GET_LOCAL) cw_ir_set_add(live, arg);
+        return;
+    }
+
+    if (op == OP_SET_LOCAL) cw_ir_set_remove(live, arg);
+    if (cw_ir_is_register(op))
+    {
+        if (op != OP_R_BRANCH) cw_ir_set_remove(live, ir->chunk->bytes[inst->offset + 2]);
+        cw_ir_register_uses(ir, inst, live);
+        return;
+    }
+
+    switch (op)
+    {
+    case OP_GET_LOCAL:
+    case OP_INC_LOCAL:  case OP_DEC_LOCAL:
+    case OP_ADD_LOCAL:  case OP_SUB_LOCAL:
+    case OP_MULT_LOCAL: case OP_DIV_LOCAL:
+        cw_ir_set_add(live, arg);
+        break;
+    case OP_JUMP_IF_FALSE:
+        cw_ir_set_add(live, inst->depth - 1);
+        break;
+    default:
+        break;
+    }
+
+    /* whatever an instruction consumes is read, a pop merely discards it */
+    if (op != OP_POP)
+    {
+        for (int k = 1; k <= inst->pops; ++k) cw_ir_set_add(live, inst->depth - k);
+    }
+}
+
+/* drops a store that is not read again, with the computation of its value if that is all it is for */
+static void cw_ir_drop_store(cwIr* ir, const cwIrBlock* block, int i)
+{
+    cwIrInst* store = &ir->insts[i];
+    store->removed = true;
+
+    if (i + 1 > block->last || store->first < 0) return;
+    cwIrInst* pop = &ir->insts[i + 1];
+    if (pop->op != OP_POP || pop->targeted || pop->removed) return;
+
+    const cwIrInst* value = &ir->insts[i - 1];
+    if (!value->pure || !value->safe || value->first < 0) return;
+    for (int k = value->first + 1; k <= i; ++k)
+    {
+        if (ir->insts[k].targeted) return;
+    }
+
+    for (int k = value->first; k < i; ++k) ir->insts[k].removed = true;
+    pop->removed = true;
+}
+
+static void cw_ir_dead_stores(cwIr* ir)
+{
+    int words = (ir->max_depth + 63) / 64;
+    cwIrSet* sets = CW_ALLOCATE(cwIrSet, (size_t)words * ir->block_count);
+    cwIrSet* live = CW_ALLOCATE(cwIrSet, words);
+    memset(sets, 0, (size_t)words * ir->block_count * sizeof(cwIrSet));
+
+    /* slots live on entry of every block, until nothing changes */
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int b = ir->block_count - 1; b >= 0; --b)
+        {
+            const cwIrBlock* block = &ir->blocks[b];
+            if (!block->in) continue;
+
+            memset(live, 0, words * sizeof(cwIrSet));
+            for (int s = 0; s < block->succ_count; ++s)
+            {
+                for (int w = 0; w < words; ++w) live[w] |= sets[block->succ[s] * words + w];
+            }
+            for (int i = block->last; i >= block->first; --i)
+            {
+                if (!ir->insts[i].removed) cw_ir_transfer(ir, &ir->insts[i], live);
+            }
+
+            cwIrSet* in = &sets[b * words];
+            if (memcmp(in, live, words * sizeof(cwIrSet)) != 0)
+            {
+                memcpy(in, live, words * sizeof(cwIrSet));
+                changed = true;
+            }
+        }
+    }
+
+    /* dropping code only removes reads, the sets stay on the safe side */
+    for (int b = 0; b < ir->block_count; ++b)
+    {
+        const cwIrBlock* block = &ir->blocks[b];
+        if (!block->in) continue;
+
+        memset(live, 0, words * sizeof(cwIrSet));
+        for (int s = 0; s < block->succ_count; ++s)
+        {
+            for (int w = 0; w < words; ++w) live[w] |= sets[block->succ[s] * words + w];
+        }
+        for (int i = block->last; i >= block->first; --i)
+        {
+            cwIrInst* inst = &ir->insts[i];
+            if (inst->removed) continue;
+
+            if (inst->op == OP_SET_LOCAL && !inst->replaced && !cw_ir_set_has(live, inst->arg))
+            {
+                cw_ir_drop_store(ir, block, i);
+                continue;
+            }
+            cw_ir_transfer(ir, inst, live);
+        }
+    }
+
+    CW_FREE_ARRAY(cwIrSet, live, words);
+    CW_FREE_ARRAY(cwIrSet, sets, (size_t)words * ir->block_count);
+}
+
+/* --------------------------| lowering |----------------------------------------------- */
+static int cw_ir_lowered_length(const cwIrInst* inst)
+{
+    if (inst->removed)  return 0;
+    if (inst->replaced) return cw_ir_encoded_length(inst->new_op, inst->new_arg);
+    return inst->length;
+}
+
+static void cw_ir_lower(cwIr* ir)
+{
+    cwChunk* chunk = ir->chunk;
+
+    /* new offsets by instruction, a removed one maps to the next kept one */
+    int* offsets = CW_ALLOCATE(int, ir->count + 1);
+    int len = 0;
+    for (int i = 0; i < ir->count; ++i)
+    {
+        offsets[i] = len;
+        len += cw_ir_lowered_length(&ir->insts[i]);
+    }
+    offsets[ir->count] = len;
+
+    /* code only moves down, a replacement is never longer than the tree it stands for */
+    for (int i = 0; i < ir->count; ++i)
+    {
+        const cwIrInst* inst = &ir->insts[i];
+        int at = offsets[i];
+        if (inst->removed) continue;
+
+        if (!inst->replaced)
+        {
+            memmove(chunk->bytes + at, chunk->bytes + inst->offset, inst->length);
+            memmove(chunk->lines + at, chunk->lines + inst->offset, inst->length * sizeof(int));
+            continue;
+        }
+
+        uint8_t* code = chunk->bytes + at;
+        int length = cw_ir_lowered_length(inst);
+        if (length == 1)
+        {
+            code[0] = inst->new_op;
+        }
+        else if (length == 2)
+        {
+            code[0] = inst->new_op;
+            code[1] = (uint8_t)inst->new_arg;
+        }
+        else
+        {
+            code[0] = OP_WIDE;
+            code[1] = inst->new_op;
+            code[2] = (inst->new_arg >> 8) & 0xff;
+            code[3] = inst->new_arg & 0xff;
+        }
+        for (int k = 0; k < length; ++k) chunk->lines[at + k] = inst->line;
+    }
+
+    for (int i = 0; i < ir->count; ++i)
+    {
+        const cwIrInst* inst = &ir->insts[i];
+        if (!inst->removed && cw_is_jump(inst->op)) cw_write_jump(chunk->bytes, offsets[i], offsets[ir->index[inst->arg]]);
+    }
+    chunk->len = len;
+
+    CW_FREE_ARRAY(int, offsets, ir->count + 1);
+}
+
+/* --------------------------| pipeline |----------------------------------------------- */
+static void cw_ir_free(cwIr* ir)
+{
+    for (int b = 0; b < ir->block_count; ++b)
+    {
+        cwIrBlock* block = &ir->blocks[b];
+        if (block->in) CW_FREE_ARRAY(cwIrFact, block->in, block->depth > 0 ? block->depth : 1);
+    }
+    CW_FREE_ARRAY(cwIrBlock, ir->blocks, ir->count);
+    CW_FREE_ARRAY(int, ir->index, ir->len + 1);
+    CW_FREE_ARRAY(cwIrInst, ir->insts, ir->count);
+    CW_FREE_ARRAY(cwIrEntry, ir->stack, ir->max_depth + 1);
+    CW_FREE_ARRAY(int, ir->holders, ir->holder_cap);
+    CW_FREE_ARRAY(cwIrKey, ir->keys, ir->key_cap);
+}
+
+void cw_optimize(cwRuntime* cw, cwFunction* function)
+{
+    cwIr ir;
+    memset(&ir, 0, sizeof(cwIr));
+    ir.function = function;
+    ir.chunk = &function->chunk;
+    ir.immutables = &cw->parser->immutables;
+    if (ir.chunk->len == 0) return;
+
+    cw_ir_lift(&ir);
+    if (!cw_ir_blocks(&ir) || (int64_t)ir.max_depth * ir.block_count > CW_IR_BUDGET)
+    {
+        cw_ir_free(&ir);
+        return;
+    }
+
+    /* a walk numbers at most the slots on entry and one value per instruction */
+    ir.stack = CW_ALLOCATE(cwIrEntry, ir.max_depth + 1);
+    ir.key_cap = 16;
+    while (ir.key_cap < 2 * (ir.max_depth + ir.count)) ir.key_cap *= 2;
+    ir.keys = CW_ALLOCATE(cwIrKey, ir.key_cap);
+    memset(ir.keys, 0, ir.key_cap * sizeof(cwIrKey));
+
+    cw_ir_propagate(&ir);
+    cw_ir_dead_stores(&ir);
+    cw_ir_lower(&ir);
+    cw_ir_free(&ir);
+}
@@ -0,0 +1,32 @@
+#ifndef CLOCKWORK_OPTIMIZE_H
+#define CLOCKWORK_OPTIMIZE_H
+
+#include "common.h"
+
+/*
+ * Optimizing pipeline for functions compiled by a runtime with optimize set
+ * (clockwork -O). The code of the direct emitter is lifted into an IR in
+ * which every instruction defines at most one value and names the values
+ * it uses, a local is the stack slot holding a value. The passes are:
+ *
+ *   - constant propagation: constants and numeric types of slots are
+ *     carried across blocks by a forward data flow, operations on
+ *     constants are folded
+ *   - common subexpressions and copies: values are numbered within blocks,
+ *     an expression whose value a slot below it already holds becomes a
+ *     read of that slot, a read of a copy becomes a read of the original,
+ *     reads of let globals stay valid across calls and global writes
+ *   - dead stores: assignments to slots that are not read again before
+ *     they are overwritten or go out of scope are dropped
+ *
+ * The IR is then lowered back to the same opcodes. Only expressions free of
+ * side effects are replaced and only by code no longer than theirs, so the
+ * code never grows and jumps keep their width. Functions with more slots
+ * times blocks than CW_IR_BUDGET are left as they are.
+ */
+#define CW_IR_BUDGET (1 << 20)
+
+/* called while cw is compiling, with its parser in place */
+void cw_optimize(cwRuntime* cw, cwFunction* function);
+
+#endif /* !CLOCKWORK_OPTIMIZE_H */
@@ -0,0 +1,300 @@
+/* write(2) is not part of c99 */
+#define _DEFAULT_SOURCE
+
+#include "output.h"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+void cw_output_init(cwOutput* out)
+{
+    out->fd = -1;
+    out->len = 0;
+}
+
+static void cw_output_raw(const cwOutput* out, const char* data, size_t len)
+{
+    if (out->fd == -1)
+    {
+        fwrite(data, 1, len, stdout);
+        return;
+    }
+
+    while (len > 0)
+    {
+        ssize_t written = write(out->fd, data, len);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        data += written;
+        len -= (size_t)written;
+    }
+}
+
+void cw_output_flush(cwOutput* out)
+{
+    if (out->len > 0) cw_output_raw(out, out->buffer, out->len);
+    out->len = 0;
+    if (out->fd == -1) fflush(stdout);
+}
+
+void cw_output_set_fd(cwOutput* out, int fd)
+{
+    cw_output_flush(out);
+    out->fd = fd;
+}
+
+/* blocks are only handed on between writes, a single write never straddles two of them */
+void cw_output_write(cwOutput* out, const char* data, size_t len)
+{
+    if (out->len + len > CW_OUTPUT_SIZE)
+    {
+        cw_output_raw(out, out->buffer, out->len);
+        out->len = 0;
+
+        if (len > CW_OUTPUT_SIZE)
+        {
+            cw_output_raw(out, data, len);
+            return;
+        }
+    }
+
+    memcpy(out->buffer + out->len, data, len);
+    out->len += len;
+}
+
+/* --------------------------| ints |--------------------------------------------------- */
+static const char cw_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* writes the decimal digits of val so that they end right before end */
+static char* cw_format_digits(char* end, uint64_t val)
+{
+    while (val >= 100)
+    {
+        const char* pair = &cw_digit_pairs[(val % 100) * 2];
+        val /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+
+    if (val >= 10)
+    {
+        *--end = cw_digit_pairs[val * 2 + 1];
+        *--end = cw_digit_pairs[val * 2];
+    }
+    else
+    {
+        *--end = (char)('0' + val);
+    }
+    return end;
+}
+
+void cw_output_int(cwOutput* out, int32_t val)
+{
+    char buffer[16];
+    char* end = buffer + sizeof(buffer);
+
+    uint32_t magnitude = val < 0 ? 0u - (uint32_t)val : (uint32_t)val;
+    char* start = cw_format_digits(end, magnitude);
+    if (val < 0) *--start = '-';
+
+    cw_output_write(out, start, (size_t)(end - start));
+}
+
+/* --------------------------| floats |------------------------------------------------- */
+static const double cw_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23,
+    1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31,
+    1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39,
+    1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47,
+    1e48, 1e49, 1e50, 1e51, 1e52, 1e53, 1e54, 1e55
+};
+
+/* val * 10^exponent, dividing for negative exponents keeps small powers exact */
+static double cw_scale(double val, int exponent)
+{
+    return exponent >= 0 ? val * cw_powers_of_ten[exponent] : val / cw_powers_of_ten[-exponent];
+}
+
+#define CW_FLOAT_DIGITS 9   /* enough to tell any two floats apart */
+
+int cw_format_float(char* buffer, float val)
+{
+    char* cursor = buffer;
+    if (isnan(val))
+    {
+        if (signbit(val)) *cursor++ = '-';
+        memcpy(cursor, "nan", 3);
+        return (int)(cursor - buffer) + 3;
+    }
+
+    if (signbit(val)) *cursor++ = '-';
+    if (isinf(val))
+    {
+        memcpy(cursor, "inf", 3);
+        return (int)(cursor - buffer) + 3;
+    }
+
+    if (val == 0.0f)
+    {
+        *cursor++ = '0';
+        return (int)(cursor - buffer);
+    }
+
+    /* decimal exponent, 10^exponent <= magnitude < 10^(exponent + 1) */
+    double magnitude = val < 0 ? -(double)val : (double)val;
+    int exponent = 0;
+    while (cw_scale(1.0, exponent + 1) <= magnitude) exponent++;
+    while (cw_scale(1.0, exponent) > magnitude)      exponent--;
+
+    /* fewest significant digits that read back as val */
+    uint64_t digits = 0;
+    int count;
+    for (count = 1; count <= CW_FLOAT_DIGITS; ++count)
+    {
+        int scale = count - 1 - exponent;
+        digits = (uint64_t)(cw_scale(magnitude, scale) + 0.5);
+
+        int point = exponent;
+        if (digits >= (uint64_t)cw_powers_of_ten[count])
+        {
+            digits /= 10;
+            point++;
+        }
+
+        if ((float)cw_scale((double)digits, point - count + 1) == (float)magnitude)
+        {
+            exponent = point;
+            break;
+        }
+    }
+
+    if (count > CW_FLOAT_DIGITS)
+    {
+        count = CW_FLOAT_DIGITS;
+        digits = (uint64_t)(cw_scale(magnitude, count - 1 - exponent) + 0.5);
+    }
+
+    while (count > 1 && digits % 10 == 0)
+    {
+        digits /= 10;
+        count--;
+    }
+
+    char text[CW_FLOAT_DIGITS];
+    cw_format_digits(text + count, digits);
+
+    /* laid out as printf's %g would */
+    if (exponent < -4 || exponent >= CW_FLOAT_DIGITS)
+    {
+        *cursor++ = text[0];
+        if (count > 1)
+        {
+            *cursor++ = '.';
+            memcpy(cursor, text + 1, (size_t)(count - 1));
+            cursor += count - 1;
+        }
+
+        *cursor++ = 'e';
+        *cursor++ = exponent < 0 ? '-' : '+';
+        int power = exponent < 0 ? -exponent : exponent;
+        *cursor++ = (char)('0' + power / 10);
+        *cursor++ = (char)('0' + power % 10);
+    }
+    else if (exponent < 0)
+    {
+        *cursor++ = '0';
+        *cursor++ = '.';
+        for (int i = -1; i > exponent; --i) *cursor++ = '0';
+        memcpy(cursor, text, (size_t)count);
+        cursor += count;
+    }
+    else
+    {
+        int whole = exponent + 1;
+        for (int i = 0; i < whole; ++i) *cursor++ = i < count ? text[i] : '0';
+        if (count > whole)
+        {
+            *cursor++ = '.';
+            memcpy(cursor, text + whole, (size_t)(count - whole));
+            cursor += count - whole;
+        }
+    }
+
+    return (int)(cursor - buffer);
+}
+
+void cw_output_float(cwOutput* out, float val)
+{
+    char buffer[16];
+    cw_output_write(out, buffer, (size_t)cw_format_float(buffer, val));
+}
+
+/* --------------------------| values |------------------------------------------------- */
+#define CW_OUTPUT_LITERAL(out, text) cw_output_write(out, text, sizeof(text) - 1)
+
+static void cw_output_object(cwOutput* out, cwValue val)
+{
+    switch (OBJECT_TYPE(val))
+    {
+    case OBJ_STRING: cw_output_write(out, AS_RAWSTRING(val), AS_STRING(val)->len); break;
+    case OBJ_FUNCTION:
+    {
+        cwFunction* function = AS_FUNCTION(val);
+        if (!function->name)
+        {
+            CW_OUTPUT_LITERAL(out, "<script>");
+            break;
+        }
+
+        CW_OUTPUT_LITERAL(out, "<fn ");
+        cw_output_write(out, function->name->raw, function->name->len);
+        CW_OUTPUT_LITERAL(out, ">");
+        break;
+    }
+    case OBJ_NATIVE:
+        CW_OUTPUT_LITERAL(out, "<native fn ");
+        cw_output_write(out, AS_NATIVE(val)->name->raw, AS_NATIVE(val)->name->len);
+        CW_OUTPUT_LITERAL(out, ">");
+        break;
+    case OBJ_INT_ARRAY:
+    case OBJ_FLOAT_ARRAY:
+    {
+        cwArray* array = AS_ARRAY(val);
+        CW_OUTPUT_LITERAL(out, "[");
+        for (size_t i = 0; i < array->len; ++i)
+        {
+            if (i) CW_OUTPUT_LITERAL(out, ", ");
+            if (IS_INT_ARRAY(val)) cw_output_int(out, array->as.ints[i]);
+            else                   cw_output_float(out, array->as.floats[i]);
+        }
+        CW_OUTPUT_LITERAL(out, "]");
+        break;
+    }
+    }
+}
+
+void cw_output_value(cwOutput* out, cwValue val)
+{
+    switch (val.type)
+    {
+    case VAL_NULL:   CW_OUTPUT_LITERAL(out, "null"); break;
+    case VAL_BOOL:
+        if (AS_BOOL(val)) CW_OUTPUT_LITERAL(out, "true");
+        else              CW_OUTPUT_LITERAL(out, "false");
+        break;
+    case VAL_INT:    cw_output_int(out, AS_INT(val)); break;
+    case VAL_FLOAT:  cw_output_float(out, AS_FLOAT(val)); break;
+    case VAL_OBJECT: cw_output_object(out, val); break;
+    }
+}
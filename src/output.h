@@ -0,0 +1,43 @@
+#ifndef CLOCKWORK_OUTPUT_H
+#define CLOCKWORK_OUTPUT_H
+
+#include <stdio.h>
+
+#include "common.h"
+
+/*
+ * Buffered output of print. Every runtime collects its output and hands it
+ * on in blocks of CW_OUTPUT_SIZE bytes, before runtime errors are reported,
+ * when cw_interpret returns and when the runtime is freed. Hosts that call
+ * into a runtime directly flush with cw_output_flush when needed.
+ *
+ * Numbers are formatted by hand: ints as plain decimals, floats as the
+ * shortest decimal that reads back as the same float.
+ */
+
+#define CW_OUTPUT_SIZE 8192
+
+typedef struct
+{
+    /* written with write(2) if not -1, through stdout otherwise */
+    int fd;
+
+    size_t len;
+    char buffer[CW_OUTPUT_SIZE];
+} cwOutput;
+
+void cw_output_init(cwOutput* out);
+void cw_output_flush(cwOutput* out);
+
+/* flushes pending output and writes everything after to fd, -1 for stdout */
+void cw_output_set_fd(cwOutput* out, int fd);
+
+void cw_output_write(cwOutput* out, const char* data, size_t len);
+void cw_output_int(cwOutput* out, int32_t val);
+void cw_output_float(cwOutput* out, float val);
+void cw_output_value(cwOutput* out, cwValue val);
+
+/* formats val into buffer, which needs room for 16 characters, and returns the length */
+int cw_format_float(char* buffer, float val);
+
+#endif /* !CLOCKWORK_OUTPUT_H */
@@ -3,6 +3,7 @@
 #include "statement.h"
 
 #include "debug.h"
+#include "inline.h"
 #include "runtime.h"
 
 /* --------------------------| parse rules |--------------------------------------------- */
@@ -21,17 +22,35 @@ static void cw_parse_string(cwRuntime* cw, bool can_assign);
 static void cw_parse_grouping(cwRuntime* cw, bool can_assign);
 static void cw_parse_unary(cwRuntime* cw, bool can_assign);
 static void cw_parse_binary(cwRuntime* cw, bool can_assign);
+/* true if the global name is a function or a let global of an earlier compile that is no array, arrays are changed in place */
+static bool cw_is_constant_global(cwRuntime* cw, cwString* name)
+{
+    if (!cw_table_find(&cw->parser->immutables, name)) return false;
+
+    cwValue* value = cw_table_find(&cw->parser->declared, name);
+    if (value) return IS_FUNCTION(*value);
+
+    value = cw_table_find(&cw->globals, name);
+    return value && !IS_ARRAY(*value);
+}
+
+static void cw_parse_call(cwRuntime* cw, bool can_assign);
+static void cw_parse_array(cwRuntime* cw, bool can_assign);
+static void cw_parse_index(cwRuntime* cw, bool can_assign);
 static void cw_parse_and(cwRuntime* cw, bool can_assign);
 static void cw_parse_or(cwRuntime* cw, bool can_assign);
 static void cw_parse_literal(cwRuntime* cw, bool can_assign);
 static void cw_parse_variable(cwRuntime* cw, bool can_assign);
+static void cw_parse_inplace(cwRuntime* cw, bool can_assign);
 
 ParseRule rules[] = {
     [TOKEN_EOF]         = { NULL,               NULL,               PREC_NONE },
-    [TOKEN_LPAREN]      = { cw_parse_grouping,  NULL,               PREC_NONE },
+    [TOKEN_LPAREN]      = { cw_parse_grouping,  cw_parse_call,      PREC_CALL },
     [TOKEN_RPAREN]      = { NULL,               NULL,               PREC_NONE },
     [TOKEN_LBRACE]      = { NULL,               NULL,               PREC_NONE }, 
     [TOKEN_RBRACE]      = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_LBRACKET]    = { cw_parse_array,     cw_parse_index,     PREC_CALL },
+    [TOKEN_RBRACKET]    = { NULL,               NULL,               PREC_NONE },
     [TOKEN_PERIOD]      = { NULL,               NULL,               PREC_NONE },
     [TOKEN_COMMA]       = { NULL,               NULL,               PREC_NONE },
     [TOKEN_COLON]       = { NULL,               NULL,               PREC_NONE },
@@ -42,6 +61,12 @@ ParseRule rules[] = {
     [TOKEN_SLASH]       = { NULL,               cw_parse_binary,    PREC_FACTOR },
     [TOKEN_EXCLAMATION] = { cw_parse_unary,     NULL,               PREC_NONE },
     [TOKEN_ASSIGN]      = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_ADD_ASSIGN]  = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_SUB_ASSIGN]  = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_MULT_ASSIGN] = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_DIV_ASSIGN]  = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_INC]         = { cw_parse_inplace,   NULL,               PREC_NONE },
+    [TOKEN_DEC]         = { cw_parse_inplace,   NULL,               PREC_NONE },
     [TOKEN_AND]         = { NULL,               cw_parse_and,       PREC_AND },
     [TOKEN_OR]          = { NULL,               cw_parse_or,        PREC_OR },
     // Comparison tokens.
@@ -66,6 +91,7 @@ ParseRule rules[] = {
     [TOKEN_FOR]         = { NULL,               NULL,               PREC_NONE },
     [TOKEN_LET]         = { NULL,               NULL,               PREC_NONE },
     [TOKEN_FUNC]        = { NULL,               NULL,               PREC_NONE },
+    [TOKEN_PURE]        = { NULL,               NULL,               PREC_NONE },
     [TOKEN_DATATYPE]    = { NULL,               NULL,               PREC_NONE },
     [TOKEN_RETURN]      = { NULL,               NULL,               PREC_NONE },
     [TOKEN_PRINT]       = { NULL,               NULL,               PREC_NONE },
@@ -74,47 +100,48 @@ ParseRule rules[] = {
 void cw_parse_precedence(cwRuntime* cw, Precedence precedence)
 {
     cw_advance(cw);
-    ParseCallback prefix_rule = rules[cw->previous.type].prefix;
+    ParseCallback prefix_rule = rules[cw->parser->previous.type].prefix;
 
     if (!prefix_rule)
     {
-        cw_syntax_error_at(cw, &cw->previous, "Expect expression");
+        cw_syntax_error_at(cw, &cw->parser->previous, "Expect expression");
         return;
     }
 
     bool can_assign = precedence <= PREC_ASSIGNMENT;
     prefix_rule(cw, can_assign);
 
-    while (precedence <= rules[cw->current.type].precedence)
+    while (precedence <= rules[cw->parser->current.type].precedence)
     {
         cw_advance(cw);
-        ParseCallback infix_rule = rules[cw->previous.type].infix;
+        ParseCallback infix_rule = rules[cw->parser->previous.type].infix;
         infix_rule(cw, can_assign);
     }
 
-    if (can_assign && cw_match(cw, TOKEN_ASSIGN))
+    if (can_assign && (cw_match(cw, TOKEN_ASSIGN) || cw_match_compound_assign(cw)))
     {
-        cw_syntax_error_at(cw, &cw->previous, "Invalid assignment target.");
+        cw_syntax_error_at(cw, &cw->parser->previous, "Invalid assignment target.");
     }
 }
 
 /* --------------------------| parse callbacks |----------------------------------------- */
 static void cw_parse_integer(cwRuntime* cw, bool can_assign)
 {
-    int32_t value = strtol(cw->previous.start, NULL, cw_token_get_base(&cw->previous));
-    cw_emit_bytes(cw->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_INT(value)), cw->previous.line);
+    int32_t value = strtol(cw->parser->previous.start, NULL, cw_token_get_base(&cw->parser->previous));
+    cw_emit_arg(cw->parser->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_INT(value)), cw->parser->previous.line);
 }
 
 static void cw_parse_float(cwRuntime* cw, bool can_assign)
 {
-    float value = strtod(cw->previous.start, NULL);
-    cw_emit_bytes(cw->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_FLOAT(value)), cw->previous.line);
+    float value = strtod(cw->parser->previous.start, NULL);
+    cw_emit_arg(cw->parser->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_FLOAT(value)), cw->parser->previous.line);
 }
 
 static void cw_parse_string(cwRuntime* cw, bool can_assign)
 {
-    cwString* value = cw_str_copy(cw, cw->previous.start + 1, cw->previous.end - cw->previous.start - 2);
-    cw_emit_bytes(cw->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_OBJECT(value)), cw->previous.line);
+    cwString* value = cw_str_copy_hashed(cw, cw->parser->previous.start + 1, cw->parser->previous.end - cw->parser->previous.start - 2,
+                                          cw->parser->previous.hash);
+    cw_emit_arg(cw->parser->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_OBJECT(value)), cw->parser->previous.line);
 }
 
 static void cw_parse_grouping(cwRuntime* cw, bool can_assign)
@@ -125,41 +152,119 @@ static void cw_parse_grouping(cwRuntime* cw, bool can_assign)
 
 static void cw_parse_unary(cwRuntime* cw, bool can_assign)
 {
-    cwTokenType operator = cw->previous.type;
+    cwTokenType operator = cw->parser->previous.type;
     cw_parse_precedence(cw, PREC_UNARY);
 
     switch (operator)
     {
-    case TOKEN_EXCLAMATION: cw_emit_byte(cw->chunk, OP_NOT,    cw->previous.line); break;
-    case TOKEN_MINUS:       cw_emit_byte(cw->chunk, OP_NEGATE, cw->previous.line); break;
+    case TOKEN_EXCLAMATION: cw_emit_byte(cw->parser->chunk, OP_NOT,    cw->parser->previous.line); break;
+    case TOKEN_MINUS:       cw_emit_byte(cw->parser->chunk, OP_NEGATE, cw->parser->previous.line); break;
     }
 }
 
 static void cw_parse_binary(cwRuntime* cw, bool can_assign)
 {
-    cwTokenType operator = cw->previous.type;
+    cwTokenType operator = cw->parser->previous.type;
     cw_parse_precedence(cw, (Precedence)(rules[operator].precedence + 1));
 
     switch (operator)
     {
-    case TOKEN_EQ:        cw_emit_byte(cw->chunk, OP_EQ,       cw->previous.line); break;
-    case TOKEN_NOTEQ:     cw_emit_byte(cw->chunk, OP_NOTEQ,    cw->previous.line); break;
-    case TOKEN_LT:        cw_emit_byte(cw->chunk, OP_LT,       cw->previous.line); break;
-    case TOKEN_LTEQ:      cw_emit_byte(cw->chunk, OP_LTEQ,     cw->previous.line); break;
-    case TOKEN_GT:        cw_emit_byte(cw->chunk, OP_GT,       cw->previous.line); break;
-    case TOKEN_GTEQ:      cw_emit_byte(cw->chunk, OP_GTEQ,     cw->previous.line); break;
-    case TOKEN_PLUS:      cw_emit_byte(cw->chunk, OP_ADD,      cw->previous.line); break;
-    case TOKEN_MINUS:     cw_emit_byte(cw->chunk, OP_SUBTRACT, cw->previous.line); break;
-    case TOKEN_ASTERISK:  cw_emit_byte(cw->chunk, OP_MULTIPLY, cw->previous.line); break;
-    case TOKEN_SLASH:     cw_emit_byte(cw->chunk, OP_DIVIDE,   cw->previous.line); break;
+    case TOKEN_EQ:        cw_emit_byte(cw->parser->chunk, OP_EQ,       cw->parser->previous.line); break;
+    case TOKEN_NOTEQ:     cw_emit_byte(cw->parser->chunk, OP_NOTEQ,    cw->parser->previous.line); break;
+    case TOKEN_LT:        cw_emit_byte(cw->parser->chunk, OP_LT,       cw->parser->previous.line); break;
+    case TOKEN_LTEQ:      cw_emit_byte(cw->parser->chunk, OP_LTEQ,     cw->parser->previous.line); break;
+    case TOKEN_GT:        cw_emit_byte(cw->parser->chunk, OP_GT,       cw->parser->previous.line); break;
+    case TOKEN_GTEQ:      cw_emit_byte(cw->parser->chunk, OP_GTEQ,     cw->parser->previous.line); break;
+    case TOKEN_PLUS:      cw_emit_byte(cw->parser->chunk, OP_ADD,      cw->parser->previous.line); break;
+    case TOKEN_MINUS:     cw_emit_byte(cw->parser->chunk, OP_SUBTRACT, cw->parser->previous.line); break;
+    case TOKEN_ASTERISK:  cw_emit_byte(cw->parser->chunk, OP_MULTIPLY, cw->parser->previous.line); break;
+    case TOKEN_SLASH:     cw_emit_byte(cw->parser->chunk, OP_DIVIDE,   cw->parser->previous.line); break;
+    }
+}
+
+static uint8_t cw_parse_arguments(cwRuntime* cw)
+{
+    uint8_t argc = 0;
+    if (cw->parser->current.type != TOKEN_RPAREN)
+    {
+        do
+        {
+            cw_parse_expression(cw);
+            if (argc == UINT8_MAX) cw_syntax_error_at(cw, &cw->parser->previous, "Can not have more than 255 arguments.");
+            argc++;
+        } while (cw_match(cw, TOKEN_COMMA));
+    }
+    cw_consume(cw, TOKEN_RPAREN, "Expect ')' after arguments.");
+    return argc;
+}
+
+/* true if callee, the offset of the global a call loads or -1, is the pure function being compiled or declared pure before */
+static bool cw_is_pure_callee(cwRuntime* cw, int callee)
+{
+    if (callee < 0) return false;
+
+    cwString* name = AS_STRING(cw->parser->chunk->constants[cw_op_arg(cw->parser->chunk->bytes + callee)]);
+    if (name == cw->parser->compiler->function->name) return true;
+
+    cwValue* value = cw_table_find(&cw->parser->declared, name);
+    if (!value && cw_table_find(&cw->parser->immutables, name)) value = cw_table_find(&cw->globals, name);
+    return value && IS_FUNCTION(*value) && AS_FUNCTION(*value)->memo >= 0;
+}
+
+static void cw_parse_call(cwRuntime* cw, bool can_assign)
+{
+    int callee = cw->parser->callee;
+    int len = (int)cw->parser->chunk->len;
+    if (callee < 0 || callee >= len || callee + cw_op_length(cw->parser->chunk->bytes + callee) != len) callee = -1;
+
+    /* natives and impure functions could make the cached results of a pure function wrong */
+    if (cw->parser->compiler->function->memo >= 0 && !cw_is_pure_callee(cw, callee))
+        cw_syntax_error_at(cw, &cw->parser->previous, "Pure function can only call pure functions.");
+
+    uint8_t argc = cw_parse_arguments(cw);
+    if (cw_inline_call(cw, callee, argc)) return;
+
+    cw->parser->compiler->last_call = cw->parser->chunk->len;
+    cw_emit_bytes(cw->parser->chunk, OP_CALL, argc, cw->parser->previous.line);
+}
+
+static void cw_parse_array(cwRuntime* cw, bool can_assign)
+{
+    uint8_t count = 0;
+    if (cw->parser->current.type != TOKEN_RBRACKET)
+    {
+        do
+        {
+            cw_parse_expression(cw);
+            if (count == UINT8_MAX) cw_syntax_error_at(cw, &cw->parser->previous, "Can not have more than 255 elements.");
+            count++;
+        } while (cw_match(cw, TOKEN_COMMA));
+    }
+    cw_consume(cw, TOKEN_RBRACKET, "Expect ']' after elements.");
+    cw_emit_bytes(cw->parser->chunk, OP_ARRAY, count, cw->parser->previous.line);
+}
+
+static void cw_parse_index(cwRuntime* cw, bool can_assign)
+{
+    cw_parse_expression(cw);
+    cw_consume(cw, TOKEN_RBRACKET, "Expect ']' after index.");
+
+    if (can_assign && cw_match(cw, TOKEN_ASSIGN))
+    {
+        cw_parse_expression(cw);
+        cw_emit_byte(cw->parser->chunk, OP_SET_INDEX, cw->parser->previous.line);
+    }
+    else
+    {
+        cw_emit_byte(cw->parser->chunk, OP_GET_INDEX, cw->parser->previous.line);
     }
 }
 
 static void cw_parse_and(cwRuntime* cw, bool can_assign)
 {
-    int end_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
+    int end_jump = cw_emit_jump(cw->parser->chunk, OP_JUMP_IF_FALSE, cw->parser->previous.line);
 
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+    cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line);
     cw_parse_precedence(cw, PREC_AND);
 
     cw_patch_jump(cw, end_jump);
@@ -167,11 +272,11 @@ static void cw_parse_and(cwRuntime* cw, bool can_assign)
 
 static void cw_parse_or(cwRuntime* cw, bool can_assign)
 {
-    int else_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-    int end_jump  = cw_emit_jump(cw->chunk, OP_JUMP, cw->previous.line);
+    int else_jump = cw_emit_jump(cw->parser->chunk, OP_JUMP_IF_FALSE, cw->parser->previous.line);
+    int end_jump  = cw_emit_jump(cw->parser->chunk, OP_JUMP, cw->parser->previous.line);
 
     cw_patch_jump(cw, else_jump);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+    cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line);
 
     cw_parse_precedence(cw, PREC_OR);
     cw_patch_jump(cw, end_jump);
@@ -179,81 +284,210 @@ static void cw_parse_or(cwRuntime* cw, bool can_assign)
 
 static void cw_parse_literal(cwRuntime* cw, bool can_assign)
 {
-    switch (cw->previous.type)
+    switch (cw->parser->previous.type)
     {
-    case TOKEN_FALSE: cw_emit_byte(cw->chunk, OP_FALSE, cw->previous.line); break;
-    case TOKEN_NULL:  cw_emit_byte(cw->chunk, OP_NULL, cw->previous.line); break;
-    case TOKEN_TRUE:  cw_emit_byte(cw->chunk, OP_TRUE, cw->previous.line); break;
+    case TOKEN_FALSE: cw_emit_byte(cw->parser->chunk, OP_FALSE, cw->parser->previous.line); break;
+    case TOKEN_NULL:  cw_emit_byte(cw->parser->chunk, OP_NULL, cw->parser->previous.line); break;
+    case TOKEN_TRUE:  cw_emit_byte(cw->parser->chunk, OP_TRUE, cw->parser->previous.line); break;
     }
 }
 
-static void cw_parse_variable(cwRuntime* cw, bool can_assign)
+/* returns the local variant of the in-place opcode for an operator token */
+static uint8_t cw_inplace_op(cwTokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_INC:         return OP_INC_LOCAL;
+    case TOKEN_DEC:         return OP_DEC_LOCAL;
+    case TOKEN_ADD_ASSIGN:  return OP_ADD_LOCAL;
+    case TOKEN_SUB_ASSIGN:  return OP_SUB_LOCAL;
+    case TOKEN_MULT_ASSIGN: return OP_MULT_LOCAL;
+    default:                return OP_DIV_LOCAL;
+    }
+}
+
+/* resolves a variable to a local slot or the constant holding the global's name */
+static int cw_resolve_variable(cwRuntime* cw, cwToken* name, bool* global)
+{
+    int arg = cw_resolve_local(cw, name);
+    *global = arg < 0;
+    return *global ? cw_identifier_constant(cw, name) : arg;
+}
+
+/* reports assignments to let bindings and records the globals that are assigned */
+static void cw_check_assignment(cwRuntime* cw, cwToken* name, bool global, int arg)
 {
-    uint8_t get_op, set_op;
-    int arg = cw_resolve_local(cw, &cw->previous);
-    if (arg >= 0)
+    bool mut;
+    if (global)
     {
-        get_op = OP_GET_LOCAL;
-        set_op = OP_SET_LOCAL;
+        cwString* string = AS_STRING(cw->parser->chunk->constants[arg]);
+        mut = cw_table_find(&cw->parser->immutables, string) == NULL;
+        cw_table_insert(&cw->parser->assigned, string, MAKE_BOOL(true));
+        if (cw->parser->compiler->function->memo >= 0) cw_syntax_error_at(cw, name, "Pure function can not assign globals.");
     }
     else
     {
-        arg = cw_identifier_constant(cw, &cw->previous);
-        get_op = OP_GET_GLOBAL;
-        set_op = OP_SET_GLOBAL;
+        mut = cw->parser->compiler->locals[arg].mut;
+    }
+
+    if (!mut) cw_syntax_error_at(cw, name, "Can not assign to immutable variable.");
+}
+
+/* the literal a let binding is bound to, null if there is none */
+static cwValue cw_known_value(cwRuntime* cw, bool global, int arg)
+{
+    if (!global)
+    {
+        const cwLocal* local = &cw->parser->compiler->locals[arg];
+        return local->known ? local->value : MAKE_NULL();
     }
 
+    cwValue* value = cw_table_find(&cw->parser->immutables, AS_STRING(cw->parser->chunk->constants[arg]));
+    return value ? *value : MAKE_NULL();
+}
+
+static void cw_emit_inplace(cwRuntime* cw, int start, uint8_t op, bool global, int arg, bool postfix)
+{
+    /* global variants directly follow the local ones */
+    uint8_t get_op = global ? OP_GET_GLOBAL : OP_GET_LOCAL;
+    op += global;
+
+    /* the value of the expression is read back from the variable */
+    if (postfix)
+    {
+        cw->parser->inplace_value = cw->parser->chunk->len;
+        cw_emit_arg(cw->parser->chunk, get_op, arg, cw->parser->previous.line);
+    }
+    cw_emit_arg(cw->parser->chunk, op, arg, cw->parser->previous.line);
+    if (!postfix)
+    {
+        cw->parser->inplace_value = cw->parser->chunk->len;
+        cw_emit_arg(cw->parser->chunk, get_op, arg, cw->parser->previous.line);
+    }
+
+    cw->parser->inplace_start = start;
+    cw->parser->inplace_end = cw->parser->chunk->len;
+}
+
+static void cw_parse_variable(cwRuntime* cw, bool can_assign)
+{
+    int start = cw->parser->chunk->len;
+    size_t constants = cw->parser->chunk->const_len;
+    cwToken name = cw->parser->previous;
+    bool global;
+    int arg = cw_resolve_variable(cw, &name, &global);
+
     if (can_assign && cw_match(cw, TOKEN_ASSIGN))
     {
+        cw_check_assignment(cw, &name, global, arg);
+        cw_parse_expression(cw);
+        cw_emit_arg(cw->parser->chunk, global ? OP_SET_GLOBAL : OP_SET_LOCAL, arg, cw->parser->previous.line);
+    }
+    else if (can_assign && cw_match_compound_assign(cw))
+    {
+        cw_check_assignment(cw, &name, global, arg);
+        uint8_t op = cw_inplace_op(cw->parser->previous.type);
         cw_parse_expression(cw);
-        cw_emit_bytes(cw->chunk, set_op, (uint8_t)arg, cw->previous.line);
+        cw_emit_inplace(cw, start, op, global, arg, false);
+    }
+    else if (cw_match(cw, TOKEN_INC) || cw_match(cw, TOKEN_DEC))
+    {
+        cw_check_assignment(cw, &name, global, arg);
+        cw_emit_inplace(cw, start, cw_inplace_op(cw->parser->previous.type), global, arg, true);
     }
     else 
     {
-        cw_emit_bytes(cw->chunk, get_op, (uint8_t)arg, cw->previous.line);
+        cwValue value = cw_known_value(cw, global, arg);
+        if (IS_NULL(value))
+        {
+            /* a global that can change could change the result of a pure function, callees are checked by the call */
+            if (global && cw->parser->compiler->function->memo >= 0 && cw->parser->current.type != TOKEN_LPAREN
+                && !cw_is_constant_global(cw, AS_STRING(cw->parser->chunk->constants[arg])))
+                cw_syntax_error_at(cw, &name, "Pure function can only read globals that never change.");
+
+            if (global) cw->parser->callee = cw->parser->chunk->len;
+            cw_emit_arg(cw->parser->chunk, global ? OP_GET_GLOBAL : OP_GET_LOCAL, arg, cw->parser->previous.line);
+        }
+        else
+        {
+            /* the name of a global added for this read, its literal takes the place */
+            if (global && cw->parser->chunk->const_len > constants) cw_pop_constant(cw);
+            if (IS_BOOL(value))
+                cw_emit_byte(cw->parser->chunk, AS_BOOL(value) ? OP_TRUE : OP_FALSE, cw->parser->previous.line);
+            else
+                cw_emit_arg(cw->parser->chunk, OP_CONSTANT, cw_make_constant(cw, value), cw->parser->previous.line);
+        }
     }
 }
 
+static void cw_parse_inplace(cwRuntime* cw, bool can_assign)
+{
+    int start = cw->parser->chunk->len;
+    uint8_t op = cw_inplace_op(cw->parser->previous.type);
+    cw_consume(cw, TOKEN_IDENTIFIER, "Expect variable name after increment or decrement.");
+
+    bool global;
+    int arg = cw_resolve_variable(cw, &cw->parser->previous, &global);
+    cw_check_assignment(cw, &cw->parser->previous, global, arg);
+    cw_emit_inplace(cw, start, op, global, arg, false);
+}
+
 /* --------------------------| utility |------------------------------------------------- */
 void cw_advance(cwRuntime* cw)
 {
-    cw->previous = cw->current;
-    const char* cursor = cw->previous.end;
-    int line = cw->previous.line;
-    while (true)
+    cwParser* parser = cw->parser;
+    parser->previous = parser->current;
+    do
     {
-        cursor = cw_scan_token(cw, &cw->current, cursor, line);
-        if (!cw->error) break;
-    }
+        /* error tokens are reported and skipped */
+        cw_lex_token(&parser->tokens, parser->source, parser->next++, parser->current.line, &parser->current);
+        if (parser->current.type == TOKEN_ERROR) cw_scan_error(cw, &parser->current);
+    } while (parser->current.type == TOKEN_ERROR);
 }
 
 void cw_consume(cwRuntime* cw, cwTokenType type, const char* message)
 {
-    if (cw->current.type == type)   cw_advance(cw);
-    else                            cw_syntax_error_at(cw, &cw->current, message);
+    if (cw->parser->current.type == type)   cw_advance(cw);
+    else                            cw_syntax_error_at(cw, &cw->parser->current, message);
 }
 
 bool cw_match(cwRuntime* cw, cwTokenType type)
 {
-    if (cw->current.type != type) return false;
+    if (cw->parser->current.type != type) return false;
     cw_advance(cw);
     return true;
 }
 
+bool cw_match_compound_assign(cwRuntime* cw)
+{
+    switch (cw->parser->current.type)
+    {
+    case TOKEN_ADD_ASSIGN:
+    case TOKEN_SUB_ASSIGN:
+    case TOKEN_MULT_ASSIGN:
+    case TOKEN_DIV_ASSIGN:
+        cw_advance(cw);
+        return true;
+    default:
+        return false;
+    }
+}
+
 void cw_parser_synchronize(cwRuntime* cw)
 {
-    cw->panic = false;
+    cw->parser->panic = false;
 
-    while (cw->current.type != TOKEN_EOF)
+    while (cw->parser->current.type != TOKEN_EOF)
     {
-        if (cw->previous.type == TOKEN_SEMICOLON) return;
-        switch (cw->current.type)
+        if (cw->parser->previous.type == TOKEN_SEMICOLON) return;
+        switch (cw->parser->current.type)
         {
         case TOKEN_IF:
         case TOKEN_FOR:
         case TOKEN_WHILE:
         case TOKEN_LET:
         case TOKEN_FUNC:
+        case TOKEN_PURE:
         case TOKEN_DATATYPE: 
         case TOKEN_RETURN:
         case TOKEN_PRINT:
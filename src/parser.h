@@ -24,6 +24,7 @@ void cw_parse_precedence(cwRuntime* cw, Precedence precedence);
 void cw_advance(cwRuntime* cw);
 void cw_consume(cwRuntime* cw, cwTokenType type, const char* message);
 bool cw_match(cwRuntime* cw, cwTokenType type);
+bool cw_match_compound_assign(cwRuntime* cw);
 void cw_parser_synchronize(cwRuntime* cw);
 
 #endif /* !CLOCKWORK_PARSER_H */
\ No newline at end of file
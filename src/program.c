@@ -0,0 +1,116 @@
+#include "program.h"
+
+#include <string.h>
+
+#include "memory.h"
+
+static cwProgram* cw_program_new(cwRuntime* cw, const char* src, size_t len, uint32_t hash, bool detached)
+{
+    cwObject* objects = cw->objects;
+    uint32_t declarations = cw->declarations;
+    cwFunction* script = detached ? cw_compile_detached(cw, src) : cw_compile(cw, src);
+    if (!script) return NULL;
+
+    cwProgram* program = cw_reallocate(NULL, 0, sizeof(cwProgram));
+    program->script = script;
+    program->functions = NULL;
+    program->source = NULL;
+    program->len = len;
+    program->hash = hash;
+    program->declarations = declarations;
+
+    /* take the functions allocated by the compiler out of the runtime */
+    cwObject** link = &cw->objects;
+    while (*link != objects)
+    {
+        cwObject* object = *link;
+        if (object->type == OBJ_FUNCTION)
+        {
+            *link = object->next;
+            object->next = program->functions;
+            program->functions = object;
+        }
+        else
+        {
+            link = &object->next;
+        }
+    }
+    return program;
+}
+
+cwProgram* cw_program_compile(cwRuntime* cw, const char* src)
+{
+    return cw_program_new(cw, src, strlen(src), 0, false);
+}
+
+cwProgram* cw_program_compile_detached(cwRuntime* cw, const char* src)
+{
+    return cw_program_new(cw, src, strlen(src), 0, true);
+}
+
+InterpretResult cw_program_run(cwRuntime* cw, const cwProgram* program)
+{
+    return cw_run_script(cw, program->script);
+}
+
+void cw_program_free(cwRuntime* cw, cwProgram* program)
+{
+    if (!program) return;
+
+    /* compiled loops are keyed by code address, which can be reused */
+    for (cwObject* object = program->functions; object; object = object->next)
+    {
+        cw_jit_forget(cw->jit, &((cwFunction*)object)->chunk);
+    }
+
+    cw_free_object_list(program->functions);
+    if (program->source) CW_FREE_ARRAY(char, program->source, program->len + 1);
+    cw_reallocate(program, sizeof(cwProgram), 0);
+}
+
+/* --------------------------| cache |--------------------------------------------------- */
+/* frees the program but keeps its functions alive until the runtime is freed */
+static void cw_program_retire(cwRuntime* cw, cwProgram* program)
+{
+    while (program->functions)
+    {
+        cwObject* object = program->functions;
+        program->functions = object->next;
+        object->next = cw->objects;
+        cw->objects = object;
+    }
+    cw_program_free(cw, program);
+}
+
+const cwProgram* cw_program_cached(cwRuntime* cw, const char* src)
+{
+    size_t len = strlen(src);
+    uint32_t hash = cw_hash_str(src, len);
+    cwProgram** slot = &cw->programs[hash % CW_PROGRAM_CACHE_SIZE];
+
+    cwProgram* cached = *slot;
+    if (cached && cached->hash == hash && cached->len == len && cached->declarations == cw->declarations
+        && memcmp(cached->source, src, len) == 0)
+    {
+        return cached;
+    }
+
+    cwProgram* program = cw_program_new(cw, src, len, hash, false);
+    if (!program) return NULL;
+
+    program->source = CW_ALLOCATE(char, len + 1);
+    memcpy(program->source, src, len + 1);
+
+    if (cached) cw_program_retire(cw, cached);
+    *slot = program;
+    return program;
+}
+
+void cw_program_cache_free(cwRuntime* cw)
+{
+    for (int i = 0; i < CW_PROGRAM_CACHE_SIZE; ++i)
+    {
+        cw_program_free(cw, cw->programs[i]);
+        cw->programs[i] = NULL;
+    }
+}
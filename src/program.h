@@ -0,0 +1,48 @@
+#ifndef CLOCKWORK_PROGRAM_H
+#define CLOCKWORK_PROGRAM_H
+
+#include "common.h"
+#include "runtime.h"
+
+/*
+ * A compiled script that can run any number of times. The program owns
+ * every function compiled for it, strings stay interned in the runtime.
+ */
+struct cwProgram
+{
+    cwFunction* script;
+    cwObject* functions;
+
+    /* source the program was compiled from, only kept for the cache */
+    char* source;
+    size_t len;
+    uint32_t hash;
+
+    /* declarations of the runtime it was compiled against, see cw_program_cached */
+    uint32_t declarations;
+};
+
+/* returns NULL on a syntax error */
+cwProgram* cw_program_compile(cwRuntime* cw, const char* src);
+
+/* for programs whose functions are called but whose script never runs, see cw_compile_detached */
+cwProgram* cw_program_compile_detached(cwRuntime* cw, const char* src);
+InterpretResult cw_program_run(cwRuntime* cw, const cwProgram* program);
+
+/* frees the program and its functions, which must not be called afterwards */
+void cw_program_free(cwRuntime* cw, cwProgram* program);
+
+/*
+ * returns the cached program for src or compiles and caches it, NULL on a
+ * syntax error. programs pushed out of the cache hand their functions to
+ * the runtime since globals may still refer to them.
+ *
+ * a program is only reused while no compile has declared or assigned new
+ * globals since it was compiled, programs that do so themselves are compiled
+ * again every time and fail like any other source would, e.g. on a second
+ * let of the same name.
+ */
+const cwProgram* cw_program_cached(cwRuntime* cw, const char* src);
+void cw_program_cache_free(cwRuntime* cw);
+
+#endif /* !CLOCKWORK_PROGRAM_H */
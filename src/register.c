@@ -0,0 +1,177 @@
+#include "register.h"
+
+#include <stdlib.h>
+
+#include "parser.h"
+
+#include "debug.h"
+#include "runtime.h"
+
+#ifdef CW_REGISTER_VM
+
+/* --------------------------| operands |------------------------------------------------ */
+typedef struct
+{
+    cwToken token;
+    bool constant;
+    int index;
+} cwOperand;
+
+static bool cw_operand_check(cwRuntime* cw, cwOperand* operand)
+{
+    switch (operand->token.type)
+    {
+    case TOKEN_IDENTIFIER:
+        operand->constant = false;
+        operand->index = cw_resolve_local(cw, &operand->token);
+        return operand->index >= 0 && operand->index <= UINT8_MAX;
+    case TOKEN_INTEGER:
+    case TOKEN_FLOAT:
+    case TOKEN_STRING:
+        /* register operands address 8 bit constants, both operands of a pattern may add one */
+        operand->constant = true;
+        return cw->parser->chunk->const_len < UINT8_MAX;
+    default:
+        return false;
+    }
+}
+
+/* adds literal operands to the constant table, must only be called once the pattern matched */
+static uint8_t cw_operand_emit(cwRuntime* cw, cwOperand* operand)
+{
+    if (!operand->constant) return (uint8_t)operand->index;
+
+    cwToken* token = &operand->token;
+    switch (token->type)
+    {
+    case TOKEN_INTEGER:
+        return (uint8_t)cw_make_constant(cw, MAKE_INT(strtol(token->start, NULL, cw_token_get_base(token))));
+    case TOKEN_FLOAT:
+        return (uint8_t)cw_make_constant(cw, MAKE_FLOAT(strtod(token->start, NULL)));
+    default:
+        return (uint8_t)cw_make_constant(cw, MAKE_OBJECT(cw_str_copy_hashed(cw, token->start + 1, token->end - token->start - 2, token->hash)));
+    }
+}
+
+static uint8_t cw_register_arith_op(cwTokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_PLUS:        return OP_R_ADD;
+    case TOKEN_MINUS:       return OP_R_SUB;
+    case TOKEN_ASTERISK:    return OP_R_MULT;
+    case TOKEN_SLASH:       return OP_R_DIV;
+    default:                return OP_R_MOVE;
+    }
+}
+
+static uint8_t cw_register_cmp_op(cwTokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_EQ:          return OP_R_EQ;
+    case TOKEN_NOTEQ:       return OP_R_NOTEQ;
+    case TOKEN_LT:          return OP_R_LT;
+    case TOKEN_LTEQ:        return OP_R_LTEQ;
+    case TOKEN_GT:          return OP_R_GT;
+    case TOKEN_GTEQ:        return OP_R_GTEQ;
+    default:                return OP_R_MOVE;
+    }
+}
+
+/* the n tokens following the current one, errors are reported once the parser gets there */
+static void cw_peek_tokens(cwRuntime* cw, cwToken* tokens, int n)
+{
+    int line = cw->parser->current.line;
+    for (int i = 0; i < n; ++i)
+    {
+        cw_lex_token(&cw->parser->tokens, cw->parser->source, cw->parser->next + i, line, &tokens[i]);
+        line = tokens[i].line;
+    }
+}
+
+static void cw_skip_tokens(cwRuntime* cw, int n)
+{
+    while (n-- > 0) cw_advance(cw);
+}
+
+#endif /* CW_REGISTER_VM */
+
+/* --------------------------| statements |---------------------------------------------- */
+bool cw_register_assignment(cwRuntime* cw, cwTokenType terminator)
+{
+#ifdef CW_REGISTER_VM
+    if (cw->parser->current.type != TOKEN_IDENTIFIER) return false;
+
+    /* target '=' a [op b] terminator */
+    cwToken tokens[5];
+    cw_peek_tokens(cw, tokens, 5);
+    if (tokens[0].type != TOKEN_ASSIGN) return false;
+
+    /* let bindings are left to the stack code, which reports the assignment */
+    int dst = cw_resolve_local(cw, &cw->parser->current);
+    if (dst < 0 || dst > UINT8_MAX || !cw->parser->compiler->locals[dst].mut) return false;
+
+    cwOperand a = { tokens[1] };
+    if (!cw_operand_check(cw, &a)) return false;
+
+    if (tokens[2].type == terminator)
+    {
+        uint8_t src = cw_operand_emit(cw, &a);
+        cw_emit_bytes(cw->parser->chunk, OP_R_MOVE, a.constant ? CW_RK_B : 0, cw->parser->current.line);
+        cw_emit_bytes(cw->parser->chunk, (uint8_t)dst, src, cw->parser->current.line);
+        cw_skip_tokens(cw, 3);
+        return true;
+    }
+
+    uint8_t op = cw_register_arith_op(tokens[2].type);
+    if (op == OP_R_MOVE) op = cw_register_cmp_op(tokens[2].type);
+    if (op == OP_R_MOVE || tokens[4].type != terminator) return false;
+
+    cwOperand b = { tokens[3] };
+    if (!cw_operand_check(cw, &b)) return false;
+
+    uint8_t mode = (a.constant ? CW_RK_B : 0) | (b.constant ? CW_RK_C : 0);
+    uint8_t rk_a = cw_operand_emit(cw, &a);
+    uint8_t rk_b = cw_operand_emit(cw, &b);
+
+    cw_emit_bytes(cw->parser->chunk, op, mode, cw->parser->current.line);
+    cw_emit_bytes(cw->parser->chunk, (uint8_t)dst, rk_a, cw->parser->current.line);
+    cw_emit_byte(cw->parser->chunk, rk_b, cw->parser->current.line);
+    cw_skip_tokens(cw, 5);
+    return true;
+#else
+    return false;
+#endif
+}
+
+int cw_register_condition(cwRuntime* cw, cwTokenType terminator)
+{
+#ifdef CW_REGISTER_VM
+    /* a cmp b terminator */
+    cwToken tokens[3];
+    cw_peek_tokens(cw, tokens, 3);
+    if (tokens[2].type != terminator) return -1;
+
+    uint8_t cmp = cw_register_cmp_op(tokens[0].type);
+    if (cmp == OP_R_MOVE) return -1;
+
+    cwOperand a = { cw->parser->current };
+    cwOperand b = { tokens[1] };
+    if (!cw_operand_check(cw, &a) || !cw_operand_check(cw, &b)) return -1;
+
+    uint8_t mode = (a.constant ? CW_RK_B : 0) | (b.constant ? CW_RK_C : 0);
+    mode |= (cmp - OP_R_EQ) << CW_RK_CMP_SHIFT;
+    uint8_t rk_a = cw_operand_emit(cw, &a);
+    uint8_t rk_b = cw_operand_emit(cw, &b);
+
+    int line = cw->parser->current.line;
+    cw_emit_bytes(cw->parser->chunk, OP_R_BRANCH, mode, line);
+    cw_emit_bytes(cw->parser->chunk, rk_a, rk_b, line);
+    cw_emit_bytes(cw->parser->chunk, 0, 0, line);
+    cw_skip_tokens(cw, 3);
+    return cw->parser->chunk->len - 6;
+#else
+    return -1;
+#endif
+}
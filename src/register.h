@@ -0,0 +1,37 @@
+#ifndef CLOCKWORK_REGISTER_H
+#define CLOCKWORK_REGISTER_H
+
+#include "scanner.h"
+
+/*
+ * Three-address instructions that operate directly on the local slots of 
+ * the current frame. Every operand byte after the mode byte is either a 
+ * slot or a constant index, the mode byte tells which:
+ *
+ *   OP_R_MOVE   mode dst src           slots[dst] = src
+ *   OP_R_<op>   mode dst b c           slots[dst] = b <op> c
+ *   OP_R_BRANCH mode b c offset16      jump forward if (b <cmp> c) is false
+ *
+ * Like every jump, OP_R_BRANCH may carry an OP_WIDE prefix with a 32 bit
+ * offset (see compiler.h).
+ *
+ * For OP_R_BRANCH the comparison is stored in the mode byte as the 
+ * distance of the corresponding OP_R_<cmp> to OP_R_EQ.
+ *
+ * The compiler only emits these when built with CW_REGISTER_VM, otherwise
+ * all code goes through the operand stack.
+ */
+#define CW_RK_B             0x01
+#define CW_RK_C             0x02
+#define CW_RK_CMP_SHIFT     2
+
+#define CW_RK_IS_CONST(mode, bit)   (((mode) & (bit)) != 0)
+#define CW_RK_CMP(mode)             ((mode) >> CW_RK_CMP_SHIFT)
+
+/* tries to compile 'local = a [op b]' up to the terminator (not consumed) */
+bool cw_register_assignment(cwRuntime* cw, cwTokenType terminator);
+
+/* tries to compile 'a cmp b' up to the terminator as branch, returns the jump to patch or -1 */
+int cw_register_condition(cwRuntime* cw, cwTokenType terminator);
+
+#endif /* !CLOCKWORK_REGISTER_H */
@@ -2,51 +2,157 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "debug.h"
 #include "memory.h"
 #include "compiler.h"
+#include "memo.h"
+#include "ops.h"
+#include "program.h"
+#include "register.h"
 
 void cw_init(cwRuntime* cw)
 {
-    cw->chunk = NULL;
-    cw->ip = NULL;
+    cw->parser = NULL;
     cw->objects = NULL;
     cw_table_init(&cw->globals);
     cw_table_init(&cw->strings);
-    cw_reset_stack(cw);
+    cw_table_init(&cw->immutables);
+    cw_table_init(&cw->assigned);
+    cw->declarations = 0;
+    cw->stack_index = 0;
+    cw->frame_count = 0;
+    cw->frame_base = 0;
+    cw->stack_base = 0;
+    cw->memos = NULL;
+    cw->memo_cap = 0;
+    cw->memo_next = 0;
+    cw->jit = cw_jit_new();
+    cw_output_init(&cw->output);
+
+    cw->cache_programs = true;
+    for (int i = 0; i < CW_PROGRAM_CACHE_SIZE; ++i) cw->programs[i] = NULL;
 }
 
 void cw_free(cwRuntime* cw)
 {
+    cw_output_flush(&cw->output);
+    cw_program_cache_free(cw);
     cw_table_free(&cw->strings);
     cw_table_free(&cw->globals);
+    cw_table_free(&cw->immutables);
+    cw_table_free(&cw->assigned);
+    cw_memo_free(cw);
     cw_free_objects(cw);
+    cw_jit_free(cw->jit);
+}
+
+void cw_set_output_fd(cwRuntime* cw, int fd)
+{
+    cw_output_set_fd(&cw->output, fd);
+}
+
+/* --------------------------| calls |-------------------------------------------------- */
+bool cw_call_function(cwRuntime* cw, cwFunction* function, int argc)
+{
+    if (argc != function->arity)
+    {
+        cw_runtime_error(cw, "Expected %d arguments but got %d.", function->arity, argc);
+        return false;
+    }
+
+    cwMemo* memo = NULL;
+    cwString* key = NULL;
+    if (function->memo >= 0 && cw_memo_lookup(cw, function, argc, &memo, &key)) return true;
+
+    if (cw->frame_count >= CW_FRAMES_MAX)
+    {
+        cw_memo_discard(key);
+        cw_runtime_error(cw, "Stack overflow.");
+        return false;
+    }
+
+    cwCallFrame* frame = &cw->frames[cw->frame_count++];
+    frame->function = function;
+    frame->chunk = &function->chunk;
+    frame->ip = function->chunk.bytes;
+    frame->slots = cw->stack + cw->stack_index - argc - 1;
+    frame->memo = memo;
+    frame->memo_key = key;
+    return true;
+}
+
+/* replaces the function of the innermost frame, its window is reused for the arguments */
+static bool cw_tail_call_function(cwRuntime* cw, cwFunction* function, int argc)
+{
+    if (argc != function->arity)
+    {
+        cw_runtime_error(cw, "Expected %d arguments but got %d.", function->arity, argc);
+        return false;
+    }
+
+    /* a pure callee answered from its cache keeps the frame, its result is returned by the OP_RETURN after the call */
+    cwMemo* memo = NULL;
+    cwString* key = NULL;
+    if (function->memo >= 0 && cw_memo_lookup(cw, function, argc, &memo, &key)) return true;
+
+    cwCallFrame* frame = &cw->frames[cw->frame_count - 1];
+    cwValue* callee = cw->stack + cw->stack_index - argc - 1;
+    memmove(frame->slots, callee, (argc + 1) * sizeof(cwValue));
+    cw->stack_index = frame->slots - cw->stack + argc + 1;
+
+    frame->function = function;
+    frame->chunk = &function->chunk;
+    frame->ip = function->chunk.bytes;
+
+    /* both calls return the same result, the frame stores it under the first key it missed with */
+    if (frame->memo_key)
+    {
+        cw_memo_discard(key);
+    }
+    else
+    {
+        frame->memo = memo;
+        frame->memo_key = key;
+    }
+    return true;
+}
+
+bool cw_call_value(cwRuntime* cw, cwValue callee, int argc)
+{
+    if (IS_FUNCTION(callee)) return cw_call_function(cw, AS_FUNCTION(callee), argc);
+    if (IS_NATIVE(callee))   return cw_call_native(cw, AS_NATIVE(callee), argc);
+
+    cw_runtime_error(cw, "Can only call functions.");
+    return false;
+}
+
+bool cw_tail_call_value(cwRuntime* cw, cwValue callee, int argc)
+{
+    if (IS_FUNCTION(callee)) return cw_tail_call_function(cw, AS_FUNCTION(callee), argc);
+    return cw_call_value(cw, callee, argc);
 }
 
-static InterpretResult cw_run(cwRuntime* cw)
+/* --------------------------| execution |---------------------------------------------- */
+/* runs until the frame at index base returns */
+static InterpretResult cw_run(cwRuntime* cw, int base)
 {
-#define READ_BYTE()     (*cw->ip++)
-#define READ_SHORT()    (cw->ip += 2, (uint16_t)((cw->ip[-2] << 8) | cw->ip[-1]))
-#define READ_CONSTANT() (cw->chunk->constants[READ_BYTE()])
-#define BINARY_OP_NUM(op)                                                           \
-        if (!op(&cw->stack[cw->stack_index - 2], &cw->stack[cw->stack_index - 1]))  \
-        {                                                                           \
-            cw_runtime_error(cw, "Operands must be two numbers.");                  \
-            return INTERPRET_RUNTIME_ERROR;                                         \
-        }                                                                           \
-        cw_pop_stack(cw);                                                           \
-        break
-#define BINARY_OP_BOOL(op) {                                                                        \
-        if (!IS_NUMBER(cw_peek_stack(cw, 0)) || !IS_NUMBER(cw_peek_stack(cw, 1)))                   \
-        {                                                                                           \
-            cw_runtime_error(cw, "Operands must be numbers.");                                      \
-            return INTERPRET_RUNTIME_ERROR;                                                         \
-        }                                                                                           \
-        cwValue b = cw_pop_stack(cw);                                                               \
-        cwValue a = cw_pop_stack(cw);                                                               \
-        if (IS_FLOAT(a) || IS_FLOAT(b)) cw_push_stack(cw, MAKE_BOOL(AS_FLOAT(a) op AS_FLOAT(b)));   \
-        else                            cw_push_stack(cw, MAKE_BOOL(AS_INT(a) op AS_INT(b)));       \
+    cwCallFrame* frame = &cw->frames[cw->frame_count - 1];
+
+#define READ_BYTE()     (*frame->ip++)
+#define READ_SHORT()    (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_LONG()     (frame->ip += 4, ((uint32_t)frame->ip[-4] << 24) | ((uint32_t)frame->ip[-3] << 16) | \
+                                         ((uint32_t)frame->ip[-2] << 8) | frame->ip[-1])
+#define READ_CONSTANT() (frame->chunk->constants[READ_BYTE()])
+#define READ_CONSTANT_WIDE() (frame->chunk->constants[READ_SHORT()])
+#define READ_RK(mode, bit) (CW_RK_IS_CONST(mode, bit) ? READ_CONSTANT() : frame->slots[READ_BYTE()])
+#define REGISTER_OP(op) {                                                           \
+        uint8_t mode = READ_BYTE();                                                 \
+        cwValue* dst = &frame->slots[READ_BYTE()];                                  \
+        cwValue a = READ_RK(mode, CW_RK_B);                                         \
+        cwValue b = READ_RK(mode, CW_RK_C);                                         \
+        if (!op) return INTERPRET_RUNTIME_ERROR;                                    \
     } break
 
     while (true)
@@ -60,7 +166,7 @@ static InterpretResult cw_run(cwRuntime* cw)
             printf(" ]");
         }
         printf("\n");
-        cw_disassemble_instruction(cw->chunk, (int)(cw->ip - cw->chunk->bytes));
+        cw_disassemble_instruction(frame->chunk, (int)(frame->ip - frame->chunk->bytes));
 #endif
         uint8_t instruction;
         switch (instruction = READ_BYTE())
@@ -78,156 +184,292 @@ static InterpretResult cw_run(cwRuntime* cw)
             case OP_GET_LOCAL:
             {
                 uint8_t slot = READ_BYTE();
-                cw_push_stack(cw, cw->stack[slot]);
+                cw_push_stack(cw, frame->slots[slot]);
                 break;
             }
             case OP_SET_LOCAL:
             {
                 uint8_t slot = READ_BYTE();
-                cw->stack[slot] = cw_peek_stack(cw, 0);
+                frame->slots[slot] = cw_peek_stack(cw, 0);
                 break;
             }
-            case OP_DEF_GLOBAL:
+            case OP_DEF_GLOBAL: cw_op_def_global(cw, AS_STRING(READ_CONSTANT())); break;
+            case OP_SET_GLOBAL:
+                if (!cw_op_set_global(cw, AS_STRING(READ_CONSTANT()))) return INTERPRET_RUNTIME_ERROR;
+                break;
+            case OP_GET_GLOBAL:
+                if (!cw_op_get_global(cw, AS_STRING(READ_CONSTANT()))) return INTERPRET_RUNTIME_ERROR;
+                break;
+            case OP_INC_LOCAL: case OP_DEC_LOCAL:
+            case OP_ADD_LOCAL: case OP_SUB_LOCAL: case OP_MULT_LOCAL: case OP_DIV_LOCAL:
             {
-                cwString* name = AS_STRING(READ_CONSTANT());
-                cw_table_insert(&cw->globals, name, cw_peek_stack(cw, 0));
-                cw_pop_stack(cw);
+                uint8_t slot = READ_BYTE();
+                if (!cw_inplace_update(cw, &frame->slots[slot], instruction)) return INTERPRET_RUNTIME_ERROR;
                 break;
             }
-            case OP_SET_GLOBAL:
+            case OP_INC_GLOBAL: case OP_DEC_GLOBAL:
+            case OP_ADD_GLOBAL: case OP_SUB_GLOBAL: case OP_MULT_GLOBAL: case OP_DIV_GLOBAL:
+                if (!cw_op_inplace_global(cw, AS_STRING(READ_CONSTANT()), instruction)) return INTERPRET_RUNTIME_ERROR;
+                break;
+            case OP_EQ:       cw_op_equal(cw, true); break;
+            case OP_NOTEQ:    cw_op_equal(cw, false); break;
+            case OP_LT:       if (!cw_op_compare(cw, OP_LT))   return INTERPRET_RUNTIME_ERROR; break;
+            case OP_GT:       if (!cw_op_compare(cw, OP_GT))   return INTERPRET_RUNTIME_ERROR; break;
+            case OP_LTEQ:     if (!cw_op_compare(cw, OP_LTEQ)) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_GTEQ:     if (!cw_op_compare(cw, OP_GTEQ)) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_ADD:      if (!cw_op_add(cw)) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_SUBTRACT: if (!cw_op_arith(cw, cw_value_sub))  return INTERPRET_RUNTIME_ERROR; break;
+            case OP_MULTIPLY: if (!cw_op_arith(cw, cw_value_mult)) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_DIVIDE:   if (!cw_op_arith(cw, cw_value_div))  return INTERPRET_RUNTIME_ERROR; break;
+            case OP_NEGATE:   if (!cw_op_negate(cw)) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_NOT:      cw_push_stack(cw, MAKE_BOOL(cw_is_falsey(cw_pop_stack(cw)))); break;
+            case OP_ARRAY:      if (!cw_array_literal(cw, READ_BYTE())) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_GET_INDEX:  if (!cw_array_get(cw)) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_SET_INDEX:  if (!cw_array_set(cw)) return INTERPRET_RUNTIME_ERROR; break;
+            case OP_JUMP_IF_FALSE:
             {
-                cwString* name = AS_STRING(READ_CONSTANT());
-                if (cw_table_insert(&cw->globals, name, cw_peek_stack(cw, 0)))
-                {
-                    cw_table_remove(&cw->globals, name); 
-                    cw_runtime_error(cw, "Undefined variable '%s'.", name->raw);
-                    return INTERPRET_RUNTIME_ERROR;
-                }
+                uint16_t offset = READ_SHORT();
+                if (cw_is_falsey(cw_peek_stack(cw, 0))) frame->ip += offset;
                 break;
             }
-            case OP_GET_GLOBAL:
+            /* NOTE: combine OP_JUMP and OP_LOOP */
+            case OP_JUMP:
             {
-                cwString* name = AS_STRING(READ_CONSTANT());
-                cwValue* value = cw_table_find(&cw->globals, name);
-                if (!value)
-                {
-                    cw_runtime_error(cw, "Undefined variable '%s'.", name->raw);
-                    return INTERPRET_RUNTIME_ERROR;
-                }
-                cw_push_stack(cw, *value);
+                uint16_t offset = READ_SHORT();
+                frame->ip += offset;
                 break;
             }
-            case OP_EQ: case OP_NOTEQ:
+            case OP_LOOP:
             {
-                cwValue b = cw_pop_stack(cw);
-                cwValue a = cw_pop_stack(cw);
-                bool eq = cw_values_equal(a, b);
-                cw_push_stack(cw, MAKE_BOOL((instruction == OP_EQ ? eq : !eq)));
+                uint16_t offset = READ_SHORT();
+                frame->ip -= offset;
+#if defined(CW_JIT) && !defined(DEBUG_TRACE_EXECUTION)
+                /* the loop ends behind this instruction */
+                if (cw->jit) frame->ip = cw_jit_backedge(cw, frame->function, frame->slots, frame->ip, frame->ip + offset);
+#endif
                 break;
             }
-            case OP_LT:   BINARY_OP_BOOL(<);
-            case OP_GT:   BINARY_OP_BOOL(>);
-            case OP_LTEQ: BINARY_OP_BOOL(<=);
-            case OP_GTEQ: BINARY_OP_BOOL(>=);
-            case OP_ADD:
+            case OP_CALL:
             {
-                if (IS_STRING(cw_peek_stack(cw, 0)) && IS_STRING(cw_peek_stack(cw, 1)))
+                int argc = READ_BYTE();
+                cwValue callee = cw_peek_stack(cw, argc);
+
+                /* natives run in place on their argument window without a frame */
+                if (IS_NATIVE(callee))
                 {
-                    cwString* b = AS_STRING(cw_pop_stack(cw));
-                    cwString* a = AS_STRING(cw_pop_stack(cw));
-                    cw_push_stack(cw, MAKE_OBJECT(cw_str_concat(cw, a, b)));
+                    if (!cw_call_native(cw, AS_NATIVE(callee), argc)) return INTERPRET_RUNTIME_ERROR;
                     break;
                 }
 
-                if (!cw_value_add(&cw->stack[cw->stack_index - 2], &cw->stack[cw->stack_index - 1]))
+                cwCallFrame* caller = frame;
+                if (!cw_call_value(cw, callee, argc)) return INTERPRET_RUNTIME_ERROR;
+                frame = &cw->frames[cw->frame_count - 1];
+
+                /* pure callees answered from their cache push no frame */
+                if (frame == caller) break;
+
+                /* compiled callees run on the C stack and leave their result behind */
+                if (frame->function->compiled)
                 {
-                    cw_runtime_error(cw, "Operands must be two numbers or two strings.");
-                    return INTERPRET_RUNTIME_ERROR;
+                    if (cw_run_frame(cw) != INTERPRET_OK) return INTERPRET_RUNTIME_ERROR;
+                    frame = &cw->frames[cw->frame_count - 1];
                 }
-                cw_pop_stack(cw);
                 break;
             }
-            case OP_SUBTRACT: BINARY_OP_NUM(cw_value_sub);
-            case OP_MULTIPLY: BINARY_OP_NUM(cw_value_mult);
-            case OP_DIVIDE:   BINARY_OP_NUM(cw_value_div);
-            case OP_NEGATE:
+            case OP_TAIL_CALL:
             {
-                if (!IS_NUMBER(cw_peek_stack(cw, 0)))
+                int argc = READ_BYTE();
+                if (!cw_tail_call_value(cw, cw_peek_stack(cw, argc), argc)) return INTERPRET_RUNTIME_ERROR;
+                frame = &cw->frames[cw->frame_count - 1];
+
+                if (frame->function->compiled)
                 {
-                    cw_runtime_error(cw, "Operand must be a number.");
-                    return INTERPRET_RUNTIME_ERROR;
+                    if (cw_run_frame(cw) != INTERPRET_OK) return INTERPRET_RUNTIME_ERROR;
+                    if (cw->frame_count == base) return INTERPRET_OK;
+                    frame = &cw->frames[cw->frame_count - 1];
                 }
-                
-                cwValue val = cw_pop_stack(cw);
-                if (IS_FLOAT(val)) cw_push_stack(cw, MAKE_FLOAT(-AS_FLOAT(val)));
-                else               cw_push_stack(cw, MAKE_INT(-AS_INT(val)));
                 break;
             }
-            case OP_NOT:      cw_push_stack(cw, MAKE_BOOL(cw_is_falsey(cw_pop_stack(cw)))); break;
-            case OP_JUMP_IF_FALSE:
+            case OP_R_MOVE:
             {
-                uint16_t offset = READ_SHORT();
-                if (cw_is_falsey(cw_peek_stack(cw, 0))) cw->ip += offset;
+                uint8_t mode = READ_BYTE();
+                cwValue* dst = &frame->slots[READ_BYTE()];
+                *dst = READ_RK(mode, CW_RK_B);
                 break;
             }
-            /* NOTE: combine OP_JUMP and OP_LOOP */
-            case OP_JUMP:
+            case OP_R_ADD:  REGISTER_OP(cw_op_register_add(cw, dst, a, b));
+            case OP_R_SUB:  REGISTER_OP(cw_op_register_arith(cw, cw_value_sub, dst, a, b));
+            case OP_R_MULT: REGISTER_OP(cw_op_register_arith(cw, cw_value_mult, dst, a, b));
+            case OP_R_DIV:  REGISTER_OP(cw_op_register_arith(cw, cw_value_div, dst, a, b));
+            case OP_R_EQ: case OP_R_NOTEQ:
+            case OP_R_LT: case OP_R_LTEQ:
+            case OP_R_GT: case OP_R_GTEQ:
+                REGISTER_OP(cw_op_register_compare(cw, instruction, dst, a, b));
+            case OP_R_BRANCH:
             {
+                uint8_t mode = READ_BYTE();
+                cwValue a = READ_RK(mode, CW_RK_B);
+                cwValue b = READ_RK(mode, CW_RK_C);
                 uint16_t offset = READ_SHORT();
-                cw->ip += offset;
+
+                bool result;
+                if (!cw_register_compare(cw, OP_R_EQ + CW_RK_CMP(mode), a, b, &result)) return INTERPRET_RUNTIME_ERROR;
+                if (!result) frame->ip += offset;
                 break;
             }
-            case OP_LOOP:
+            case OP_EQ_INT:    case OP_NOTEQ_INT:
+            case OP_LT_INT:    case OP_LTEQ_INT:   case OP_GT_INT:     case OP_GTEQ_INT:
+            case OP_ADD_INT:   case OP_SUB_INT:    case OP_MULT_INT:   case OP_DIV_INT:
+            case OP_LT_FLOAT:  case OP_LTEQ_FLOAT: case OP_GT_FLOAT:   case OP_GTEQ_FLOAT:
+            case OP_ADD_FLOAT: case OP_SUB_FLOAT:  case OP_MULT_FLOAT: case OP_DIV_FLOAT:
+                if (!cw_op_typed(cw, instruction)) return INTERPRET_RUNTIME_ERROR;
+                break;
+            case OP_NOT_BOOL:
+                cw->stack[cw->stack_index - 1] = MAKE_BOOL(!AS_BOOL(cw_peek_stack(cw, 0)));
+                break;
+            case OP_JUMP_IF_FALSE_BOOL:
             {
                 uint16_t offset = READ_SHORT();
-                cw->ip -= offset;
+                if (!AS_BOOL(cw_peek_stack(cw, 0))) frame->ip += offset;
                 break;
             }
-            case OP_PRINT:
-                cw_print_value(cw_pop_stack(cw));
-                printf("\n");
+            case OP_WIDE:
+            {
+                /* the short forms with a 16 bit slot or constant or a 32 bit jump */
+                switch (instruction = READ_BYTE())
+                {
+                    case OP_CONSTANT:   cw_push_stack(cw, READ_CONSTANT_WIDE()); break;
+                    case OP_DEF_GLOBAL: cw_op_def_global(cw, AS_STRING(READ_CONSTANT_WIDE())); break;
+                    case OP_SET_GLOBAL:
+                        if (!cw_op_set_global(cw, AS_STRING(READ_CONSTANT_WIDE()))) return INTERPRET_RUNTIME_ERROR;
+                        break;
+                    case OP_GET_GLOBAL:
+                        if (!cw_op_get_global(cw, AS_STRING(READ_CONSTANT_WIDE()))) return INTERPRET_RUNTIME_ERROR;
+                        break;
+                    case OP_INC_GLOBAL: case OP_DEC_GLOBAL:
+                    case OP_ADD_GLOBAL: case OP_SUB_GLOBAL: case OP_MULT_GLOBAL: case OP_DIV_GLOBAL:
+                        if (!cw_op_inplace_global(cw, AS_STRING(READ_CONSTANT_WIDE()), instruction)) return INTERPRET_RUNTIME_ERROR;
+                        break;
+                    case OP_GET_LOCAL: cw_push_stack(cw, frame->slots[READ_SHORT()]); break;
+                    case OP_SET_LOCAL: frame->slots[READ_SHORT()] = cw_peek_stack(cw, 0); break;
+                    case OP_INC_LOCAL: case OP_DEC_LOCAL:
+                    case OP_ADD_LOCAL: case OP_SUB_LOCAL: case OP_MULT_LOCAL: case OP_DIV_LOCAL:
+                    {
+                        uint16_t slot = READ_SHORT();
+                        if (!cw_inplace_update(cw, &frame->slots[slot], instruction)) return INTERPRET_RUNTIME_ERROR;
+                        break;
+                    }
+                    case OP_JUMP_IF_FALSE:
+                    {
+                        uint32_t offset = READ_LONG();
+                        if (cw_is_falsey(cw_peek_stack(cw, 0))) frame->ip += offset;
+                        break;
+                    }
+                    case OP_JUMP_IF_FALSE_BOOL:
+                    {
+                        uint32_t offset = READ_LONG();
+                        if (!AS_BOOL(cw_peek_stack(cw, 0))) frame->ip += offset;
+                        break;
+                    }
+                    case OP_JUMP:
+                    {
+                        uint32_t offset = READ_LONG();
+                        frame->ip += offset;
+                        break;
+                    }
+                    case OP_LOOP:
+                    {
+                        /* loops this long are left to the interpreter */
+                        uint32_t offset = READ_LONG();
+                        frame->ip -= offset;
+                        break;
+                    }
+                    case OP_R_BRANCH:
+                    {
+                        uint8_t mode = READ_BYTE();
+                        cwValue a = READ_RK(mode, CW_RK_B);
+                        cwValue b = READ_RK(mode, CW_RK_C);
+                        uint32_t offset = READ_LONG();
+
+                        bool result;
+                        if (!cw_register_compare(cw, OP_R_EQ + CW_RK_CMP(mode), a, b, &result)) return INTERPRET_RUNTIME_ERROR;
+                        if (!result) frame->ip += offset;
+                        break;
+                    }
+                }
                 break;
+            }
+            case OP_PRINT: cw_op_print(cw); break;
             case OP_RETURN:
-                return INTERPRET_OK;
+            {
+                cw_op_return(cw);
+                if (cw->frame_count == base) return INTERPRET_OK;
+                frame = &cw->frames[cw->frame_count - 1];
+                break;
+            }
         }
     }
 
-#undef BINARY_OP_NUM
-#undef BINARY_OP_BOOL
+#undef REGISTER_OP
+#undef READ_RK
+#undef READ_CONSTANT_WIDE
 #undef READ_CONSTANT
+#undef READ_LONG
+#undef READ_SHORT
 #undef READ_BYTE
 }
 
 InterpretResult cw_interpret(cwRuntime* cw, const char* src)
 {
-    cwChunk chunk;
-    cw_chunk_init(&chunk);
+    InterpretResult result;
+    if (cw->cache_programs)
+    {
+        const cwProgram* program = cw_program_cached(cw, src);
+        if (!program) return INTERPRET_COMPILE_ERROR;
 
-    InterpretResult result = INTERPRET_COMPILE_ERROR;
-    if (cw_compile(cw, src, &chunk))
+        result = cw_program_run(cw, program);
+    }
+    else
     {
-        cw->chunk = &chunk;
-        cw->ip = cw->chunk->bytes;
+        cwFunction* function = cw_compile(cw, src);
+        if (!function) return INTERPRET_COMPILE_ERROR;
 
-        result = cw_run(cw);
+        result = cw_run_script(cw, function);
     }
 
-    cw_chunk_free(&chunk);
+    cw_output_flush(&cw->output);
     return result;
 }
 
-/* stack operations */
-void  cw_push_stack(cwRuntime* cw, cwValue val)
+InterpretResult cw_run_script(cwRuntime* cw, cwFunction* script)
 {
-    if (cw->stack_index >= CW_STACK_MAX)
+    cw_push_stack(cw, MAKE_OBJECT(script));
+    cw_call_function(cw, script, 0);
+
+    InterpretResult result = cw_run_frame(cw);
+    if (result == INTERPRET_OK) cw_pop_stack(cw);
+    return result;
+}
+
+InterpretResult cw_run_frame(cwRuntime* cw)
+{
+    /* compiled bodies return to run their tail calls from here, the C stack stays flat */
+    while (true)
     {
-        cw_runtime_error(cw, "Stack overflow");
-        return;
-    }
+        cwFunction* function = cw->frames[cw->frame_count - 1].function;
+        if (!function->compiled) return cw_run(cw, cw->frame_count - 1);
 
-    cw->stack[cw->stack_index++] = val;
+        int result = function->compiled(cw);
+        if (result != CW_TAIL_CALLED) return (InterpretResult)result;
+    }
 }
 
-cwValue cw_pop_stack(cwRuntime* cw)         { return cw->stack[--cw->stack_index]; }
-void    cw_reset_stack(cwRuntime* cw)       { cw->stack_index = 0; }
-cwValue cw_peek_stack(cwRuntime* cw, int d) { return cw->stack[cw->stack_index - 1 - d]; }
\ No newline at end of file
+/* stack operations */
+void cw_reset_stack(cwRuntime* cw)
+{
+    /* calls that never returned have no result to cache */
+    for (int i = cw->frame_base; i < cw->frame_count; ++i) cw_memo_discard(cw->frames[i].memo_key);
+
+    cw->stack_index = cw->stack_base;
+    cw->frame_count = cw->frame_base;
+}
\ No newline at end of file
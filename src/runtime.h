@@ -7,12 +7,19 @@
 
 #include "common.h"
 #include "compiler.h"
+#include "debug.h"
+#include "jit.h"
+#include "output.h"
 #include "table.h"
 
 #define DEBUG_PRINT_CODE
 #define DEBUG_TRACE_EXECUTION
 
-#define CW_STACK_MAX 256
+/* room for frames of up to 256 slots and one that uses every slot a function can address */
+#define CW_FRAMES_MAX 64
+#define CW_STACK_MAX (CW_FRAMES_MAX * (UINT8_MAX + 1) + CW_LOCALS_MAX)
+
+#define CW_PROGRAM_CACHE_SIZE 64    /* programs cached by cw_interpret, see program.h */
 
 typedef enum
 {
@@ -21,44 +28,121 @@ typedef enum
     INTERPRET_RUNTIME_ERROR
 } InterpretResult;
 
-struct cwRuntime
+/* 
+ * arguments stay where the caller pushed them and become the first local 
+ * slots of the callee, slot 0 holds the called function itself
+ */
+typedef struct
 {
-    /* Compiler */
+    cwFunction* function;
     cwChunk* chunk;
+    uint8_t* ip;
+    cwValue* slots;
 
-    cwLocal locals[UINT8_MAX + 1];
-    int local_count;
-    int scope_depth;
+    /* cache and key the result is stored under on return, if a pure function missed */
+    cwMemo* memo;
+    cwString* memo_key;
+} cwCallFrame;
 
-    /* Parser */
-    cwToken current;
-    cwToken previous;
-    
-    bool error;
-    bool panic;
+struct cwRuntime
+{
+    /* Compiler, only set while cw_compile runs */
+    cwParser* parser;
 
     /* VM */
-    uint8_t* ip;
+    cwCallFrame frames[CW_FRAMES_MAX];
+    int frame_count;
 
     cwValue stack[CW_STACK_MAX];
     size_t stack_index;
 
+    /* what a runtime error unwinds to, the state on entry of the innermost cw_call */
+    int frame_base;
+    size_t stack_base;
+
     Table globals;
     Table strings;
 
     /* Garbage Collection */
     cwObject* objects;
+
+    /* jit */
+    cwJit* jit;
+
+    /* buffered output of print, see output.h */
+    cwOutput output;
+
+    /* globals known to the compiler, see cwParser */
+    Table immutables;
+    Table assigned;
+
+    /* bumped by every compile that adds to the globals above */
+    uint32_t declarations;
+
+    /* functions go through the optimizing passes of optimize.h when compiled */
+    bool optimize;
+
+    /* result caches of pure functions by their index, see memo.h */
+    cwMemo** memos;
+    int memo_cap;
+
+    /* index of the next function the compiler declares pure */
+    int memo_next;
+
+    /* compiled programs by source hash, used by cw_interpret if enabled */
+    bool cache_programs;
+    cwProgram* programs[CW_PROGRAM_CACHE_SIZE];
 };
 
 void cw_init(cwRuntime* cw);
 void cw_free(cwRuntime* cw);
 
+/* sends the output of print to fd instead of stdout, pending output is flushed first */
+void cw_set_output_fd(cwRuntime* cw, int fd);
+
 InterpretResult cw_interpret(cwRuntime* cw, const char* src);
 
-/* stack operations */
-void    cw_push_stack(cwRuntime* cw, cwValue val);
-cwValue cw_pop_stack(cwRuntime* cw);
-void    cw_reset_stack(cwRuntime* cw);
-cwValue cw_peek_stack(cwRuntime* cw, int distance); /* TODO: make peek return a pointer */
+/*
+ * runs a script returned by cw_compile. compiled functions are never
+ * modified, the same script can run any number of times and on other
+ * runtimes that share the strings of the compiling one (see worker.h).
+ */
+InterpretResult cw_run_script(cwRuntime* cw, cwFunction* script);
+
+/*
+ * pushes a call frame for a callee and its argc arguments on top of the
+ * stack. a pure function answered from its cache leaves the result in
+ * place of its window without a frame.
+ */
+bool cw_call_function(cwRuntime* cw, cwFunction* function, int argc);
+bool cw_call_value(cwRuntime* cw, cwValue callee, int argc);
+
+/*
+ * replaces the innermost frame by a call to callee, see OP_TAIL_CALL. a
+ * native or a pure function answered from its cache leaves the result in
+ * place of its window like cw_call_value and the frame as it was.
+ */
+bool cw_tail_call_value(cwRuntime* cw, cwValue callee, int argc);
+
+/* runs the innermost frame until it returns and leaves its result on the stack */
+InterpretResult cw_run_frame(cwRuntime* cw);
+
+/* stack operations, inline for cw_run and ahead-of-time compiled code */
+static inline void cw_push_stack(cwRuntime* cw, cwValue val)
+{
+    if (cw->stack_index >= CW_STACK_MAX)
+    {
+        cw_runtime_error(cw, "Stack overflow");
+        return;
+    }
+
+    cw->stack[cw->stack_index++] = val;
+}
+
+static inline cwValue cw_pop_stack(cwRuntime* cw)         { return cw->stack[--cw->stack_index]; }
+static inline cwValue cw_peek_stack(cwRuntime* cw, int d) { return cw->stack[cw->stack_index - 1 - d]; } /* TODO: make peek return a pointer */
+
+/* drops the frames and values above frame_base and stack_base */
+void cw_reset_stack(cwRuntime* cw);
 
 #endif /* !CW_RUNTIME_H */
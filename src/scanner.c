@@ -5,66 +5,176 @@
 
 #include <string.h>
 
+/* sse2 is part of x86-64 */
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define CW_SCANNER_SIMD
+#endif
+
 static inline bool cw_isdigit(char c) { return c >= '0' && c <= '9'; }
 static inline bool cw_isalpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
 
-static const char* cw_skip_whitespaces(const char* cursor, int* line)
+/* --------------------------| classification |----------------------------------------- */
+#ifdef CW_SCANNER_SIMD
+/*
+ * the source is scanned in aligned blocks of 16 bytes. an aligned block never
+ * crosses a page, reading past the terminating nul inside the last block is
+ * safe even though it is outside of the string.
+ */
+#define CW_BLOCK 16
+
+__attribute__((no_sanitize_address))
+static inline __m128i cw_load_block(const char* block) { return _mm_load_si128((const __m128i*)block); }
+
+/* mask of the bytes from offset to the end of a block */
+static inline unsigned cw_block_from(unsigned offset) { return (0xffffu << offset) & 0xffffu; }
+
+static inline __m128i cw_byte_eq(__m128i v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+
+static inline unsigned cw_mask_whitespace(__m128i v)
+{
+    __m128i blank = _mm_or_si128(cw_byte_eq(v, ' '), cw_byte_eq(v, '\t'));
+    __m128i line  = _mm_or_si128(cw_byte_eq(v, '\n'), cw_byte_eq(v, '\r'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(blank, line));
+}
+
+/* the first byte from cursor on that is no whitespace, newlines are counted in line */
+static const char* cw_skip_blanks(const char* cursor, int* line)
 {
-    while (*cursor != '\0')
+    for (;;)
+    {
+        const char* block = (const char*)((uintptr_t)cursor & ~(uintptr_t)(CW_BLOCK - 1));
+        unsigned offset = (unsigned)(cursor - block);
+        __m128i v = cw_load_block(block);
+        unsigned from = cw_block_from(offset);
+        unsigned stop = ~cw_mask_whitespace(v) & from;
+        unsigned lines = (unsigned)_mm_movemask_epi8(cw_byte_eq(v, '\n')) & from;
+        if (stop)
+        {
+            *line += __builtin_popcount(lines & ((1u << __builtin_ctz(stop)) - 1));
+            return block + __builtin_ctz(stop);
+        }
+
+        *line += __builtin_popcount(lines);
+        cursor = block + CW_BLOCK;
+    }
+}
+
+/* the newline or nul that ends the comment at cursor */
+static const char* cw_skip_comment(const char* cursor)
+{
+    for (;;)
+    {
+        const char* block = (const char*)((uintptr_t)cursor & ~(uintptr_t)(CW_BLOCK - 1));
+        unsigned offset = (unsigned)(cursor - block);
+        __m128i v = cw_load_block(block);
+        unsigned stop = (unsigned)_mm_movemask_epi8(_mm_or_si128(cw_byte_eq(v, '\n'), cw_byte_eq(v, '\0')));
+        stop &= cw_block_from(offset);
+        if (stop) return block + __builtin_ctz(stop);
+        cursor = block + CW_BLOCK;
+    }
+}
+
+/* the closing quote, newline or nul of the string at cursor */
+static const char* cw_skip_string(const char* cursor)
+{
+    for (;;)
+    {
+        const char* block = (const char*)((uintptr_t)cursor & ~(uintptr_t)(CW_BLOCK - 1));
+        unsigned offset = (unsigned)(cursor - block);
+        __m128i v = cw_load_block(block);
+        __m128i end = _mm_or_si128(cw_byte_eq(v, '"'), _mm_or_si128(cw_byte_eq(v, '\n'), cw_byte_eq(v, '\0')));
+        unsigned stop = (unsigned)_mm_movemask_epi8(end) & cw_block_from(offset);
+        if (stop) return block + __builtin_ctz(stop);
+        cursor = block + CW_BLOCK;
+    }
+}
+#else
+static const char* cw_skip_blanks(const char* cursor, int* line)
+{
+    for (;; cursor++)
     {
         switch (*cursor)
         {
         case '\n':
             (*line)++;
         case ' ': case '\t': case '\r':
-            cursor++;
-            break;
-        case '#':   /* skip comments */
-            while (*cursor != '\0' && *cursor != '\n') cursor++;
             break;
         default:
             return cursor;
         }
     }
+}
+
+static const char* cw_skip_comment(const char* cursor)
+{
+    while (*cursor != '\0' && *cursor != '\n') cursor++;
     return cursor;
 }
 
-static cwTokenType cw_check_keyword(const char* start, const char* stream, int offset, const char* rest, cwTokenType type)
+static const char* cw_skip_string(const char* cursor)
 {
-    int rest_len = strlen(rest);
-    if ((stream - start) == offset + rest_len && memcmp(start + offset, rest, rest_len) == 0) return type;
-    return TOKEN_IDENTIFIER;
+    while (*cursor != '"' && *cursor != '\0' && *cursor != '\n') cursor++;
+    return cursor;
 }
+#endif
 
-static cwTokenType cw_identifier_type(const char* start, const char* stream)
+static const char* cw_skip_whitespaces(const char* cursor, int* line)
 {
-    switch (start[0])
+    /* most tokens are separated by a single space or none at all */
+    if (*cursor == ' ') cursor++;
+
+    for (;;)
     {
-    case 'b': return cw_check_keyword(start, stream, 1, "reak", TOKEN_BREAK);
-    case 'c': return cw_check_keyword(start, stream, 1, "ontinue", TOKEN_CONTINUE);
-    case 'd': return cw_check_keyword(start, stream, 1, "atatype", TOKEN_DATATYPE);
-    case 'e': return cw_check_keyword(start, stream, 1, "lse", TOKEN_ELSE);
-    case 'i': return cw_check_keyword(start, stream, 1, "f", TOKEN_IF);
-    case 'f':
-        if (stream - start > 1)
-        {
-            switch (start[1])
-            {
-            case 'a': return cw_check_keyword(start, stream, 2, "lse", TOKEN_FALSE);
-            case 'o': return cw_check_keyword(start, stream, 2, "r", TOKEN_FOR);
-            case 'u': return cw_check_keyword(start, stream, 2, "nction", TOKEN_FUNC);
-            }
-        }
-        break;
-    case 'l': return cw_check_keyword(start, stream, 1, "et", TOKEN_LET);
-    case 'm': return cw_check_keyword(start, stream, 1, "ut", TOKEN_MUT);
-    case 'n': return cw_check_keyword(start, stream, 1, "ull", TOKEN_NULL);
-    case 'p': return cw_check_keyword(start, stream, 1, "rint", TOKEN_PRINT);
-    case 'r': return cw_check_keyword(start, stream, 1, "eturn", TOKEN_RETURN);
-    case 't': return cw_check_keyword(start, stream, 1, "rue", TOKEN_RETURN);
-    case 'w': return cw_check_keyword(start, stream, 1, "hile", TOKEN_WHILE);
+        if (*cursor > ' ' && *cursor != '#') return cursor;
+        cursor = cw_skip_blanks(cursor, line);
+        if (*cursor != '#') return cursor;
+        cursor = cw_skip_comment(cursor);
     }
+}
+
+static uint32_t cw_hash_range(const char* start, const char* end)
+{
+    uint32_t hash = CW_HASH_SEED;
+    while (start < end) hash = cw_hash_byte(hash, *start++);
+    return hash;
+}
 
+/* --------------------------| keywords |----------------------------------------------- */
+typedef struct
+{
+    const char* name;
+    size_t len;
+    cwTokenType type;
+} cwKeyword;
+
+/* keywords by the low six bits of their hash, each keyword has a slot of its own */
+#define CW_KEYWORD_MASK 63
+
+static const cwKeyword cw_keywords[CW_KEYWORD_MASK + 1] = {
+    [4]  = { "continue", 8, TOKEN_CONTINUE },
+    [6]  = { "if",       2, TOKEN_IF },
+    [8]  = { "print",    5, TOKEN_PRINT },
+    [9]  = { "function", 8, TOKEN_FUNC },
+    [14] = { "while",    5, TOKEN_WHILE },
+    [16] = { "for",      3, TOKEN_FOR },
+    [24] = { "false",    5, TOKEN_FALSE },
+    [35] = { "pure",     4, TOKEN_PURE },
+    [36] = { "null",     4, TOKEN_NULL },
+    [37] = { "true",     4, TOKEN_TRUE },
+    [45] = { "datatype", 8, TOKEN_DATATYPE },
+    [48] = { "else",     4, TOKEN_ELSE },
+    [56] = { "break",    5, TOKEN_BREAK },
+    [57] = { "mut",      3, TOKEN_MUT },
+    [58] = { "let",      3, TOKEN_LET },
+    [63] = { "return",   6, TOKEN_RETURN },
+};
+
+static cwTokenType cw_identifier_type(const char* start, const char* end, uint32_t hash)
+{
+    const cwKeyword* keyword = &cw_keywords[hash & CW_KEYWORD_MASK];
+    size_t len = (size_t)(end - start);
+    if (keyword->len == len && memcmp(start, keyword->name, len) == 0) return keyword->type;
     return TOKEN_IDENTIFIER;
 }
 
@@ -85,6 +195,7 @@ const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int
 
     token->mod = TOKENMOD_NONE;
     token->line = line;
+    token->hash = 0;
     token->start = cursor; 
 
     switch (*cursor)
@@ -113,23 +224,24 @@ const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int
     case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
     case '_':
     {
-        cursor++;
-        while (cw_isalpha(*cursor) || cw_isdigit(*cursor)) cursor++;
-        token->type = cw_identifier_type(token->start, cursor);
+        /* the hash has to visit every byte anyway, it is computed while the run is classified */
+        uint32_t hash = CW_HASH_SEED;
+        while (cw_isalpha(*cursor) || cw_isdigit(*cursor)) hash = cw_hash_byte(hash, *cursor++);
+        token->hash = hash;
+        token->type = cw_identifier_type(token->start, cursor, token->hash);
         break;
     }
     case '"':
     {
-        cursor++; /* skip the opening quote */
-        while (*cursor != '"')
+        cursor = cw_skip_string(cursor + 1);   /* skip the opening quote */
+
+        if (*cursor != '"')
         {
-            if (*cursor == '\0' || *cursor == '\n')
-            {
-                cw_syntax_error(cw, line, "Unterminated string.");
-                return cursor;
-            }
-            cursor++;
+            token->type = TOKEN_ERROR;
+            if (cw) cw_scan_error(cw, token);
+            break;
         }
+        token->hash = cw_hash_range(token->start + 1, cursor);
         cursor++; /* skip the closing quote */
 
         token->type = TOKEN_STRING;
@@ -156,8 +268,10 @@ const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int
     CW_TOKEN_CASE2('<', TOKEN_LT,           '=', TOKEN_LTEQ)
     CW_TOKEN_CASE2('>', TOKEN_GT,           '=', TOKEN_GTEQ)
     default:
-        cw_syntax_error(cw, line, "Unexpected character.");
-        return ++cursor;
+        token->type = TOKEN_ERROR;
+        cursor++;
+        if (cw) cw_scan_error(cw, token);
+        break;
     }
 
     token->end = cursor;
@@ -168,6 +282,12 @@ const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int
 #undef CW_TOKEN_CASE3
 }
 
+void cw_scan_error(cwRuntime* cw, const cwToken* token)
+{
+    if (*token->start == '"') cw_syntax_error(cw, token->line, "Unterminated string.");
+    else                      cw_syntax_error(cw, token->line, "Unexpected character.");
+}
+
 int cw_token_get_base(const cwToken* token)
 {
     switch (token->mod)
@@ -6,6 +6,7 @@
 typedef enum
 {
     TOKEN_EOF = 0,
+    TOKEN_ERROR,
     /* single-character tokens */
     TOKEN_LPAREN,   TOKEN_RPAREN,
     TOKEN_LBRACE,   TOKEN_RBRACE,
@@ -56,6 +57,7 @@ typedef enum
     TOKEN_LET,
     TOKEN_MUT,
     TOKEN_FUNC,
+    TOKEN_PURE,
     TOKEN_DATATYPE,
     TOKEN_RETURN,
     TOKEN_PRINT
@@ -76,10 +78,17 @@ struct cwToken
     const char* start;
     const char* end;
     int line;
+
+    /* cw_hash_str of identifiers and of the contents of strings */
+    uint32_t hash;
 };
 
+/* scans the token starting at cursor, errors are only reported if cw is not NULL */
 const char* cw_scan_token(cwRuntime* cw, cwToken* token, const char* cursor, int line);
 
+/* reports the syntax error of a TOKEN_ERROR token */
+void cw_scan_error(cwRuntime* cw, const cwToken* token);
+
 int cw_token_get_base(const cwToken* token);
 
 #endif /* !CLOCKWORK_SCANNER_H */
\ No newline at end of file
@@ -3,81 +3,349 @@
 #include "parser.h"
 
 #include "debug.h"
+#include "register.h"
 #include "runtime.h"
 
+#include <string.h>
+
 /* --------------------------| declarations |-------------------------------------------- */
-static void cw_parse_decl_var(cwRuntime* cw, bool mut)
+static inline void cw_begin_scope(cwRuntime* cw) { cw->parser->compiler->scope_depth++; }
+static inline void cw_end_scope(cwRuntime* cw)
+{ 
+    cwCompiler* compiler = cw->parser->compiler;
+    compiler->scope_depth--;
+
+    /* pop locals */
+    while (compiler->local_count > 0 && compiler->locals[compiler->local_count - 1].depth > compiler->scope_depth)
+    {
+        cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line);
+        cw_pop_local(cw);
+    }
+}
+
+/* declares the previous token as variable and returns its global name constant */
+static int cw_declare_variable(cwRuntime* cw)
 {
-    /* parse variable name */
-    cw_consume(cw, TOKEN_IDENTIFIER, "Expect variable name.");
+    cwCompiler* compiler = cw->parser->compiler;
+    if (compiler->scope_depth <= 0) return cw_identifier_constant(cw, &cw->parser->previous);
 
-    /* declare variable */
-    if (cw->scope_depth > 0)
+    /* the innermost local of that name, declarations in outer scopes are shadowed */
+    cwToken* name = &cw->parser->previous;
+    int i = cw_find_local(compiler, name);
+    if (i >= 0 && (compiler->locals[i].depth == -1 || compiler->locals[i].depth >= compiler->scope_depth))
+        cw_syntax_error_at(cw, &cw->parser->previous, "Already a variable with this name in this scope.");
+
+    cw_add_local(cw, name);
+    return 0;
+}
+
+static void cw_define_variable(cwRuntime* cw, int id)
+{
+    cwCompiler* compiler = cw->parser->compiler;
+    if (compiler->scope_depth > 0)
+        compiler->locals[compiler->local_count - 1].depth = compiler->scope_depth; /* mark initialized */
+    else
+        cw_emit_arg(cw->parser->chunk, OP_DEF_GLOBAL, id, cw->parser->previous.line);
+}
+
+/* records the mutability of the variable declared last, value is the literal it is bound to or null */
+static void cw_bind_variable(cwRuntime* cw, cwToken* token, int id, bool mut, cwValue value)
+{
+    cwCompiler* compiler = cw->parser->compiler;
+    if (compiler->scope_depth > 0)
     {
-        cwToken* name = &cw->previous;
-        for (int i = cw->local_count - 1; i >= 0; i--)
-        {
-            cwLocal* local = &cw->locals[i];
-            if (local->depth != -1 && local->depth < cw->scope_depth) break;
+        cwLocal* local = &compiler->locals[compiler->local_count - 1];
+        local->mut = mut;
+        local->known = !mut && !IS_NULL(value);
+        local->value = value;
+        return;
+    }
 
-            if (cw_identifiers_equal(name, &local->name))
-                cw_syntax_error_at(cw, &cw->previous, "Already a variable with this name in this scope.");
-        }
+    cwString* name = AS_STRING(cw->parser->chunk->constants[id]);
+    cw_table_insert(&cw->parser->declared, name, MAKE_NULL());
+
+    /* an immutable global has a single declaration, which comes before every assignment */
+    if (cw_table_find(&cw->parser->immutables, name))
+        cw_syntax_error_at(cw, token, "Already an immutable variable with this name.");
+    else if (!mut && cw_table_find(&cw->parser->assigned, name))
+        cw_syntax_error_at(cw, token, "Can not declare an assigned variable immutable.");
+    else if (!mut)
+        cw_table_insert(&cw->parser->immutables, name, value);
+}
 
-        cw_add_local(cw, name);
+/* the value of the code emitted since start if it is a single literal, null otherwise */
+static cwValue cw_literal_value(cwRuntime* cw, int start)
+{
+    const cwChunk* chunk = cw->parser->chunk;
+    if (start >= (int)chunk->len || start + cw_op_length(chunk->bytes + start) != (int)chunk->len) return MAKE_NULL();
+
+    const uint8_t* ip = chunk->bytes + start;
+    switch (ip[ip[0] == OP_WIDE])
+    {
+    case OP_CONSTANT: return chunk->constants[cw_op_arg(ip)];
+    case OP_TRUE:     return MAKE_BOOL(true);
+    case OP_FALSE:    return MAKE_BOOL(false);
+    default:          return MAKE_NULL();
     }
-    
-    uint8_t id = (cw->scope_depth <= 0) ? cw_identifier_constant(cw, &cw->previous) : 0;
+}
+
+static void cw_parse_decl_var(cwRuntime* cw, bool mut)
+{
+    /* parse variable name */
+    cw_consume(cw, TOKEN_IDENTIFIER, "Expect variable name.");
+    cwToken name = cw->parser->previous;
+    int id = cw_declare_variable(cw);
 
     /* parse variable initialization value */
+    int start = cw->parser->chunk->len;
     if (cw_match(cw, TOKEN_ASSIGN)) cw_parse_expression(cw);
-    else                            cw_syntax_error_at(cw, &cw->previous, "Undefined variable.");
+    else                            cw_syntax_error_at(cw, &cw->parser->previous, "Undefined variable.");
+    cw_bind_variable(cw, &name, id, mut, cw_literal_value(cw, start));
 
     /* define variable */
     cw_consume(cw, TOKEN_SEMICOLON, "Expect terminator after var declaration.");
-    if (cw->scope_depth > 0)
-        cw->locals[cw->local_count - 1].depth = cw->scope_depth; /* mark initialized */
-    else
-        cw_emit_bytes(cw->chunk, OP_DEF_GLOBAL, id, cw->previous.line);
+    cw_define_variable(cw, id);
+}
+
+static void cw_parse_decl_func(cwRuntime* cw, bool pure)
+{
+    cw_consume(cw, TOKEN_IDENTIFIER, "Expect function name.");
+    int id = cw_declare_variable(cw);
+    cw_bind_variable(cw, &cw->parser->previous, id, false, MAKE_NULL());
+
+    /* locals can be referenced in their own body for recursion */
+    if (cw->parser->compiler->scope_depth > 0)
+        cw->parser->compiler->locals[cw->parser->compiler->local_count - 1].depth = cw->parser->compiler->scope_depth;
+
+    cwCompiler compiler;
+    cw_compiler_init(cw, &compiler, FUNC_FUNCTION);
+    cw_begin_scope(cw);
+
+    /* calls of pure functions are answered from a cache of their results (see memo.h) */
+    if (pure) compiler.function->memo = cw->memo_next++;
+
+    /* parameters are the first locals of the callee */
+    cw_consume(cw, TOKEN_LPAREN, "Expect '(' after function name.");
+    if (cw->parser->current.type != TOKEN_RPAREN)
+    {
+        do
+        {
+            if (++compiler.function->arity > UINT8_MAX)
+                cw_syntax_error_at(cw, &cw->parser->current, "Can not have more than 255 parameters.");
+
+            cw_consume(cw, TOKEN_IDENTIFIER, "Expect parameter name.");
+            cw_declare_variable(cw);
+            cw_define_variable(cw, 0);
+        } while (cw_match(cw, TOKEN_COMMA));
+    }
+    cw_consume(cw, TOKEN_RPAREN, "Expect ')' after parameters.");
+
+    /* the frame is discarded on return, so the scope is never closed */
+    cw_consume(cw, TOKEN_LBRACE, "Expect '{' before function body.");
+    while (cw->parser->current.type != TOKEN_RBRACE && cw->parser->current.type != TOKEN_EOF)
+        cw_parse_declaration(cw);
+    cw_consume(cw, TOKEN_RBRACE, "Expect '}' after function body.");
+
+    cwFunction* function = cw_compiler_end(cw);
+    cw_emit_arg(cw->parser->chunk, OP_CONSTANT, cw_make_constant(cw, MAKE_OBJECT(function)), cw->parser->previous.line);
+
+    if (cw->parser->compiler->scope_depth > 0) return;
+    cw_emit_arg(cw->parser->chunk, OP_DEF_GLOBAL, id, cw->parser->previous.line);
+
+    /* later calls can be inlined (see inline.h) */
+    cw_table_insert(&cw->parser->declared, AS_STRING(cw->parser->chunk->constants[id]), MAKE_OBJECT(function));
 }
 
 int cw_parse_declaration(cwRuntime* cw)
 {
-    if (cw_match(cw, TOKEN_LET))    cw_parse_decl_var(cw, false);
-    if (cw_match(cw, TOKEN_MUT))    cw_parse_decl_var(cw, true);
-    else                            cw_parse_statement(cw); 
+    cw->parser->compiler->stmt_start = cw->parser->chunk->len;
+    if (cw_match(cw, TOKEN_LET))        cw_parse_decl_var(cw, false);
+    else if (cw_match(cw, TOKEN_MUT))   cw_parse_decl_var(cw, true);
+    else if (cw_match(cw, TOKEN_FUNC))  cw_parse_decl_func(cw, false);
+    else if (cw_match(cw, TOKEN_PURE))
+    {
+        cw_consume(cw, TOKEN_FUNC, "Expect 'function' after 'pure'.");
+        cw_parse_decl_func(cw, true);
+    }
+    else                                cw_parse_statement(cw); 
 
-    if (cw->panic) cw_parser_synchronize(cw);
+    if (cw->parser->panic) cw_parser_synchronize(cw);
 
     return 1;
 }
 
+/* --------------------------| loop invariants |----------------------------------------- */
+/*
+ * globals a loop reads are loaded once into hidden locals in front of it,
+ * the locals of the loop move up behind them. globals the loop writes stay
+ * globals, a runtime error inside the loop would leave them stale otherwise.
+ * without calls nothing else gets to write a global while the loop runs,
+ * otherwise only let globals are loaded. only globals that are defined by
+ * the time the loop runs qualify, so the loads never fail where the loop
+ * would not have.
+ */
+#define CW_HOIST_MAX 16
+
+typedef struct
+{
+    cwString* name;
+    int constant;       /* name constant of the first access */
+} cwHoisted;
+
+static bool cw_is_inplace_global(uint8_t op)
+{
+    return op >= OP_INC_LOCAL && op <= OP_DIV_GLOBAL && (op - OP_INC_LOCAL) % 2 == 1;
+}
+
+static int cw_hoist_find(const cwHoisted* hoisted, int count, const cwString* name)
+{
+    for (int i = 0; i < count; ++i)
+        if (hoisted[i].name == name) return i;
+    return -1;
+}
+
+/* hoists the globals of the loop compiled from begin to the end of the code, the stack is at the local count in front of it */
+static void cw_hoist_globals(cwRuntime* cw, int begin)
+{
+    cwParser* parser = cw->parser;
+    cwChunk* chunk = parser->chunk;
+    int base = parser->compiler->local_count;
+    int end = chunk->len;
+
+    bool calls = false;
+    for (int at = begin; at < end; at += cw_op_length(chunk->bytes + at))
+    {
+        uint8_t op = chunk->bytes[at + (chunk->bytes[at] == OP_WIDE)];
+        if (op == OP_DEF_GLOBAL) return;
+        calls |= op == OP_CALL || op == OP_TAIL_CALL;
+    }
+
+    /* the globals the loop writes first, they are left alone */
+    cwHoisted written[CW_HOIST_MAX];
+    int written_count = 0;
+    for (int at = begin; at < end; at += cw_op_length(chunk->bytes + at))
+    {
+        uint8_t op = chunk->bytes[at + (chunk->bytes[at] == OP_WIDE)];
+        if (op != OP_SET_GLOBAL && !cw_is_inplace_global(op)) continue;
+
+        int constant = cw_op_arg(chunk->bytes + at);
+        cwString* name = AS_STRING(chunk->constants[constant]);
+        if (cw_hoist_find(written, written_count, name) >= 0) continue;
+        if (written_count == CW_HOIST_MAX) return;
+        written[written_count++] = (cwHoisted){ name, constant };
+    }
+
+    cwHoisted hoisted[CW_HOIST_MAX];
+    int count = 0;
+    for (int at = begin; at < end && count < CW_HOIST_MAX; at += cw_op_length(chunk->bytes + at))
+    {
+        /* a name has a single constant, when it is wide every read of it is left alone */
+        if (chunk->bytes[at] != OP_GET_GLOBAL) continue;
+
+        uint8_t constant = chunk->bytes[at + 1];
+        cwString* name = AS_STRING(chunk->constants[constant]);
+        if (cw_hoist_find(hoisted, count, name) >= 0 || cw_hoist_find(written, written_count, name) >= 0) continue;
+        if (!cw_table_find(&parser->declared, name) && !cw_table_find(&cw->globals, name)) continue;
+        if (calls && !cw_table_find(&parser->immutables, name)) continue;
+
+        hoisted[count++] = (cwHoisted){ name, constant };
+    }
+
+    if (count == 0 || base + count > UINT8_MAX + 1 || !cw_shift_slots(chunk, begin, end, base, count, false)) return;
+    cw_shift_slots(chunk, begin, end, base, count, true);
+
+    for (int at = begin; at < end; at += cw_op_length(chunk->bytes + at))
+    {
+        if (chunk->bytes[at] != OP_GET_GLOBAL) continue;
+
+        int i = cw_hoist_find(hoisted, count, AS_STRING(chunk->constants[chunk->bytes[at + 1]]));
+        if (i < 0) continue;
+
+        chunk->bytes[at] = OP_GET_LOCAL;
+        chunk->bytes[at + 1] = (uint8_t)(base + i);
+    }
+
+    /* the loads go in front, jumps within the loop keep their distance */
+    int size = 2 * count;
+    int line = chunk->lines[begin];
+    for (int i = 0; i < size; ++i) cw_emit_byte(chunk, 0, line);
+    memmove(chunk->bytes + begin + size, chunk->bytes + begin, end - begin);
+    memmove(chunk->lines + begin + size, chunk->lines + begin, (end - begin) * sizeof(int));
+    for (int i = 0; i < count; ++i)
+    {
+        chunk->bytes[begin + 2 * i] = OP_GET_GLOBAL;
+        chunk->bytes[begin + 2 * i + 1] = (uint8_t)hoisted[i].constant;
+        chunk->lines[begin + 2 * i] = line;
+        chunk->lines[begin + 2 * i + 1] = line;
+    }
+
+    int* offsets[] = { &parser->inplace_start, &parser->inplace_end, &parser->inplace_value, &parser->compiler->last_call };
+    for (int i = 0; i < 4; ++i)
+        if (*offsets[i] >= begin) *offsets[i] += size;
+
+    /* the hidden locals are on top */
+    for (int i = 0; i < count; ++i) cw_emit_byte(chunk, OP_POP, parser->previous.line);
+}
+
 /* --------------------------| statements |---------------------------------------------- */
-static inline void cw_begin_scope(cwRuntime* cw) { cw->scope_depth++; }
-static inline void cw_end_scope(cwRuntime* cw)
-{ 
-    cw->scope_depth--;
+/* 
+ * drops the value read-back of an in-place update that makes up the whole 
+ * expression, so that statements like 'i++;' do not touch the stack at all
+ */
+static bool cw_drop_inplace_value(cwRuntime* cw, int start)
+{
+    if (cw->parser->inplace_start != start || cw->parser->inplace_end != cw->parser->chunk->len) return false;
 
-    /* pop locals */
-    while (cw->local_count > 0 && cw->locals[cw->local_count - 1].depth > cw->scope_depth)
+    cwChunk* chunk = cw->parser->chunk;
+    int value = cw->parser->inplace_value;
+    int len = cw_op_length(chunk->bytes + value);
+    memmove(chunk->bytes + value, chunk->bytes + value + len, chunk->len - value - len);
+    memmove(chunk->lines + value, chunk->lines + value + len, (chunk->len - value - len) * sizeof(int));
+    chunk->len -= len;
+
+    cw->parser->inplace_start = -1;
+    return true;
+}
+
+/* compiles an expression whose value is not used, up to the terminator (not consumed) */
+static void cw_parse_discarded_expr(cwRuntime* cw, cwTokenType terminator)
+{
+    if (cw_register_assignment(cw, terminator)) return;
+
+    int start = cw->parser->chunk->len;
+    cw->parser->inplace_start = -1;
+
+    cw_parse_expression(cw);
+    if (cw->parser->current.type == terminator && cw_drop_inplace_value(cw, start)) return;
+
+    cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line);
+}
+
+/* compiles a condition and the jump taken if it is false, pushed tells if the condition is left on the stack */
+static int cw_parse_condition(cwRuntime* cw, cwTokenType terminator, bool* pushed)
+{
+    int jump = cw_register_condition(cw, terminator);
+    *pushed = jump < 0;
+    if (*pushed)
     {
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
-        cw->local_count--;
+        cw_parse_expression(cw);
+        jump = cw_emit_jump(cw->parser->chunk, OP_JUMP_IF_FALSE, cw->parser->previous.line);
+        cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line);
     }
+    return jump;
 }
 
 static int cw_parse_stmt_expr(cwRuntime* cw)
 {
-    cw_parse_expression(cw);
+    cw_parse_discarded_expr(cw, TOKEN_SEMICOLON);
     cw_consume(cw, TOKEN_SEMICOLON, "Expect terminator after expression.");
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
 }
 
 static int cw_parse_stmt_block(cwRuntime* cw)
 {
     cw_begin_scope(cw);
 
-    while (cw->current.type != TOKEN_RBRACE && cw->current.type != TOKEN_EOF)
+    while (cw->parser->current.type != TOKEN_RBRACE && cw->parser->current.type != TOKEN_EOF)
         cw_parse_declaration(cw);
 
     cw_consume(cw, TOKEN_RBRACE, "Expect '}' after block.");
@@ -86,18 +354,18 @@ static int cw_parse_stmt_block(cwRuntime* cw)
 
 static int cw_parse_stmt_if(cwRuntime* cw)
 {
+    bool pushed;
     cw_consume(cw, TOKEN_LPAREN, "Expect '(' after 'if'.");
-    cw_parse_expression(cw);
+    int then_jump = cw_parse_condition(cw, TOKEN_RPAREN, &pushed);
     cw_consume(cw, TOKEN_RPAREN, "Expect ')' after condition.");
 
-    int then_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
     cw_parse_statement(cw);
 
-    int else_jump = cw_emit_jump(cw->chunk, OP_JUMP, cw->previous.line);
+    int else_jump = cw_emit_jump(cw->parser->chunk, OP_JUMP, cw->parser->previous.line);
 
-    cw_patch_jump(cw, then_jump);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+    /* widening the then jump moves the else jump right behind it */
+    else_jump += cw_patch_jump(cw, then_jump);
+    if (pushed) cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line);
 
     if (cw_match(cw, TOKEN_ELSE)) cw_parse_statement(cw);
     cw_patch_jump(cw, else_jump);
@@ -107,19 +375,19 @@ static int cw_parse_stmt_if(cwRuntime* cw)
 
 static int cw_parse_stmt_while(cwRuntime* cw)
 {
-    int loop_start = cw->chunk->len;
+    int loop_start = cw->parser->chunk->len;
 
+    bool pushed;
     cw_consume(cw, TOKEN_LPAREN, "Expect '(' after 'while'.");
-    cw_parse_expression(cw);
+    int exit_jump = cw_parse_condition(cw, TOKEN_RPAREN, &pushed);
     cw_consume(cw, TOKEN_RPAREN, "Expect ')' after condition.");
 
-    int exit_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
     cw_parse_statement(cw);
     cw_emit_loop(cw, loop_start);
 
     cw_patch_jump(cw, exit_jump);
-    cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+    if (pushed) cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line);
+    cw_hoist_globals(cw, loop_start);
 }
 
 /* NOTE: maybe switch to "for x in ..." notation */
@@ -134,64 +402,90 @@ static int cw_parse_stmt_for(cwRuntime* cw)
     else if (cw_match(cw, TOKEN_MUT))   cw_parse_decl_var(cw, true);
     else                                cw_parse_stmt_expr(cw);
 
-    int loop_start = cw->chunk->len;
+    int begin = cw->parser->chunk->len;
+    int loop_start = begin;
+    cw->parser->compiler->stmt_start = begin;   /* the initializer is done, its local is on the stack */
 
-    /* condition clause. */
+    /* condition clause, jump out of the loop if the condition is false. */
     int exit_jump = -1;
+    bool pushed = false;
     if (!cw_match(cw, TOKEN_SEMICOLON))
     {
-        cw_parse_expression(cw);
+        exit_jump = cw_parse_condition(cw, TOKEN_SEMICOLON, &pushed);
         cw_consume(cw, TOKEN_SEMICOLON, "Expect ';' after loop condition.");
-
-        /* jump out of the loop if the condition is false. */
-        exit_jump = cw_emit_jump(cw->chunk, OP_JUMP_IF_FALSE, cw->previous.line);
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line); /* pop condition. */
     }
     
     /* increment clause. */
     if (!cw_match(cw, TOKEN_RPAREN))
     {
-        int body_jump = cw_emit_jump(cw->chunk, OP_JUMP, cw->previous.line);
-        int inc_start = cw->chunk->len;
-        cw_parse_expression(cw);
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line);
+        int body_jump = cw_emit_jump(cw->parser->chunk, OP_JUMP, cw->parser->previous.line);
+        int inc_start = cw->parser->chunk->len;
+        cw_parse_discarded_expr(cw, TOKEN_RPAREN);
         cw_consume(cw, TOKEN_RPAREN, "Expect ')' after for clauses.");
 
         cw_emit_loop(cw, loop_start);
-        loop_start = inc_start;
-        cw_patch_jump(cw, body_jump);
+        loop_start = inc_start + cw_patch_jump(cw, body_jump);
     }
 
     cw_parse_statement(cw);
     cw_emit_loop(cw, loop_start);
 
     /* patch condition jump. */
-    if (exit_jump > 0)
+    if (exit_jump >= 0)
     {
         cw_patch_jump(cw, exit_jump);
-        cw_emit_byte(cw->chunk, OP_POP, cw->previous.line); /* pop condition. */
+        if (pushed) cw_emit_byte(cw->parser->chunk, OP_POP, cw->parser->previous.line); /* pop condition. */
     }
 
+    cw_hoist_globals(cw, begin);
     cw_end_scope(cw);
 }
 
 /* NOTE: make print build in function */
 static int cw_parse_stmt_print(cwRuntime* cw)
 {
+    if (cw->parser->compiler->function->memo >= 0)
+        cw_syntax_error_at(cw, &cw->parser->previous, "Pure function can not print.");
+
     cw_parse_expression(cw);
     cw_consume(cw, TOKEN_SEMICOLON, "Expect terminator after value.");
-    cw_emit_byte(cw->chunk, OP_PRINT, cw->previous.line);
+    cw_emit_byte(cw->parser->chunk, OP_PRINT, cw->parser->previous.line);
+}
+
+static int cw_parse_stmt_return(cwRuntime* cw)
+{
+    if (cw->parser->compiler->type == FUNC_SCRIPT)
+        cw_syntax_error_at(cw, &cw->parser->previous, "Can not return from top-level code.");
+
+    if (cw_match(cw, TOKEN_SEMICOLON))
+    {
+        cw_emit_byte(cw->parser->chunk, OP_NULL, cw->parser->previous.line);
+    }
+    else
+    {
+        cw_parse_expression(cw);
+        cw_consume(cw, TOKEN_SEMICOLON, "Expect terminator after return value.");
+
+        /* a call that produces the returned value can reuse the current frame */
+        int call = cw->parser->compiler->last_call;
+        if (call >= 0 && call == cw->parser->chunk->len - 2) cw->parser->chunk->bytes[call] = OP_TAIL_CALL;
+    }
+    cw_emit_byte(cw->parser->chunk, OP_RETURN, cw->parser->previous.line);
+
+    return 1;
 }
 
 /* NOTE: implement error handling in stmts */
 /* NOTE: break cw_match open */
 int cw_parse_statement(cwRuntime* cw)
 {
+    cw->parser->compiler->stmt_start = cw->parser->chunk->len;
     if (cw_match(cw, TOKEN_SEMICOLON))  return 0;
     if (cw_match(cw, TOKEN_IF))         return cw_parse_stmt_if(cw);
     if (cw_match(cw, TOKEN_WHILE))      return cw_parse_stmt_while(cw);
     if (cw_match(cw, TOKEN_FOR))        return cw_parse_stmt_for(cw);
     if (cw_match(cw, TOKEN_PRINT))      return cw_parse_stmt_print(cw);
+    if (cw_match(cw, TOKEN_RETURN))     return cw_parse_stmt_return(cw);
     if (cw_match(cw, TOKEN_LBRACE))     return cw_parse_stmt_block(cw);
 
     return cw_parse_stmt_expr(cw);
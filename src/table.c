@@ -112,6 +112,7 @@ bool cw_table_copy(Table* src, Table* dst)
         TableEntry* entry = &src->entries[i];
         if (entry->key != NULL) cw_table_insert(dst, entry->key, entry->val);
     }
+    return true;
 }
 
 cwString* cw_table_find_key(const Table* table, const char* str, size_t len, uint32_t hash)
@@ -123,13 +124,17 @@ cwString* cw_table_find_key(const Table* table, const char* str, size_t len, uin
     {
         TableEntry* entry = &table->entries[index];
 
-        /* Stop if we find an empty non-tombstone entry. */
-        if (entry->key == NULL && IS_NULL(entry->val)) return NULL;
-        
+        /* Stop if we find an empty non-tombstone entry, step over tombstones. */
+        if (entry->key == NULL)
+        {
+            if (IS_NULL(entry->val)) return NULL;
+        }
         /* Look for key with two early outs */
-        if (entry->key->len == len && entry->key->hash == hash 
+        else if (entry->key->len == len && entry->key->hash == hash 
             && memcmp(entry->key->raw, str, len) == 0)
+        {
             return entry->key;
+        }
 
         index = (index + 1) % table->capacity;
     }
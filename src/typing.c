@@ -0,0 +1,278 @@
+#include "typing.h"
+
+#include <string.h>
+
+#include "compiler.h"
+#include "memory.h"
+#include "register.h"
+
+/* what is known about a value, everything but TYPE_ANY is proven */
+typedef enum
+{
+    TYPE_ANY,
+    TYPE_BOOL,
+    TYPE_INT,
+    TYPE_FLOAT
+} cwType;
+
+typedef struct
+{
+    cwFunction* function;
+    cwChunk* chunk;
+    int len;
+
+    int* block_of;      /* block of the instruction starting at a code offset */
+    cwBasicBlock* blocks;
+    int block_count;
+    int* depths;        /* stack height on entry of every block, -1 if never reached */
+    int max_depth;
+
+    uint8_t* in;        /* types of the slots on entry, max_depth per block */
+} cwTyping;
+
+/* --------------------------| instructions |------------------------------------------- */
+static uint8_t cw_type_op(const cwTyping* typing, int at)
+{
+    const uint8_t* bytes = typing->chunk->bytes;
+    return cw_generic_op(bytes[at] == OP_WIDE ? bytes[at + 1] : bytes[at]);
+}
+
+/* slot, constant or count of an instruction that is neither a jump nor a register one */
+static int cw_type_arg(const cwTyping* typing, int at)
+{
+    const uint8_t* bytes = typing->chunk->bytes;
+    return bytes[at] == OP_WIDE ? (bytes[at + 2] << 8) | bytes[at + 3] : bytes[at + 1];
+}
+
+
+/* --------------------------| types |-------------------------------------------------- */
+static cwType cw_type_of(cwValue value)
+{
+    switch (value.type)
+    {
+    case VAL_BOOL:  return TYPE_BOOL;
+    case VAL_INT:   return TYPE_INT;
+    case VAL_FLOAT: return TYPE_FLOAT;
+    default:        return TYPE_ANY;
+    }
+}
+
+/* bools count as numbers too, only floats make a float */
+static cwType cw_type_arith(cwType a, cwType b)
+{
+    if (a == TYPE_ANY || b == TYPE_ANY) return TYPE_ANY;
+    return (a == TYPE_FLOAT || b == TYPE_FLOAT) ? TYPE_FLOAT : TYPE_INT;
+}
+
+/* comparisons of anything but numbers may end up comparing arrays */
+static cwType cw_type_compare(cwType a, cwType b)
+{
+    return (a == TYPE_ANY || b == TYPE_ANY) ? TYPE_ANY : TYPE_BOOL;
+}
+
+static cwType cw_type_rk(const cwTyping* typing, const uint8_t* types, uint8_t mode, uint8_t bit, uint8_t operand)
+{
+    return CW_RK_IS_CONST(mode, bit) ? cw_type_of(typing->chunk->constants[operand]) : types[operand];
+}
+
+/* the typed opcode of a binary one (OP_EQ ... OP_DIVIDE) for operands of types a and b */
+static uint8_t cw_type_binary_op(uint8_t op, cwType a, cwType b)
+{
+    if (a == TYPE_INT && b == TYPE_INT) return OP_EQ_INT + (op - OP_EQ);
+
+    bool numbers = (a == TYPE_INT || a == TYPE_FLOAT) && (b == TYPE_INT || b == TYPE_FLOAT);
+    if (numbers && op >= OP_LT && (a == TYPE_FLOAT || b == TYPE_FLOAT)) return OP_LT_FLOAT + (op - OP_LT);
+    return op;
+}
+
+/* applies the instruction at offset to the types of the stack of height depth */
+static void cw_type_transfer(const cwTyping* typing, uint8_t* types, int* depth, int at)
+{
+    const uint8_t* bytes = typing->chunk->bytes;
+    uint8_t op = cw_type_op(typing, at);
+    uint8_t* top = types + *depth - 1;
+
+    /* what gets pushed, the stack effect is applied below */
+    cwType pushed = TYPE_ANY;
+    switch (op)
+    {
+    case OP_CONSTANT: pushed = cw_type_of(typing->chunk->constants[cw_type_arg(typing, at)]); break;
+    case OP_TRUE:
+    case OP_FALSE:    pushed = TYPE_BOOL; break;
+    case OP_GET_LOCAL: pushed = types[cw_type_arg(typing, at)]; break;
+    case OP_SET_LOCAL:
+        types[cw_type_arg(typing, at)] = *top;
+        pushed = *top;
+        break;
+    case OP_SET_GLOBAL: pushed = *top; break;
+    case OP_INC_LOCAL: case OP_DEC_LOCAL:
+    {
+        uint8_t* slot = &types[cw_type_arg(typing, at)];
+        if (*slot != TYPE_INT && *slot != TYPE_FLOAT) *slot = TYPE_ANY;
+        break;
+    }
+    case OP_ADD_LOCAL: case OP_SUB_LOCAL: case OP_MULT_LOCAL: case OP_DIV_LOCAL:
+    {
+        uint8_t* slot = &types[cw_type_arg(typing, at)];
+        *slot = cw_type_arith(*slot, *top);
+        break;
+    }
+    case OP_EQ: case OP_NOTEQ:
+        pushed = TYPE_BOOL;
+        break;
+    case OP_LT: case OP_LTEQ: case OP_GT: case OP_GTEQ:
+        pushed = cw_type_compare(top[-1], *top);
+        break;
+    case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+        pushed = cw_type_arith(top[-1], *top);
+        break;
+    case OP_NEGATE:
+        pushed = (*top == TYPE_FLOAT) ? TYPE_FLOAT : (*top == TYPE_ANY) ? TYPE_ANY : TYPE_INT;
+        break;
+    case OP_NOT:
+        pushed = TYPE_BOOL;
+        break;
+    case OP_R_MOVE:
+        types[bytes[at + 2]] = cw_type_rk(typing, types, bytes[at + 1], CW_RK_B, bytes[at + 3]);
+        break;
+    case OP_R_ADD: case OP_R_SUB: case OP_R_MULT: case OP_R_DIV:
+    case OP_R_EQ:  case OP_R_NOTEQ:
+    case OP_R_LT:  case OP_R_LTEQ:
+    case OP_R_GT:  case OP_R_GTEQ:
+    {
+        cwType b = cw_type_rk(typing, types, bytes[at + 1], CW_RK_B, bytes[at + 3]);
+        cwType c = cw_type_rk(typing, types, bytes[at + 1], CW_RK_C, bytes[at + 4]);
+        types[bytes[at + 2]] = (op >= OP_R_EQ) ? cw_type_compare(b, c) : cw_type_arith(b, c);
+        break;
+    }
+    default:
+        break;
+    }
+
+    int pops, pushes;
+    cw_stack_effect(typing->chunk->bytes + at, &pops, &pushes);
+    *depth -= pops;
+    for (int i = 0; i < pushes; ++i) types[(*depth)++] = pushed;
+}
+
+/* --------------------------| propagation |-------------------------------------------- */
+/* meets the types leaving a block with the entry of its successor, true if they changed */
+static bool cw_type_flow_into(cwTyping* typing, int b, const uint8_t* types, bool first)
+{
+    uint8_t* in = typing->in + (size_t)b * typing->max_depth;
+    if (first)
+    {
+        memcpy(in, types, typing->depths[b]);
+        return true;
+    }
+
+    bool changed = false;
+    for (int i = 0; i < typing->depths[b]; ++i)
+    {
+        if (in[i] == types[i] || in[i] == TYPE_ANY) continue;
+        in[i] = TYPE_ANY;
+        changed = true;
+    }
+    return changed;
+}
+
+static void cw_type_propagate(cwTyping* typing, uint8_t* types)
+{
+    int* work = CW_ALLOCATE(int, typing->block_count);
+    bool* queued = CW_ALLOCATE(bool, typing->block_count);
+    bool* seen = CW_ALLOCATE(bool, typing->block_count);
+    memset(queued, 0, typing->block_count * sizeof(bool));
+    memset(seen, 0, typing->block_count * sizeof(bool));
+
+    /* the arguments and the function itself are unknown */
+    memset(types, TYPE_ANY, typing->depths[0]);
+    cw_type_flow_into(typing, 0, types, true);
+    seen[0] = queued[0] = true;
+    int top = 0;
+    work[top++] = 0;
+
+    while (top > 0)
+    {
+        int b = work[--top];
+        queued[b] = false;
+
+        const cwBasicBlock* block = &typing->blocks[b];
+        int depth = typing->depths[b];
+        memcpy(types, typing->in + (size_t)b * typing->max_depth, depth);
+        for (int at = block->first; at <= block->last; at += cw_op_length(typing->chunk->bytes + at))
+            cw_type_transfer(typing, types, &depth, at);
+
+        for (int s = 0; s < block->succ_count; ++s)
+        {
+            int succ = block->succ[s];
+            bool changed = cw_type_flow_into(typing, succ, types, !seen[succ]);
+            seen[succ] = true;
+            if (changed && !queued[succ])
+            {
+                queued[succ] = true;
+                work[top++] = succ;
+            }
+        }
+    }
+
+    CW_FREE_ARRAY(int, work, typing->block_count);
+    CW_FREE_ARRAY(bool, queued, typing->block_count);
+    CW_FREE_ARRAY(bool, seen, typing->block_count);
+}
+
+/* --------------------------| specializing |------------------------------------------- */
+static void cw_type_rewrite(cwTyping* typing, uint8_t* types)
+{
+    uint8_t* bytes = typing->chunk->bytes;
+    for (int b = 0; b < typing->block_count; ++b)
+    {
+        const cwBasicBlock* block = &typing->blocks[b];
+        if (typing->depths[b] < 0) continue;
+
+        int depth = typing->depths[b];
+        memcpy(types, typing->in + (size_t)b * typing->max_depth, depth);
+        for (int at = block->first; at <= block->last; at += cw_op_length(bytes + at))
+        {
+            /* the opcode byte, behind a wide prefix for jumps */
+            uint8_t* code = bytes + at + (bytes[at] == OP_WIDE);
+            uint8_t op = *code;
+            if (op >= OP_EQ && op <= OP_DIVIDE)     *code = cw_type_binary_op(op, types[depth - 2], types[depth - 1]);
+            else if (op == OP_NOT && types[depth - 1] == TYPE_BOOL)           *code = OP_NOT_BOOL;
+            else if (op == OP_JUMP_IF_FALSE && types[depth - 1] == TYPE_BOOL) *code = OP_JUMP_IF_FALSE_BOOL;
+
+            cw_type_transfer(typing, types, &depth, at);
+        }
+    }
+}
+
+void cw_type_specialize(cwFunction* function)
+{
+    cwTyping typing;
+    typing.function = function;
+    typing.chunk = &function->chunk;
+    typing.len = (int)function->chunk.len;
+    if (typing.len == 0) return;
+
+    typing.block_of = CW_ALLOCATE(int, typing.len + 1);
+    typing.blocks = CW_ALLOCATE(cwBasicBlock, typing.len);
+    typing.block_count = cw_basic_blocks(typing.chunk->bytes, typing.len, NULL, NULL, typing.blocks, typing.block_of);
+    typing.depths = CW_ALLOCATE(int, typing.block_count);
+    typing.max_depth = cw_block_depths(typing.chunk->bytes, typing.blocks, typing.block_count, function->arity + 1, typing.depths);
+
+    if (typing.max_depth >= 0 && (size_t)typing.max_depth * typing.block_count <= CW_TYPE_BUDGET)
+    {
+        size_t size = (size_t)typing.max_depth * typing.block_count;
+        typing.in = CW_ALLOCATE(uint8_t, size);
+        uint8_t* types = CW_ALLOCATE(uint8_t, typing.max_depth);
+
+        cw_type_propagate(&typing, types);
+        cw_type_rewrite(&typing, types);
+
+        CW_FREE_ARRAY(uint8_t, typing.in, size);
+        CW_FREE_ARRAY(uint8_t, types, typing.max_depth);
+    }
+
+    CW_FREE_ARRAY(int, typing.block_of, typing.len + 1);
+    CW_FREE_ARRAY(cwBasicBlock, typing.blocks, typing.len);
+    CW_FREE_ARRAY(int, typing.depths, typing.block_count);
+}
@@ -0,0 +1,30 @@
+#ifndef CLOCKWORK_TYPING_H
+#define CLOCKWORK_TYPING_H
+
+#include "common.h"
+
+/*
+ * Static types of the values of a finished function. A forward data flow
+ * over the stack code carries the type of every slot and stack value from
+ * the entry, where the arguments are unknown, through the blocks until
+ * nothing changes. A value is known to be a bool, an int or a float where
+ * every path to it agrees, e.g. a counter or an accumulator that starts
+ * out as a numeric literal and is only updated with numbers.
+ *
+ * Generic instructions whose operands are proven are then replaced by
+ * typed ones that do not check their operands at all:
+ *
+ *   - arithmetic and comparisons of two ints (OP_ADD_INT ...)
+ *   - arithmetic and ordering of two numbers one of which is a float
+ *     (OP_ADD_FLOAT ...), equality of floats stays generic
+ *   - OP_NOT and OP_JUMP_IF_FALSE of a bool
+ *
+ * Typed instructions have the length of the generic ones, so the code does
+ * not move. Functions with more slots times blocks than CW_TYPE_BUDGET are
+ * left as they are.
+ */
+#define CW_TYPE_BUDGET (1 << 20)
+
+void cw_type_specialize(cwFunction* function);
+
+#endif /* !CLOCKWORK_TYPING_H */
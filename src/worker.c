@@ -0,0 +1,66 @@
+#include "worker.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "memory.h"
+
+typedef struct
+{
+    pthread_t thread;
+    cwRuntime* cw;
+    cwFunction* script;
+    int index;
+    cwWorkerSetup setup;
+    void* user;
+    InterpretResult result;
+} cwWorker;
+
+static void* cw_worker_main(void* arg)
+{
+    cwWorker* worker = arg;
+
+    /* the runtime is too large for a thread stack */
+    cwRuntime* cw = cw_reallocate(NULL, 0, sizeof(cwRuntime));
+    memset(cw, 0, sizeof(cwRuntime));
+    cw_init(cw);
+
+    /* strings of the script are interned by the compiling runtime */
+    cw_table_copy(&worker->cw->strings, &cw->strings);
+
+    if (worker->setup) worker->setup(cw, worker->index, worker->user);
+    worker->result = cw_run_script(cw, worker->script);
+
+    cw_free(cw);
+    cw_reallocate(cw, sizeof(cwRuntime), 0);
+    return NULL;
+}
+
+bool cw_run_parallel(cwRuntime* cw, cwFunction* script, int count,
+                     cwWorkerSetup setup, void* user, InterpretResult* results)
+{
+    cwWorker* workers = CW_ALLOCATE(cwWorker, count);
+
+    int started = 0;
+    for (; started < count; ++started)
+    {
+        cwWorker* worker = &workers[started];
+        worker->cw = cw;
+        worker->script = script;
+        worker->index = started;
+        worker->setup = setup;
+        worker->user = user;
+        worker->result = INTERPRET_OK;
+
+        if (pthread_create(&worker->thread, NULL, cw_worker_main, worker) != 0) break;
+    }
+
+    for (int i = 0; i < started; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+        if (results) results[i] = workers[i].result;
+    }
+
+    CW_FREE_ARRAY(cwWorker, workers, count);
+    return started == count;
+}
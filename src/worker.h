@@ -0,0 +1,25 @@
+#ifndef CLOCKWORK_WORKER_H
+#define CLOCKWORK_WORKER_H
+
+#include "common.h"
+#include "runtime.h"
+
+/*
+ * Runs one compiled script on several threads at once. Every worker gets
+ * its own runtime with stack, heap, globals and JIT and shares the code of
+ * the script as well as the strings interned while compiling it, so the
+ * compiling runtime must not be used until all workers are done.
+ */
+
+/* called on every worker runtime before the script runs, e.g. to define globals */
+typedef void (*cwWorkerSetup)(cwRuntime* worker, int index, void* user);
+
+/*
+ * runs script, compiled by cw, on count threads and waits for all of them.
+ * results[i] receives the result of worker i if results is not NULL.
+ * returns false if the threads could not be started.
+ */
+bool cw_run_parallel(cwRuntime* cw, cwFunction* script, int count,
+                     cwWorkerSetup setup, void* user, InterpretResult* results);
+
+#endif /* !CLOCKWORK_WORKER_H */
@@ -0,0 +1,91 @@
+#include <stdio.h>
+
+#include "batch.h"
+#include "runtime.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* two expressions compiled on the same runtime, each declares its own batch function */
+static void test_two_batches(void)
+{
+    cwRuntime cw;
+    cw_init(&cw);
+
+    const char* names[] = { "price", "qty" };
+    cwBatch* total = cw_batch_compile(&cw, "price * qty", names, 2);
+    cwBatch* large = cw_batch_compile(&cw, "price * qty > 100", names, 2);
+    check(total != NULL, "first batch compiles");
+    check(large != NULL, "second batch compiles on the same runtime");
+
+    float prices[3] = { 1.5f, 20.0f, 50.0f };
+    int32_t quantities[3] = { 2, 3, 4 };
+    cwColumn inputs[2] = { { CW_COLUMN_FLOAT, .as.floats = prices },
+                           { CW_COLUMN_INT,   .as.ints = quantities } };
+
+    if (total && large)
+    {
+        float totals[3];
+        int32_t flags[3];
+        cwColumn total_out = { CW_COLUMN_FLOAT, .as.floats = totals };
+        cwColumn large_out = { CW_COLUMN_INT,   .as.ints = flags };
+
+        check(cw_batch_eval(&cw, total, inputs, 3, &total_out) == INTERPRET_OK, "first batch evaluates");
+        check(cw_batch_eval(&cw, large, inputs, 3, &large_out) == INTERPRET_OK, "second batch evaluates");
+        check(totals[0] == 3.0f && totals[1] == 60.0f && totals[2] == 200.0f, "first batch results");
+        check(flags[0] == 0 && flags[1] == 0 && flags[2] == 1, "second batch results");
+    }
+
+    /* scripts can still declare a global of the wrapper's name */
+    check(cw_interpret(&cw, "let batch = 1;") == INTERPRET_OK, "batch is not left behind as a global");
+
+    cw_batch_free(&cw, total);
+    cw_batch_free(&cw, large);
+    cw_free(&cw);
+}
+
+/* a zero in an int divisor column is a runtime error of its row, not a crash */
+static void test_division_by_zero(void)
+{
+    cwRuntime cw;
+    cw_init(&cw);
+
+    const char* names[] = { "a", "b" };
+    cwBatch* ratio = cw_batch_compile(&cw, "a / b", names, 2);
+    check(ratio != NULL, "ratio compiles");
+
+    int32_t a[4] = { 10, 20, -2147483647 - 1, 40 };
+    int32_t b[4] = { 2, 5, -1, 0 };
+    int32_t out[4] = { 0, 0, 0, 0 };
+    cwColumn inputs[2] = { { CW_COLUMN_INT, .as.ints = a }, { CW_COLUMN_INT, .as.ints = b } };
+    cwColumn output = { CW_COLUMN_INT, .as.ints = out };
+
+    if (ratio)
+    {
+        check(cw_batch_eval(&cw, ratio, inputs, 4, &output) == INTERPRET_RUNTIME_ERROR, "division by zero is reported");
+        check(out[0] == 5 && out[1] == 4 && out[2] == -2147483647 - 1, "rows in front of the zero are evaluated");
+
+        b[3] = 4;
+        check(cw_batch_eval(&cw, ratio, inputs, 4, &output) == INTERPRET_OK, "batch evaluates without the zero");
+        check(out[3] == 10, "block result");
+    }
+
+    cw_batch_free(&cw, ratio);
+    cw_free(&cw);
+}
+
+int main(void)
+{
+    test_two_batches();
+    test_division_by_zero();
+    if (!failures) printf("batch: ok\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+
+#include "runtime.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* a value used over and over again takes a single constant */
+static void test_constants_shared(void)
+{
+    cwRuntime cw;
+    cw_init(&cw);
+
+    cwFunction* script = cw_compile_detached(&cw, "mut a = 1.5; a = a + 1.5; a = a * 1.5; a = \"s\"; a = \"s\";");
+    check(script != NULL, "compiles");
+    check(script && script->chunk.const_len == 3, "shares constants");
+
+    cw_free(&cw);
+}
+
+/* constants and global names beyond the first 256 are reached through OP_WIDE */
+static void test_constants_wide(void)
+{
+    static char src[32768];
+    int len = 0;
+    for (int i = 0; i < 300; ++i) len += sprintf(src + len, "mut g%d = %d;\n", i, 1000 + i);
+    len += sprintf(src + len, "g299 += 1; g298++; mut s = g299 + g298 + 5000;\n");
+
+    cwRuntime cw;
+    cw_init(&cw);
+    check(cw_interpret(&cw, src) == INTERPRET_OK, "runs a chunk of more than 256 constants");
+    cwValue* s = cw_table_find(&cw.globals, cw_str_copy(&cw, "s", 1));
+    check(s && IS_INT(*s) && AS_INT(*s) == 7599, "reads and updates wide globals");
+    cw_free(&cw);
+}
+
+int main(void)
+{
+    test_constants_shared();
+    test_constants_wide();
+    if (!failures) printf("compiler: ok\n");
+    return failures ? 1 : 0;
+}
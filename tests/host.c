@@ -0,0 +1,56 @@
+#include <stdio.h>
+
+#include "host.h"
+#include "runtime.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* calls the script function fail, which raises an error, and recovers with -1 */
+static bool native_recover(cwRuntime* cw, cwValue* args, int argc, cwValue* result)
+{
+    int frames = cw->frame_count;
+    size_t values = cw->stack_index;
+
+    cwValue value;
+    check(cw_call(cw, cw_get_function(cw, "fail"), args, 1, &value) == INTERPRET_RUNTIME_ERROR, "callback fails");
+    check(cw->frame_count == frames && cw->stack_index == values, "callback error keeps the frames of the caller");
+
+    *result = MAKE_INT(-1);
+    return true;
+}
+
+/* a script error in a callback of a native only unwinds the callback */
+static void test_callback_error(void)
+{
+    cwRuntime cw;
+    cw_init(&cw);
+    cw_define_native(&cw, "recover", native_recover, 1);
+
+    check(cw_interpret(&cw,
+        "function fail(x) { return x * \"s\"; }\n"
+        "function outer(y) { let r = recover(y); return r + y; }\n") == INTERPRET_OK, "script compiles");
+
+    cwValue arg = MAKE_INT(5);
+    cwValue result = MAKE_NULL();
+    check(cw_call(&cw, cw_get_function(&cw, "outer"), &arg, 1, &result) == INTERPRET_OK, "outer call survives");
+    check(IS_INT(result) && AS_INT(result) == 4, "outer call result");
+    check(cw.frame_count == 0 && cw.stack_index == 0, "stack is empty after the call");
+
+    cw_free(&cw);
+}
+
+int main(void)
+{
+    test_callback_error();
+    if (!failures) printf("host: ok\n");
+    return failures ? 1 : 0;
+}
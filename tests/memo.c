@@ -0,0 +1,59 @@
+#include <stdio.h>
+
+#include "host.h"
+#include "memo.h"
+#include "runtime.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* the elements of a let array change, a pure function reading it could return stale results */
+static void test_mutable_globals(void)
+{
+    cwRuntime cw;
+    cw_init(&cw);
+
+    check(cw_interpret(&cw, "let arr = [1, 2]; pure function f(i) { return arr[i]; }") == INTERPRET_COMPILE_ERROR,
+          "rejects a let array of the same compile");
+    check(cw_interpret(&cw, "let arr = [1, 2];") == INTERPRET_OK, "declares the array");
+    check(cw_interpret(&cw, "pure function f(i) { return arr[i]; }") == INTERPRET_COMPILE_ERROR,
+          "rejects a let array of an earlier compile");
+    check(cw_interpret(&cw, "let n = 3 * 4;") == INTERPRET_OK, "declares the number");
+    check(cw_interpret(&cw, "pure function g(i) { return n * i; }") == INTERPRET_OK,
+          "accepts a let number of an earlier compile");
+
+    cw_free(&cw);
+}
+
+/* a pure function reached through a tail call is looked up and stored like any call */
+static void test_tail_calls(void)
+{
+    cwRuntime cw;
+    cw_init(&cw);
+
+    check(cw_interpret(&cw, "pure function square(x) { return x * x; } function wrap(x) { return square(x); }") == INTERPRET_OK,
+          "compiles");
+    check(cw_interpret(&cw, "let a = wrap(5); let b = wrap(5); let c = wrap(5);") == INTERPRET_OK, "runs");
+
+    cwFunction* square = cw_get_function(&cw, "square");
+    const cwMemo* memo = square ? cw_memo_find(&cw, square) : NULL;
+    check(memo && memo->misses == 1 && memo->hits == 2, "looks up tail calls");
+
+    cw_free(&cw);
+}
+
+int main(void)
+{
+    test_mutable_globals();
+    test_tail_calls();
+    if (!failures) printf("memo: ok\n");
+    return failures ? 1 : 0;
+}
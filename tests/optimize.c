@@ -0,0 +1,36 @@
+#include <stdio.h>
+
+#include "runtime.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* constant int division by zero is left unfolded and reported when it runs */
+static void test_division_by_zero(void)
+{
+    cwRuntime cw;
+    cw_init(&cw);
+    cw.optimize = true;
+
+    check(cw_interpret(&cw, "function f(x) { let k = 0; return x / k; }") == INTERPRET_OK, "compiles");
+    check(cw_interpret(&cw, "let r = f(7);") == INTERPRET_RUNTIME_ERROR, "reports the division");
+    check(cw_interpret(&cw, "let q = 7 / 0;") == INTERPRET_RUNTIME_ERROR, "reports the constant division");
+    check(cw_interpret(&cw, "let z = 7.0 / 0;") == INTERPRET_OK, "float division by zero is infinite");
+
+    cw_free(&cw);
+}
+
+int main(void)
+{
+    test_division_by_zero();
+    if (!failures) printf("optimize: ok\n");
+    return failures ? 1 : 0;
+}